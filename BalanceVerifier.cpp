@@ -0,0 +1,211 @@
+#include "BalanceVerifier.h"
+#include "DatabaseManager.h"
+#include "Metrics.h"
+#include <QElapsedTimer>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QStringList>
+#include <QThreadPool>
+#include <QtConcurrent>
+
+//# of ledger rows checked together by one pool thread.
+#define VERIFY_CHUNK_ROWS 65536
+
+struct BalanceVerifier::ChunkNet{
+    typedef qint64 result_type;
+
+    explicit ChunkNet(const LedgerCache * cache) : cache(cache) {}
+
+    qint64 operator()(int chunk) const{
+        return BalanceVerifier::chunk_net(*cache, chunk);
+    }
+
+    const LedgerCache * cache;
+};
+
+struct BalanceVerifier::ChunkCheck{
+    typedef ChunkResult result_type;
+
+    ChunkCheck(const LedgerCache * cache, const QVector<qint64> * starts) : cache(cache), starts(starts) {}
+
+    ChunkResult operator()(int chunk) const{
+        return BalanceVerifier::check_chunk(*cache, chunk, starts->at(chunk));
+    }
+
+    const LedgerCache * cache;
+    const QVector<qint64> * starts;
+};
+
+BalanceVerifier::BalanceVerifier() : rows(0), negative_count(0), chunks(0), elapsed(0)
+{
+}
+
+qint64 BalanceVerifier::chunk_net(const LedgerCache & cache, int chunk){
+    const qint64 * amounts = cache.row_amounts().constData();
+    const quint8 * deposits = cache.row_deposits().constData();
+    int end = qMin(cache.size(), (chunk + 1) * VERIFY_CHUNK_ROWS);
+    qint64 net = 0;
+    for(int i = chunk * VERIFY_CHUNK_ROWS; i < end; i++){
+        net += deposits[i] ? amounts[i] : -amounts[i];
+    }
+    return net;
+}
+
+BalanceVerifier::ChunkResult BalanceVerifier::check_chunk(const LedgerCache & cache, int chunk, qint64 start){
+    const qint64 * amounts = cache.row_amounts().constData();
+    const quint8 * deposits = cache.row_deposits().constData();
+    int end = qMin(cache.size(), (chunk + 1) * VERIFY_CHUNK_ROWS);
+    ChunkResult result;
+    qint64 balance = start;
+    for(int i = chunk * VERIFY_CHUNK_ROWS; i < end; i++){
+        balance += deposits[i] ? amounts[i] : -amounts[i];
+        qint64 stored = cache.balance_at(i).to_cents();
+        if(stored != balance){
+            Mismatch mismatch = {i, cache.id_at(i), cache.date_at(i), stored, balance};
+            result.mismatches.append(mismatch);
+        }
+        if(balance < 0){
+            if(result.negatives.size() < REPORT_LIMIT){
+                Mismatch negative = {i, cache.id_at(i), cache.date_at(i), stored, balance};
+                result.negatives.append(negative);
+            }
+            result.negative++;
+        }
+    }
+    return result;
+}
+
+/*
+ * Every mismatch is kept (repair needs them all), only the report is capped.
+*/
+int BalanceVerifier::verify(const LedgerCache & cache){
+    ScopedTimer scope("ledger.verify");
+    QElapsedTimer timer;
+    timer.start();
+    rows = cache.size();
+    chunks = (rows + VERIFY_CHUNK_ROWS - 1) / VERIFY_CHUNK_ROWS;
+    QVector<int> chunk_ids(chunks);
+    for(int i = 0; i < chunks; i++) chunk_ids[i] = i;
+
+    QVector<qint64> nets = QtConcurrent::blockingMapped<QVector<qint64> >(chunk_ids, ChunkNet(&cache));
+    QVector<qint64> starts(chunks);
+    qint64 balance = 0;
+    for(int i = 0; i < chunks; i++){
+        starts[i] = balance;
+        balance += nets[i];
+    }
+    QVector<ChunkResult> results = QtConcurrent::blockingMapped<QVector<ChunkResult> >(chunk_ids, ChunkCheck(&cache, &starts));
+
+    mismatches.clear();
+    negatives.clear();
+    negative_count = 0;
+    for(int i = 0; i < results.size(); i++){
+        mismatches += results[i].mismatches;
+        for(int j = 0; j < results[i].negatives.size() && negatives.size() < REPORT_LIMIT; j++){
+            negatives.append(results[i].negatives[j]);
+        }
+        negative_count += results[i].negative;
+    }
+    elapsed = timer.elapsed();
+    return mismatches.size();
+}
+
+/*
+ * Runs of consecutive rows off by the same amount become one UPDATE over their range of the ledger: the cache
+ * holds the account's rows in ledger order, so the rows from the run's first to its last are exactly the run.
+ * The range's sql depends on whether its ends have a date, so up to four statements are prepared.
+*/
+bool BalanceVerifier::repair(QSqlDatabase db, qint64 account, Logger * logger){
+    ScopedTimer scope("ledger.repair");
+    if(mismatches.isEmpty()) return true;
+    QElapsedTimer timer;
+    timer.start();
+    if(!db.transaction()){
+        logger->log(Logger::CRITICAL, "Error starting balance repair transaction", db.lastError().text());
+        return false;
+    }
+    QSqlQuery repair_qrys[4] = {QSqlQuery(db), QSqlQuery(db), QSqlQuery(db), QSqlQuery(db)};
+    QSqlQuery * repair_qry = NULL;
+    bool result = true;
+    int statements = 0;
+    for(int i = 0; result && i < mismatches.size();){
+        qint64 change = mismatches[i].expected - mismatches[i].stored;
+        int last = i;
+        while(last + 1 < mismatches.size() && mismatches[last + 1].row == mismatches[last].row + 1
+              && mismatches[last + 1].expected - mismatches[last + 1].stored == change){
+            last++;
+        }
+        const Mismatch & first_row = mismatches[i];
+        const Mismatch & last_row = mismatches[last];
+        repair_qry = &repair_qrys[(first_row.date.isValid() ? 2 : 0) + (last_row.date.isValid() ? 1 : 0)];
+        if(repair_qry->lastQuery().isEmpty()){
+            repair_qry->prepare("UPDATE transactions SET balance = balance + :change WHERE account_id = :account AND "
+                                + DatabaseManager::rows_after(":first", first_row.date, true) + " AND "
+                                + DatabaseManager::rows_before(":last", last_row.date, true) + ";");
+        }
+        repair_qry->bindValue(":change", change);
+        repair_qry->bindValue(":account", account);
+        DatabaseManager::bind_position(*repair_qry, ":first", first_row.date, first_row.id);
+        DatabaseManager::bind_position(*repair_qry, ":last", last_row.date, last_row.id);
+        result = repair_qry->exec();
+        statements++;
+        i = last + 1;
+    }
+    if(result) result = db.commit();
+    if(!result){
+        logger->log(Logger::CRITICAL, "Error repairing balances, rolling back", repair_qry != NULL ? repair_qry->lastError().text() : db.lastError().text());
+        db.rollback();
+        return false;
+    }
+    logger->log(Logger::INFO, QString("Repaired %1 balances of account %2 with %3 statements in %4 ms")
+                .arg(mismatches.size())
+                .arg(account)
+                .arg(statements)
+                .arg(timer.elapsed()));
+    mismatches.clear();
+    return true;
+}
+
+int BalanceVerifier::rows_checked() const{
+    return rows;
+}
+
+int BalanceVerifier::inconsistent() const{
+    return mismatches.size();
+}
+
+int BalanceVerifier::negative() const{
+    return negative_count;
+}
+
+qint64 BalanceVerifier::elapsed_ms() const{
+    return elapsed;
+}
+
+QString BalanceVerifier::summary() const{
+    return QString("Checked %1 balances in %2 ms (%3 chunks, %4 threads): %5 inconsistent, %6 negative")
+            .arg(rows)
+            .arg(elapsed)
+            .arg(chunks)
+            .arg(QThreadPool::globalInstance()->maxThreadCount())
+            .arg(mismatches.size())
+            .arg(negative_count);
+}
+
+QString BalanceVerifier::details() const{
+    QStringList lines;
+    for(int i = 0; i < mismatches.size() && i < REPORT_LIMIT; i++){
+        lines << QString("Transaction %1: balance %2, expected %3")
+                 .arg(mismatches[i].id)
+                 .arg(Money::from_cents(mismatches[i].stored).to_string())
+                 .arg(Money::from_cents(mismatches[i].expected).to_string());
+    }
+    if(mismatches.size() > REPORT_LIMIT) lines << QString("... and %1 more").arg(mismatches.size() - REPORT_LIMIT);
+    for(int i = 0; i < negatives.size(); i++){
+        lines << QString("Transaction %1: balance goes negative (%2)")
+                 .arg(negatives[i].id)
+                 .arg(Money::from_cents(negatives[i].expected).to_string());
+    }
+    if(negative_count > negatives.size()) lines << QString("... and %1 more negative").arg(negative_count - negatives.size());
+    return lines.join("\n");
+}
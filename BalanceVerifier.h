@@ -0,0 +1,79 @@
+#ifndef BALANCEVERIFIER_H
+#define BALANCEVERIFIER_H
+
+#include <QDate>
+#include <QSqlDatabase>
+#include <QString>
+#include <QVector>
+#include "LedgerCache.h"
+#include "Logger.h"
+
+/*
+ * Checks an account's balance chain: every row's stored balance must be the balance before it plus/minus its
+ * amount (starting from 0), and no balance may be negative.
+ * The expected chain is a parallel prefix sum over fixed size chunks of a LedgerCache: the chunks' nets are
+ * summed in parallel, a short serial scan over them gives the balance before each chunk, then every chunk is
+ * walked in parallel from its starting balance comparing against the stored balances.
+ * repair() rewrites the inconsistent balances in one transaction. Rows after a bad one are usually all off by
+ * the same amount, so each run of consecutive rows with the same error is fixed by one set-based UPDATE.
+ * Negative balances come from the amounts themselves, they are reported but can't be repaired.
+*/
+class BalanceVerifier
+{
+public:
+    //at most this many rows are listed in the report, the counts are always complete
+    static const int REPORT_LIMIT = 1000;
+
+    //an inconsistent row, balances in cents
+    struct Mismatch{
+        int row;
+        qint64 id;
+        QDate date;
+        qint64 stored;
+        qint64 expected;
+    };
+
+    BalanceVerifier();
+
+    //verifies the cache, which must be loaded, returns the # of inconsistent rows
+    int verify(const LedgerCache & cache);
+
+    //rewrites every inconsistent balance found by the last verify() of the account in one sql transaction
+    bool repair(QSqlDatabase db, qint64 account, Logger * logger);
+
+    int rows_checked() const;
+    int inconsistent() const;
+    int negative() const;
+    qint64 elapsed_ms() const;
+
+    //one line with the counts and timing
+    QString summary() const;
+
+    //one line per listed row (up to REPORT_LIMIT of each kind)
+    QString details() const;
+
+private:
+    //QtConcurrent functors for the two parallel passes
+    struct ChunkNet;
+    struct ChunkCheck;
+
+    struct ChunkResult{
+        ChunkResult() : negative(0) {}
+        QVector<Mismatch> mismatches;
+        int negative;
+        //first negative rows of the chunk, up to REPORT_LIMIT
+        QVector<Mismatch> negatives;
+    };
+
+    static qint64 chunk_net(const LedgerCache & cache, int chunk);
+    static ChunkResult check_chunk(const LedgerCache & cache, int chunk, qint64 start);
+
+    QVector<Mismatch> mismatches;
+    QVector<Mismatch> negatives;
+    int rows;
+    int negative_count;
+    int chunks;
+    qint64 elapsed;
+};
+
+#endif // BALANCEVERIFIER_H
@@ -0,0 +1,159 @@
+#include "BatchIngestor.h"
+#include "LedgerEngine.h"
+#include <QDate>
+#include <QElapsedTimer>
+#include <QSqlError>
+#include <QSqlQuery>
+
+//# of rows committed per transaction.
+#define INGEST_BATCH_SIZE 50000
+
+BatchIngestor::BatchIngestor(Logger * logger, DatabaseManager * db, qint64 account, QObject *parent) :
+    QObject(parent),
+    logger(logger),
+    db(db),
+    account(account),
+    read(0),
+    inserted(0),
+    rejected(0),
+    elapsed(0)
+{
+}
+
+qint64 BatchIngestor::rows_read() const{
+    return read;
+}
+
+qint64 BatchIngestor::rows_inserted() const{
+    return inserted;
+}
+
+qint64 BatchIngestor::rows_rejected() const{
+    return rejected;
+}
+
+qint64 BatchIngestor::elapsed_ms() const{
+    return elapsed;
+}
+
+QString BatchIngestor::summary() const{
+    double seconds = elapsed / 1000.0;
+    return QString("Read %1, inserted %2, rejected %3 transactions in %4 s (%5 rows/s)")
+            .arg(read)
+            .arg(inserted)
+            .arg(rejected)
+            .arg(seconds, 0, 'f', 3)
+            .arg(seconds > 0 ? inserted / seconds : 0, 0, 'f', 0);
+}
+
+/*
+ * The balance starts from the last balance in the database and is carried in memory from row to row,
+ * so nothing is read back from the database while ingesting. Lines have to be in date order: each one is
+ * checked against the date of the last row, in the database or accepted from the input.
+*/
+bool BatchIngestor::ingest(QIODevice * input, QTextStream & errors){
+    QElapsedTimer timer;
+    timer.start();
+    read = inserted = rejected = 0;
+
+    Money balance;
+    QDate last_date;
+    db->prepared(DatabaseManager::LAST_BALANCE).bindValue(":account", account);
+    if(db->exec(DatabaseManager::LAST_BALANCE)){
+        QSqlQuery & last_balance_qry = db->prepared(DatabaseManager::LAST_BALANCE);
+        if(last_balance_qry.next()){
+            balance = Money::from_cents(last_balance_qry.value(0).toLongLong());
+            last_date = last_balance_qry.value(1).toDate();
+        }
+        db->release(DatabaseManager::LAST_BALANCE);
+    }
+
+    QSqlDatabase connection = db->database();
+    QSqlQuery & add_transaction_qry = db->prepared(DatabaseManager::INSERT_TRANSACTION);
+    add_transaction_qry.bindValue(":account", account);
+    bool in_batch = false;
+    qint64 batch_rows = 0;
+    qint64 line_number = 0;
+    bool result = true;
+    while(result && !input->atEnd()){
+        QString line = QString::fromUtf8(input->readLine()).trimmed();
+        line_number++;
+        if(line.isEmpty() || line.startsWith('#')) continue;
+        read++;
+
+        QStringList fields = line.split(',');
+        if(fields.size() < 4){
+            errors << "Line " << line_number << ": expected date,mode,amount,description" << endl;
+            rejected++;
+            continue;
+        }
+        QDate date = QDate::fromString(fields[0].trimmed(), Qt::ISODate);
+        if(!date.isValid()) date = QDate::fromString(fields[0].trimmed(), "MM/dd/yyyy");
+        QString mode = fields[1].trimmed();
+        bool amount_ok = false;
+        Money amount = Money::from_string(fields[2], &amount_ok);
+        QString description = QStringList(fields.mid(3)).join(',').trimmed();
+        if(!date.isValid() || !amount_ok){
+            errors << "Line " << line_number << ": invalid date or amount" << endl;
+            rejected++;
+            continue;
+        }
+        if(last_date.isValid() && date < last_date){
+            errors << "Line " << line_number << ": dated before the last transaction (" << last_date.toString(Qt::ISODate) << "), back-dated transactions have to be entered in the window" << endl;
+            rejected++;
+            continue;
+        }
+        switch(LedgerEngine::apply_transaction(description, mode, amount, balance)){
+        case LedgerEngine::INVALID_INPUT:
+            errors << "Line " << line_number << ": a description, positive amount and mode (Deposit/Withdraw) are required" << endl;
+            rejected++;
+            continue;
+        case LedgerEngine::INSUFFICIENT_FUNDS:
+            errors << "Line " << line_number << ": not enough money to withdraw " << amount.to_string() << " from " << balance.to_string() << endl;
+            rejected++;
+            continue;
+        case LedgerEngine::VALID:
+            break;
+        }
+
+        if(!in_batch){
+            in_batch = connection.transaction();
+            if(!in_batch){
+                logger->log(Logger::CRITICAL, "Error starting ingest batch", connection.lastError().text());
+                result = false;
+                break;
+            }
+        }
+        add_transaction_qry.bindValue(":desc", description);
+        add_transaction_qry.bindValue(":mode", mode);
+        add_transaction_qry.bindValue(":trans_amount", amount.to_cents());
+        add_transaction_qry.bindValue(":balance", balance.to_cents());
+        add_transaction_qry.bindValue(":date", date);
+        if(!db->exec(DatabaseManager::INSERT_TRANSACTION)){
+            errors << "Line " << line_number << ": " << add_transaction_qry.lastError().text() << endl;
+            result = false;
+            break;
+        }
+        batch_rows++;
+        //the balance was chained onto this row, a later line dated before it would break the ledger order
+        last_date = date;
+        if(batch_rows == INGEST_BATCH_SIZE){
+            result = connection.commit();
+            in_batch = false;
+            if(result) inserted += batch_rows;
+            batch_rows = 0;
+        }
+    }
+    if(in_batch){
+        if(result && connection.commit()){
+            inserted += batch_rows;
+        }else{
+            //only the uncommitted batch is lost, earlier batches stay.
+            connection.rollback();
+            result = false;
+        }
+    }
+    elapsed = timer.elapsed();
+    logger->log(result ? Logger::INFO : Logger::CRITICAL, "Batch ingest: " + summary());
+    return result;
+}
@@ -0,0 +1,47 @@
+#ifndef BATCHINGESTOR_H
+#define BATCHINGESTOR_H
+
+#include <QObject>
+#include <QIODevice>
+#include <QTextStream>
+#include "DatabaseManager.h"
+#include "Logger.h"
+
+/*
+ * Headless ingestion of transactions from stdin or a file, used by the --ingest command line mode.
+ * One transaction per line: date,mode,amount,description (description last so it may contain commas),
+ * dates as yyyy-MM-dd or MM/dd/yyyy. Blank lines and lines starting with # are skipped.
+ * Every row is checked with the same rules as the entry form, against a running balance held in memory,
+ * and valid rows are committed in large batches through one prepared insert.
+ * Rows are only appended: a line dated before the account's last transaction is rejected, since it would
+ * have to rebalance the rows after it.
+*/
+class BatchIngestor : public QObject
+{
+    Q_OBJECT
+public:
+    //rows are added to the given account, after its last transaction
+    explicit BatchIngestor(Logger * logger, DatabaseManager * db, qint64 account = DatabaseManager::DEFAULT_ACCOUNT, QObject *parent = 0);
+
+    //ingests every line of input, rejected lines are reported to errors. returns false if a batch failed to commit.
+    bool ingest(QIODevice * input, QTextStream & errors);
+
+    qint64 rows_read() const;
+    qint64 rows_inserted() const;
+    qint64 rows_rejected() const;
+    qint64 elapsed_ms() const;
+
+    //one line throughput summary
+    QString summary() const;
+
+private:
+    Logger * logger;
+    DatabaseManager * db;
+    qint64 account;
+    qint64 read;
+    qint64 inserted;
+    qint64 rejected;
+    qint64 elapsed;
+};
+
+#endif // BATCHINGESTOR_H
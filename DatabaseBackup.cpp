@@ -0,0 +1,184 @@
+#include "DatabaseBackup.h"
+#include "DatabaseManager.h"
+#include "Metrics.h"
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QSettings>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QThread>
+#include <sqlite3.h>
+
+//name of the backup thread's connection.
+#define BACKUP_CONNECTION_NAME "db_backup"
+//pages copied per step, the source is only locked for the length of one step.
+#define BACKUP_STEP_PAGES 256
+//ms slept between steps so the copy never holds the disk for long.
+#define BACKUP_STEP_SLEEP_MS 5
+//ms waited before retrying a step the database was too busy for.
+#define BACKUP_BUSY_SLEEP_MS 50
+//retention settings and their defaults, 0 = no limit. the newest backup is always kept.
+#define BACKUP_KEEP_COUNT_KEY "backups/keep_count"
+#define BACKUP_KEEP_COUNT_DEFAULT 10
+#define BACKUP_MAX_AGE_DAYS_KEY "backups/max_age_days"
+#define BACKUP_MAX_AGE_DAYS_DEFAULT 30
+//minutes between scheduled backups, 0 = only before imports and deletes.
+#define BACKUP_INTERVAL_MINUTES_KEY "backups/interval_minutes"
+#define BACKUP_INTERVAL_MINUTES_DEFAULT 60
+
+DatabaseBackup::DatabaseBackup(Logger * logger, QString db_path, QObject *parent) :
+    QObject(parent),
+    logger(logger),
+    db_path(db_path),
+    db(NULL)
+{
+}
+
+/*
+ * Runs on the backup thread when the thread finishes, the connection is removed on the thread that made it.
+*/
+DatabaseBackup::~DatabaseBackup(){
+    delete db;
+}
+
+QString DatabaseBackup::backup_dir() const{
+    return QFileInfo(db_path).absolutePath() + "/backups";
+}
+
+QFileInfoList DatabaseBackup::backups() const{
+    QStringList filters;
+    filters << QFileInfo(db_path).completeBaseName() + "-*.db";
+    return QDir(backup_dir()).entryInfoList(filters, QDir::Files, QDir::Time);
+}
+
+int DatabaseBackup::interval_minutes(){
+    return QSettings().value(BACKUP_INTERVAL_MINUTES_KEY, BACKUP_INTERVAL_MINUTES_DEFAULT).toInt();
+}
+
+void DatabaseBackup::cancel(){
+    cancelled.storeRelease(1);
+}
+
+/*
+ * The online backup when the driver's sqlite handle can be used, VACUUM INTO otherwise (see copy_vacuum()).
+*/
+void DatabaseBackup::run(QString reason){
+    ScopedTimer scope("backup.run");
+    QElapsedTimer timer;
+    timer.start();
+    cancelled.storeRelease(0);
+    if(db == NULL) db = new DatabaseManager(logger, db_path, BACKUP_CONNECTION_NAME);
+    if(!db->open()){
+        logger->log(Logger::CRITICAL, "Error opening the backup connection");
+        emit finished(false, reason, QString(), "Error opening the database for backup");
+        return;
+    }
+    if(!QDir().mkpath(backup_dir())){
+        logger->log(Logger::CRITICAL, "Error creating " + backup_dir());
+        emit finished(false, reason, QString(), "Error creating the backups folder " + backup_dir());
+        return;
+    }
+    QString file_name = backup_dir() + "/" + QFileInfo(db_path).completeBaseName() + "-"
+            + QDateTime::currentDateTime().toString("yyyyMMdd-HHmmss") + "-" + reason + ".db";
+    QString part_name = file_name + ".part";
+    QFile::remove(part_name);
+
+    int steps = 0;
+    int pages = 0;
+    QString error;
+    bool success;
+    sqlite3 * handle = db->handle();
+    if(handle != NULL){
+        success = copy_online(handle, part_name, steps, pages, error);
+    }else{
+        logger->log(Logger::DEBUG, "The sqlite driver doesn't share this program's sqlite library, backing up with VACUUM INTO");
+        success = copy_vacuum(part_name, pages, error);
+    }
+    if(success) success = QFile::rename(part_name, file_name);
+    if(!success){
+        QFile::remove(part_name);
+        QString message = cancelled.loadAcquire() ? QString("Backup cancelled") : "Error backing up the database: " + error;
+        logger->log(Logger::CRITICAL, message);
+        emit finished(false, reason, QString(), message);
+        return;
+    }
+    qint64 bytes = QFileInfo(file_name).size();
+    logger->log(Logger::INFO, QString("Backup (%1) to %2: %3 pages (%4 KB) in %5 steps, %6 ms")
+                .arg(reason)
+                .arg(file_name)
+                .arg(pages)
+                .arg(bytes / 1024)
+                .arg(steps)
+                .arg(timer.elapsed()));
+    prune();
+    emit finished(true, reason, file_name, "Backed up " + QString::number(pages) + " pages in " + QString::number(timer.elapsed()) + " ms");
+}
+
+/*
+ * The read transaction is started with a read so the snapshot is taken before the first step, the worker's
+ * commits during the copy then don't restart it. Busy steps are retried, anything else ends the backup.
+*/
+bool DatabaseBackup::copy_online(sqlite3 * handle, QString part_name, int & steps, int & pages, QString & error){
+    sqlite3 * target = NULL;
+    int rc = sqlite3_open_v2(QFile::encodeName(part_name).constData(), &target, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, NULL);
+    QSqlDatabase source = db->database();
+    bool in_snapshot = rc == SQLITE_OK && source.transaction();
+    if(in_snapshot){
+        QSqlQuery snapshot_qry = source.exec("SELECT count(*) FROM sqlite_master;");
+        in_snapshot = !snapshot_qry.lastError().isValid();
+    }
+    sqlite3_backup * backup = in_snapshot ? sqlite3_backup_init(target, "main", handle, "main") : NULL;
+    if(backup != NULL){
+        do{
+            rc = sqlite3_backup_step(backup, BACKUP_STEP_PAGES);
+            steps++;
+            if(rc == SQLITE_BUSY || rc == SQLITE_LOCKED){
+                QThread::msleep(BACKUP_BUSY_SLEEP_MS);
+            }else if(rc == SQLITE_OK){
+                QThread::msleep(BACKUP_STEP_SLEEP_MS);
+            }
+        }while((rc == SQLITE_OK || rc == SQLITE_BUSY || rc == SQLITE_LOCKED) && !cancelled.loadAcquire());
+        pages = sqlite3_backup_pagecount(backup);
+        sqlite3_backup_finish(backup);
+    }
+    error = target != NULL ? QString::fromUtf8(sqlite3_errmsg(target)) : QString("out of memory");
+    if(in_snapshot) source.commit();
+    sqlite3_close(target);
+    return backup != NULL && rc == SQLITE_DONE && !cancelled.loadAcquire();
+}
+
+/*
+ * Needs no handle, the driver's own sqlite writes the copy (sqlite 3.27+). It is one statement: it reads a
+ * consistent snapshot like the online backup and WAL lets the worker keep writing, but it can't be stepped,
+ * so a cancel only takes effect once it is done.
+*/
+bool DatabaseBackup::copy_vacuum(QString part_name, int & pages, QString & error){
+    QSqlDatabase source = db->database();
+    QSqlQuery vacuum_qry(source);
+    vacuum_qry.prepare("VACUUM INTO :file;");
+    vacuum_qry.bindValue(":file", part_name);
+    if(!vacuum_qry.exec()){
+        error = vacuum_qry.lastError().text();
+        return false;
+    }
+    QSqlQuery page_count_qry = source.exec("PRAGMA page_count;");
+    pages = page_count_qry.next() ? page_count_qry.value(0).toInt() : 0;
+    return !cancelled.loadAcquire();
+}
+
+void DatabaseBackup::prune(){
+    QSettings settings;
+    int keep_count = settings.value(BACKUP_KEEP_COUNT_KEY, BACKUP_KEEP_COUNT_DEFAULT).toInt();
+    int max_age_days = settings.value(BACKUP_MAX_AGE_DAYS_KEY, BACKUP_MAX_AGE_DAYS_DEFAULT).toInt();
+    QDateTime oldest = QDateTime::currentDateTime().addDays(-max_age_days);
+    QFileInfoList files = backups();
+    int removed = 0;
+    for(int i = 1; i < files.size(); i++){
+        bool too_many = keep_count > 0 && i >= keep_count;
+        bool too_old = max_age_days > 0 && files[i].lastModified() < oldest;
+        if((too_many || too_old) && QFile::remove(files[i].absoluteFilePath())) removed++;
+    }
+    if(removed > 0) logger->log(Logger::DEBUG, "Removed " + QString::number(removed) + " old backup(s)");
+}
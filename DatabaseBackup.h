@@ -0,0 +1,61 @@
+#ifndef DATABASEBACKUP_H
+#define DATABASEBACKUP_H
+
+#include <QObject>
+#include <QAtomicInt>
+#include <QFileInfoList>
+#include "Logger.h"
+
+class DatabaseManager;
+struct sqlite3;
+
+/*
+ * Copies the live database into the backups folder next to it with sqlite's online backup API.
+ * Move it to its own QThread, it opens its own read connection there. The copy is made a bounded number of
+ * pages per step inside one read transaction: WAL lets the DB worker keep writing while it runs and the
+ * copy is a consistent snapshot of the moment it started. If the QSQLITE driver doesn't run on the sqlite library
+ * this program links (a stock Qt bundles its own), the handle can't be used and the copy is made with VACUUM INTO.
+ * The file only gets its final name once complete.
+ * Retention is read from QSettings (see the BACKUP_ defines) on every run, older backups past it are deleted.
+*/
+class DatabaseBackup : public QObject
+{
+    Q_OBJECT
+public:
+    explicit DatabaseBackup(Logger * logger, QString db_path, QObject *parent = 0);
+    ~DatabaseBackup();
+
+    //the folder the backups are written to
+    QString backup_dir() const;
+
+    //the finished backups, newest first
+    QFileInfoList backups() const;
+
+    //minutes between scheduled backups from the settings, 0 = no scheduled backups
+    static int interval_minutes();
+
+public slots:
+    //takes one backup, reason ends up in the file name (e.g. "import", "scheduled"). emits finished when done
+    void run(QString reason);
+
+    //safe to call from any thread, the backup stops after the current step and its file is removed
+    void cancel();
+
+signals:
+    void finished(bool success, QString reason, QString file_name, QString message);
+
+private:
+    //copy the database into part_name, false with error set on failure or cancel
+    bool copy_online(sqlite3 * handle, QString part_name, int & steps, int & pages, QString & error);
+    bool copy_vacuum(QString part_name, int & pages, QString & error);
+
+    //deletes the backups past the retention settings, never the newest one
+    void prune();
+
+    Logger * logger;
+    QString db_path;
+    DatabaseManager * db;
+    QAtomicInt cancelled;
+};
+
+#endif // DATABASEBACKUP_H
@@ -0,0 +1,206 @@
+#include "DatabaseMaintenance.h"
+#include "DatabaseManager.h"
+#include "Metrics.h"
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QSettings>
+#include <QSqlError>
+#include <QSqlQuery>
+
+//name of the maintenance thread's connection.
+#define MAINTENANCE_CONNECTION_NAME "db_maintenance"
+//ms a slice may run for, a step already started is finished first.
+#define MAINTENANCE_SLICE_MS 200
+//free pages released per incremental_vacuum, each is its own short write transaction.
+#define MAINTENANCE_VACUUM_PAGES 256
+//rows ANALYZE samples per index, keeps it quick on large tables.
+#define MAINTENANCE_ANALYSIS_LIMIT 1000
+//hours between maintenance cycles and when the last one completed.
+#define MAINTENANCE_INTERVAL_HOURS_KEY "maintenance/interval_hours"
+#define MAINTENANCE_INTERVAL_HOURS_DEFAULT 24
+#define MAINTENANCE_LAST_RUN_KEY "maintenance/last_run"
+//seconds without a request before maintenance may start.
+#define MAINTENANCE_IDLE_SECONDS_KEY "maintenance/idle_seconds"
+#define MAINTENANCE_IDLE_SECONDS_DEFAULT 60
+//PRAGMA auto_vacuum value for incremental.
+#define AUTO_VACUUM_INCREMENTAL 2
+
+DatabaseMaintenance::DatabaseMaintenance(Logger * logger, QString db_path, QObject *parent) :
+    QObject(parent),
+    logger(logger),
+    db_path(db_path),
+    db(NULL),
+    step(IDLE),
+    size_before(0),
+    pages_reclaimed(0),
+    spent_ms(0),
+    slices(0)
+{
+}
+
+/*
+ * Runs on the maintenance thread when the thread finishes, the connection is removed on the thread that made it.
+*/
+DatabaseMaintenance::~DatabaseMaintenance(){
+    delete db;
+}
+
+bool DatabaseMaintenance::is_due(){
+    QSettings settings;
+    QDateTime last_run = settings.value(MAINTENANCE_LAST_RUN_KEY).toDateTime();
+    int interval_hours = settings.value(MAINTENANCE_INTERVAL_HOURS_KEY, MAINTENANCE_INTERVAL_HOURS_DEFAULT).toInt();
+    return !last_run.isValid() || last_run.addSecs(qint64(interval_hours) * 3600) <= QDateTime::currentDateTime();
+}
+
+int DatabaseMaintenance::idle_seconds(){
+    return QSettings().value(MAINTENANCE_IDLE_SECONDS_KEY, MAINTENANCE_IDLE_SECONDS_DEFAULT).toInt();
+}
+
+void DatabaseMaintenance::cancel(){
+    cancelled.storeRelease(1);
+}
+
+qint64 DatabaseMaintenance::pragma_value(QString pragma){
+    QSqlQuery pragma_qry = db->database().exec("PRAGMA " + pragma + ";");
+    return pragma_qry.next() ? pragma_qry.value(0).toLongLong() : -1;
+}
+
+qint64 DatabaseMaintenance::disk_size() const{
+    return QFileInfo(db_path).size() + QFileInfo(db_path + "-wal").size();
+}
+
+void DatabaseMaintenance::fail(QString message){
+    logger->log(Logger::CRITICAL, message);
+    step = IDLE;
+    emit finished(false, message);
+}
+
+void DatabaseMaintenance::run_slice(){
+    ScopedTimer scope("maintenance.slice");
+    QElapsedTimer timer;
+    timer.start();
+    cancelled.storeRelease(0);
+    if(db == NULL) db = new DatabaseManager(logger, db_path, MAINTENANCE_CONNECTION_NAME);
+    if(!db->open()){
+        fail("Error opening the database for maintenance");
+        return;
+    }
+    if(step == IDLE){
+        step = RECLAIM;
+        size_before = disk_size();
+        pages_reclaimed = 0;
+        spent_ms = 0;
+        slices = 0;
+        problems.clear();
+        tables_to_check.clear();
+        QSqlQuery tables_qry = db->database().exec("SELECT name FROM sqlite_master WHERE type = 'table' AND name NOT LIKE 'sqlite_%' AND sql NOT LIKE 'CREATE VIRTUAL%' ORDER BY name;");
+        while(tables_qry.next()) tables_to_check << tables_qry.value(0).toString();
+        logger->log(Logger::DEBUG, "Starting database maintenance, " + QString::number(size_before / 1024) + " KB on disk");
+    }
+    bool result = true;
+    while(result && step != DONE && timer.elapsed() < MAINTENANCE_SLICE_MS && !cancelled.loadAcquire()){
+        result = run_step();
+    }
+    slices++;
+    spent_ms += timer.elapsed();
+    if(!result) return;
+    if(step != DONE){
+        emit slice_finished();
+        return;
+    }
+
+    step = IDLE;
+    qint64 reclaimed = size_before - disk_size();
+    Metrics::instance().add_count("maintenance.bytes_reclaimed", qMax(reclaimed, qint64(0)));
+    QSettings().setValue(MAINTENANCE_LAST_RUN_KEY, QDateTime::currentDateTime());
+    QString message = QString("Maintenance reclaimed %1 KB (%2 free pages) in %3 ms over %4 slices")
+            .arg(reclaimed / 1024)
+            .arg(pages_reclaimed)
+            .arg(spent_ms)
+            .arg(slices);
+    if(!problems.isEmpty()){
+        logger->log(Logger::CRITICAL, "Integrity check found problems", problems.join("\n"));
+        message += ", the integrity check found problems (see the log)";
+    }
+    logger->log(Logger::INFO, message);
+    emit finished(problems.isEmpty(), message);
+}
+
+bool DatabaseMaintenance::run_step(){
+    QSqlDatabase connection = db->database();
+    switch(step){
+    case RECLAIM:{
+        qint64 free_pages = pragma_value("freelist_count");
+        if(pragma_value("auto_vacuum") != AUTO_VACUUM_INCREMENTAL){
+            //only a full VACUUM could convert it, which rewrites the file under the write lock: not in a slice.
+            //the free pages are reused by later inserts, the file is converted when it is next emptied
+            logger->log(Logger::DEBUG, "The database predates incremental vacuum, " + QString::number(free_pages) + " free pages left in place");
+            step = ANALYZE;
+            return true;
+        }
+        if(free_pages <= 0){
+            step = ANALYZE;
+            return true;
+        }
+        //read to the end, the pragma only frees pages as far as it is stepped
+        QSqlQuery vacuum_qry(connection);
+        vacuum_qry.setForwardOnly(true);
+        if(!vacuum_qry.exec("PRAGMA incremental_vacuum(" + QString::number(MAINTENANCE_VACUUM_PAGES) + ");")){
+            fail("Error reclaiming free pages: " + vacuum_qry.lastError().text());
+            return false;
+        }
+        while(vacuum_qry.next()){}
+        vacuum_qry.finish();
+        qint64 freed = free_pages - qMax(pragma_value("freelist_count"), qint64(0));
+        pages_reclaimed += freed;
+        //nothing freed (e.g. a reader holds the pages), left for the next cycle
+        if(freed <= 0) step = ANALYZE;
+        return true;
+    }
+    case ANALYZE:{
+        connection.exec("PRAGMA analysis_limit = " + QString::number(MAINTENANCE_ANALYSIS_LIMIT) + ";");
+        QSqlQuery analyze_qry = connection.exec("ANALYZE;");
+        if(analyze_qry.lastError().isValid()){
+            fail("Error analyzing the database: " + analyze_qry.lastError().text());
+            return false;
+        }
+        connection.exec("PRAGMA optimize;");
+        step = CHECK;
+        return true;
+    }
+    case CHECK:{
+        if(tables_to_check.isEmpty()){
+            step = CHECKPOINT;
+            return true;
+        }
+        QString table = tables_to_check.takeFirst();
+        QSqlQuery check_qry(connection);
+        check_qry.setForwardOnly(true);
+        if(!check_qry.exec("PRAGMA quick_check(\"" + table + "\");")){
+            //sqlite before 3.33 can't check a single table, the whole file is checked at once instead
+            tables_to_check.clear();
+            if(!check_qry.exec("PRAGMA quick_check;")){
+                fail("Error checking the database: " + check_qry.lastError().text());
+                return false;
+            }
+        }
+        while(check_qry.next()){
+            QString result = check_qry.value(0).toString();
+            if(result != "ok") problems << result;
+        }
+        return true;
+    }
+    case CHECKPOINT:{
+        QSqlQuery checkpoint_qry = connection.exec("PRAGMA wal_checkpoint(TRUNCATE);");
+        //busy when a reader is still on the WAL, it is then left for the next cycle
+        if(checkpoint_qry.next() && checkpoint_qry.value(0).toInt() != 0) logger->log(Logger::DEBUG, "WAL checkpoint busy, WAL not truncated");
+        step = DONE;
+        return true;
+    }
+    case IDLE:
+    case DONE:
+        break;
+    }
+    return true;
+}
@@ -0,0 +1,84 @@
+#ifndef DATABASEMAINTENANCE_H
+#define DATABASEMAINTENANCE_H
+
+#include <QObject>
+#include <QAtomicInt>
+#include <QStringList>
+#include "Logger.h"
+
+class DatabaseManager;
+
+/*
+ * Keeps the database file compact and its planner statistics fresh while the program is idle.
+ * Move it to its own QThread, it opens its own connection there. One maintenance cycle is:
+ *   reclaim     PRAGMA incremental_vacuum, a bounded # of free pages at a time (skipped for a database created
+ *               before auto_vacuum was turned on, converting it takes a full VACUUM, see DatabaseWorker::delete_all())
+ *   analyze     ANALYZE with an analysis_limit, then PRAGMA optimize
+ *   check       PRAGMA quick_check, one table at a time
+ *   checkpoint  PRAGMA wal_checkpoint(TRUNCATE) so the WAL file shrinks back
+ * and is run in slices: run_slice() works for at most MAINTENANCE_SLICE_MS and answers with slice_finished(),
+ * the caller asks for the next slice only while it stays idle. The cycle's reclaimed bytes and the time spent
+ * are logged and reported with finished(). Cycles are due every maintenance/interval_hours (QSettings).
+*/
+class DatabaseMaintenance : public QObject
+{
+    Q_OBJECT
+public:
+    explicit DatabaseMaintenance(Logger * logger, QString db_path, QObject *parent = 0);
+    ~DatabaseMaintenance();
+
+    //true once the last completed cycle is older than the interval from the settings
+    static bool is_due();
+
+    //seconds without a request before maintenance may start, from the settings
+    static int idle_seconds();
+
+public slots:
+    //runs the current cycle (starting one if none is in progress) for one slice
+    void run_slice();
+
+    //safe to call from any thread, the slice in progress stops after its current step
+    void cancel();
+
+signals:
+    void slice_finished();
+    void finished(bool success, QString message);
+
+private:
+    enum Step{
+        IDLE,
+        RECLAIM,
+        ANALYZE,
+        CHECK,
+        CHECKPOINT,
+        DONE
+    };
+
+    //runs one bounded piece of the current step, moving on to the next step once it is complete
+    bool run_step();
+
+    //first value of a pragma, -1 if it fails
+    qint64 pragma_value(QString pragma);
+
+    //size of the database file plus its WAL
+    qint64 disk_size() const;
+
+    //ends the cycle with a failure
+    void fail(QString message);
+
+    Logger * logger;
+    QString db_path;
+    DatabaseManager * db;
+    QAtomicInt cancelled;
+
+    //the cycle in progress
+    Step step;
+    qint64 size_before;
+    qint64 pages_reclaimed;
+    qint64 spent_ms;
+    int slices;
+    QStringList tables_to_check;
+    QStringList problems;
+};
+
+#endif // DATABASEMAINTENANCE_H
@@ -0,0 +1,525 @@
+#include "DatabaseManager.h"
+#include "Metrics.h"
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QSqlDriver>
+#include <QSqlError>
+#include <QStandardPaths>
+#include <QStringList>
+#include <QVector>
+#include <sqlite3.h>
+
+static const char CREATE_TRANSACTIONS[] = "CREATE TABLE IF NOT EXISTS transactions(id INTEGER PRIMARY KEY AUTOINCREMENT, description TEXT, mode TEXT, trans_amount INTEGER, balance INTEGER, date_added DATE, account_id INTEGER NOT NULL DEFAULT 1);";
+
+DatabaseManager::DatabaseManager(Logger * logger, QString db_path, QString connection_name, QObject *parent) :
+    QObject(parent),
+    logger(logger),
+    db_path(db_path),
+    connection_name(connection_name),
+    active_profile(SAFE)
+{
+}
+
+DatabaseManager::~DatabaseManager(){
+    logger->log(Logger::DEBUG, stats_report());
+    close();
+    db = QSqlDatabase();
+    QSqlDatabase::removeDatabase(connection_name);
+}
+
+QString DatabaseManager::default_path(){
+//    return QDir::fromNativeSeparators(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/transaction_db.db");
+    return QDir::fromNativeSeparators(QStandardPaths::writableLocation(QStandardPaths::ApplicationsLocation) + "/transaction_db.db");
+}
+
+void DatabaseManager::set_profile(Profile profile){
+    active_profile = profile;
+}
+
+DatabaseManager::Profile DatabaseManager::profile() const{
+    return active_profile;
+}
+
+QString DatabaseManager::profile_name(Profile profile){
+    switch(profile){
+    case SAFE:
+        return "safe";
+    case FAST_INGEST:
+        return "fast ingest";
+    }
+    return "";
+}
+
+/*
+ * Opens the connection once, subsequent calls reuse it.
+*/
+bool DatabaseManager::open(){
+    if(db.isOpen()) return true;
+    if(!db.isValid()){
+        db = QSqlDatabase::addDatabase("QSQLITE", connection_name);
+        db.setDatabaseName(db_path);
+    }
+    bool status = db.open();
+    logger->log(Logger::DEBUG, "Database open status: " + (status ? QString("True") : QString("False")));
+    if(!status){
+        logger->log(Logger::CRITICAL, "Failed to open database", db.lastError().text());
+        return false;
+    }
+    apply_profile();
+    return true;
+}
+
+/*
+ * journal_mode is stored in the file, every other setting only lasts for this connection.
+ * WAL lets the GUI connection read while the worker writes. cache_size is negative so it is in KiB, not pages.
+ * A failed pragma is logged but doesn't fail the open, sqlite keeps its default for that setting.
+*/
+bool DatabaseManager::apply_profile(){
+    static const char * safe_profile[] = {
+        "PRAGMA journal_mode = WAL;",
+        "PRAGMA synchronous = FULL;",
+        "PRAGMA cache_size = -16384;",
+        "PRAGMA mmap_size = 0;",
+        "PRAGMA temp_store = MEMORY;",
+        "PRAGMA busy_timeout = 5000;"
+    };
+    static const char * fast_ingest_profile[] = {
+        "PRAGMA journal_mode = WAL;",
+        "PRAGMA synchronous = OFF;",
+        "PRAGMA cache_size = -262144;",
+        "PRAGMA mmap_size = 268435456;",
+        "PRAGMA temp_store = MEMORY;",
+        "PRAGMA busy_timeout = 5000;"
+    };
+    const char ** pragmas = active_profile == FAST_INGEST ? fast_ingest_profile : safe_profile;
+    int count = active_profile == FAST_INGEST ? int(sizeof(fast_ingest_profile) / sizeof(fast_ingest_profile[0]))
+                                              : int(sizeof(safe_profile) / sizeof(safe_profile[0]));
+    bool result = true;
+    for(int i = 0; i < count; i++){
+        QSqlQuery pragma_qry = db.exec(pragmas[i]);
+        if(pragma_qry.lastError().isValid()){
+            logger->log(Logger::WARNING, QString("Profile setting ") + pragmas[i] + " failed: " + pragma_qry.lastError().text());
+            result = false;
+        }
+    }
+
+    //read back what sqlite actually uses, e.g. an in-memory database stays out of WAL mode
+    QStringList settings;
+    static const char * names[] = {"journal_mode", "synchronous", "cache_size", "mmap_size", "temp_store", "busy_timeout"};
+    for(unsigned i = 0; i < sizeof(names) / sizeof(names[0]); i++){
+        QSqlQuery setting_qry = db.exec(QString("PRAGMA ") + names[i] + ";");
+        settings << QString(names[i]) + "=" + (setting_qry.next() ? setting_qry.value(0).toString() : QString("?"));
+    }
+    logger->log(Logger::INFO, "SQLite profile " + profile_name(active_profile) + " (" + connection_name + "): " + settings.join(", "));
+    return result;
+}
+
+/*
+ * Frees the cached statements before closing, a prepared statement can't outlive its connection.
+*/
+void DatabaseManager::close(){
+    qDeleteAll(statement_cache);
+    statement_cache.clear();
+    if(db.isOpen()){
+        logger->log(Logger::DEBUG, "Closing database");
+        db.close();
+    }
+}
+
+bool DatabaseManager::is_open() const{
+    return db.isOpen();
+}
+
+QSqlDatabase DatabaseManager::database() const{
+    return db;
+}
+
+/*
+ * A stock Qt build bundles its own sqlite in the driver, calling this program's sqlite on that connection
+ * would mix two library instances on one handle. The driver's sqlite is asked for its source id through sql
+ * (always safe) and the handle is only handed out if it is the linked library, and if that library then
+ * sees the handle open on this database's file.
+*/
+sqlite3 * DatabaseManager::handle() const{
+    if(!db.isOpen()) return NULL;
+    QVariant handle = db.driver()->handle();
+    if(!handle.isValid() || qstrcmp(handle.typeName(), "sqlite3*") != 0) return NULL;
+    QSqlQuery source_qry = db.exec("SELECT sqlite_source_id();");
+    if(!source_qry.next() || source_qry.value(0).toString() != QLatin1String(sqlite3_sourceid())) return NULL;
+    source_qry.finish();
+    sqlite3 * connection = *static_cast<sqlite3 * const *>(handle.constData());
+    const char * file_name = sqlite3_db_filename(connection, "main");
+    if(file_name == NULL || QFileInfo(QFile::decodeName(file_name)).canonicalFilePath() != QFileInfo(db_path).canonicalFilePath()) return NULL;
+    return connection;
+}
+
+int DatabaseManager::schema_version() const{
+    QSqlQuery version_qry = db.exec("PRAGMA user_version;");
+    return version_qry.next() ? version_qry.value(0).toInt() : 0;
+}
+
+/*
+ * Version 0 databases store amounts and balances as DOUBLE dollars. The table is rebuilt with the values
+ * rounded to INTEGER cents, ids are kept. Version 1 tables only gain the account_id column.
+ * Either way every existing row ends up in DEFAULT_ACCOUNT and the single account indexes are dropped,
+ * ensure_schema() recreates them per account.
+ * Up to version 2 balances were chained in id order: the account_balances table, its triggers and the date index
+ * are dropped (ensure_schema() recreates them for the (date_added, id) order) and every balance that differs in
+ * ledger order is rewritten, in the same transaction.
+ * A database without a transactions table is new and only needs the version stamped.
+*/
+bool DatabaseManager::migrate(){
+    int version = schema_version();
+    if(version >= SCHEMA_VERSION) return true;
+
+    QSqlQuery table_qry = db.exec("SELECT count(*) FROM sqlite_master WHERE type = 'table' AND name = 'transactions';");
+    bool has_transactions = table_qry.next() && table_qry.value(0).toInt() > 0;
+    table_qry.finish();
+
+    QStringList steps;
+    if(has_transactions && version < 2){
+        steps << "DROP INDEX IF EXISTS transactions_date_added;"
+              << "DROP INDEX IF EXISTS transactions_trans_amount;";
+        if(version == 0){
+            steps << "ALTER TABLE transactions RENAME TO transactions_v0;"
+                  << CREATE_TRANSACTIONS
+                  << "INSERT INTO transactions (id, description, mode, trans_amount, balance, date_added) "
+                     "SELECT id, description, mode, CAST(ROUND(trans_amount * 100) AS INTEGER), CAST(ROUND(balance * 100) AS INTEGER), date_added FROM transactions_v0;"
+                  << "DROP TABLE transactions_v0;";
+        }else{
+            steps << "ALTER TABLE transactions ADD COLUMN account_id INTEGER NOT NULL DEFAULT 1;";
+        }
+    }
+    if(has_transactions){
+        steps << "DROP TRIGGER IF EXISTS account_balances_insert;"
+              << "DROP TRIGGER IF EXISTS account_balances_update;"
+              << "DROP TRIGGER IF EXISTS account_balances_delete;"
+              << "DROP TABLE IF EXISTS account_balances;"
+              << "DROP INDEX IF EXISTS transactions_account_date;";
+    }
+    steps << "PRAGMA user_version = " + QString::number(SCHEMA_VERSION) + ";";
+
+    QElapsedTimer timer;
+    timer.start();
+    if(!db.transaction()){
+        logger->log(Logger::CRITICAL, "Error starting schema migration", db.lastError().text());
+        return false;
+    }
+    foreach(const QString & step, steps){
+        QSqlQuery step_qry = db.exec(step);
+        if(step_qry.lastError().isValid()){
+            logger->log(Logger::CRITICAL, "Schema migration failed", step_qry.lastError().text());
+            db.rollback();
+            return false;
+        }
+    }
+    if(has_transactions && rebalance_ledgers(db, logger) < 0){
+        db.rollback();
+        return false;
+    }
+    if(!db.commit()){
+        logger->log(Logger::CRITICAL, "Error committing schema migration", db.lastError().text());
+        db.rollback();
+        return false;
+    }
+    if(has_transactions) logger->log(Logger::INFO, QString("Migrated schema from version %1 to %2 (cents, accounts, date order) in %3 ms")
+                                     .arg(version).arg(SCHEMA_VERSION).arg(timer.elapsed()));
+    return true;
+}
+
+/*
+ * One ordered pass over the account's (or every account's) rows, the fixes are collected first and written with one prepared
+ * UPDATE by id (most ledgers were entered in date order and need few or none).
+*/
+qint64 DatabaseManager::rebalance_ledgers(QSqlDatabase db, Logger * logger, qint64 account){
+    QSqlQuery rows_qry(db);
+    rows_qry.setForwardOnly(true);
+    rows_qry.prepare(QString("SELECT id, account_id, mode, trans_amount, balance FROM transactions")
+                     + (account > 0 ? " WHERE account_id = :account" : "") + " ORDER BY account_id, date_added, id;");
+    if(account > 0) rows_qry.bindValue(":account", account);
+    if(!rows_qry.exec()){
+        logger->log(Logger::CRITICAL, "Error reading the ledgers to rebalance", rows_qry.lastError().text());
+        return -1;
+    }
+    QVector<qint64> ids;
+    QVector<qint64> balances;
+    qint64 rows = 0;
+    qint64 negative = 0;
+    qint64 row_account = 0;
+    qint64 balance = 0;
+    while(rows_qry.next()){
+        if(rows == 0 || rows_qry.value(1).toLongLong() != row_account){
+            row_account = rows_qry.value(1).toLongLong();
+            balance = 0;
+        }
+        qint64 amount = rows_qry.value(3).toLongLong();
+        balance += rows_qry.value(2).toString() == "Deposit" ? amount : -amount;
+        if(rows_qry.value(4).toLongLong() != balance){
+            ids.append(rows_qry.value(0).toLongLong());
+            balances.append(balance);
+        }
+        if(balance < 0) negative++;
+        rows++;
+    }
+    rows_qry.finish();
+
+    QSqlQuery update_qry(db);
+    update_qry.prepare("UPDATE transactions SET balance = :balance WHERE id = :id;");
+    for(int i = 0; i < ids.size(); i++){
+        update_qry.bindValue(":balance", balances[i]);
+        update_qry.bindValue(":id", ids[i]);
+        if(!update_qry.exec()){
+            logger->log(Logger::CRITICAL, "Error rebalancing the ledgers", update_qry.lastError().text());
+            return -1;
+        }
+    }
+    logger->log(Logger::INFO, QString("Rebalanced %1 of %2 transactions in date order").arg(ids.size()).arg(rows));
+    if(negative > 0) logger->log(Logger::WARNING, QString("%1 balances are negative in date order, see Database > Verify Balances").arg(negative));
+    return ids.size();
+}
+
+/*
+ * Idempotent, also called after an import replaces an account's rows.
+ * Every account has its own balance chain, running in ledger order: by date_added, then by id for transactions
+ * added on the same day. The (account_id, date_added, id) index walks that order and bounds the rows after a
+ * back-dated transaction, and answers a balance on a date with one seek (see BALANCE_ON_DATE). The (account_id, ...)
+ * indexes keep an account's rows together.
+ * account_balances holds one row per account with its last transaction's id and balance, kept up to date by
+ * triggers on every write so the window can show the total at startup without reading the ledger.
+ * Amounts and balances are INTEGER cents, see Money.
+*/
+bool DatabaseManager::ensure_schema(){
+    static const char * schema[] = {
+        //only takes effect on a new file, DatabaseMaintenance converts older ones
+        "PRAGMA auto_vacuum = INCREMENTAL;",
+        CREATE_TRANSACTIONS,
+        "CREATE TABLE IF NOT EXISTS accounts(id INTEGER PRIMARY KEY AUTOINCREMENT, name TEXT NOT NULL UNIQUE);",
+        "INSERT INTO accounts (id, name) SELECT 1, 'Main' WHERE NOT EXISTS (SELECT 1 FROM accounts);",
+        "CREATE INDEX IF NOT EXISTS transactions_account ON transactions(account_id, id);",
+        "CREATE INDEX IF NOT EXISTS transactions_ledger ON transactions(account_id, date_added, id);",
+        "CREATE INDEX IF NOT EXISTS transactions_account_amount ON transactions(account_id, trans_amount);",
+        //databases written by earlier builds kept per day checkpoints, every write rewrote the later days' rows
+        "DROP TRIGGER IF EXISTS balance_checkpoints_insert;",
+        "DROP TRIGGER IF EXISTS balance_checkpoints_delete;",
+        "DROP TRIGGER IF EXISTS balance_checkpoints_update;",
+        "DROP TABLE IF EXISTS balance_checkpoints;",
+        "CREATE TABLE IF NOT EXISTS account_balances(account_id INTEGER PRIMARY KEY, last_id INTEGER NOT NULL DEFAULT 0, balance INTEGER NOT NULL DEFAULT 0);",
+        "INSERT OR IGNORE INTO account_balances (account_id, last_id, balance) SELECT accounts.id, "
+            "COALESCE((SELECT id FROM transactions WHERE account_id = accounts.id ORDER BY date_added DESC, id DESC LIMIT 1), 0), "
+            "COALESCE((SELECT balance FROM transactions WHERE account_id = accounts.id ORDER BY date_added DESC, id DESC LIMIT 1), 0) FROM accounts;",
+        //a back-dated insert isn't the last row, the UPDATE shifting the later balances brings the total along.
+        //the new row is only compared with the current last row (a primary key lookup), never with the ledger
+        "CREATE TRIGGER IF NOT EXISTS account_balances_insert AFTER INSERT ON transactions BEGIN "
+            "INSERT OR IGNORE INTO account_balances (account_id, last_id, balance) VALUES (NEW.account_id, 0, 0); "
+            "UPDATE account_balances SET last_id = NEW.id, balance = NEW.balance WHERE account_id = NEW.account_id AND NOT EXISTS ("
+                "SELECT 1 FROM transactions AS last WHERE last.id = account_balances.last_id AND ((last.date_added, last.id) > (NEW.date_added, NEW.id) "
+                "OR (NEW.date_added IS NULL AND (last.date_added IS NOT NULL OR last.id > NEW.id)))); "
+        "END;",
+        "CREATE TRIGGER IF NOT EXISTS account_balances_update AFTER UPDATE OF balance, date_added ON transactions "
+            "WHEN NEW.id = (SELECT last_id FROM account_balances WHERE account_id = NEW.account_id) OR NEW.date_added IS NOT OLD.date_added BEGIN "
+            "UPDATE account_balances SET "
+                "last_id = COALESCE((SELECT id FROM transactions WHERE account_id = NEW.account_id ORDER BY date_added DESC, id DESC LIMIT 1), 0), "
+                "balance = COALESCE((SELECT balance FROM transactions WHERE account_id = NEW.account_id ORDER BY date_added DESC, id DESC LIMIT 1), 0) "
+            "WHERE account_id = NEW.account_id; "
+        "END;",
+        "CREATE TRIGGER IF NOT EXISTS account_balances_delete AFTER DELETE ON transactions "
+            "WHEN OLD.id = (SELECT last_id FROM account_balances WHERE account_id = OLD.account_id) BEGIN "
+            "UPDATE account_balances SET "
+                "last_id = COALESCE((SELECT id FROM transactions WHERE account_id = OLD.account_id ORDER BY date_added DESC, id DESC LIMIT 1), 0), "
+                "balance = COALESCE((SELECT balance FROM transactions WHERE account_id = OLD.account_id ORDER BY date_added DESC, id DESC LIMIT 1), 0) "
+            "WHERE account_id = OLD.account_id; "
+        "END;"
+    };
+    if(!migrate()) return false;
+    bool result = true;
+    for(unsigned i = 0; i < sizeof(schema) / sizeof(schema[0]); i++){
+        QSqlQuery schema_qry = db.exec(schema[i]);
+        logger->log(Logger::DEBUG, "Schema qry " + QString::number(i), schema_qry.lastError().text());
+        if(schema_qry.lastError().isValid()) result = false;
+    }
+    return ensure_search_index() && result;
+}
+
+bool DatabaseManager::last_known_balance(qint64 account, Money & balance) const{
+    QSqlQuery balance_qry(db);
+    balance_qry.prepare("SELECT balance FROM account_balances WHERE account_id = :account;");
+    balance_qry.bindValue(":account", account);
+    if(!balance_qry.exec() || !balance_qry.next()) return false;
+    balance = Money::from_cents(balance_qry.value(0).toLongLong());
+    return true;
+}
+
+bool DatabaseManager::has_search_index() const{
+    QSqlQuery table_qry = db.exec("SELECT count(*) FROM sqlite_master WHERE type = 'table' AND name = 'transactions_fts';");
+    return table_qry.next() && table_qry.value(0).toInt() > 0;
+}
+
+/*
+ * transactions_fts is an external content FTS5 table: it only holds the index, the text stays in transactions.
+ * Without FTS5 in the sqlite build the search falls back to LIKE, so that isn't an error.
+*/
+bool DatabaseManager::ensure_search_index(){
+    static const char * triggers[] = {
+        "CREATE TRIGGER IF NOT EXISTS transactions_fts_insert AFTER INSERT ON transactions BEGIN "
+            "INSERT INTO transactions_fts (rowid, description) VALUES (NEW.id, NEW.description); "
+        "END;",
+        "CREATE TRIGGER IF NOT EXISTS transactions_fts_delete AFTER DELETE ON transactions BEGIN "
+            "INSERT INTO transactions_fts (transactions_fts, rowid, description) VALUES ('delete', OLD.id, OLD.description); "
+        "END;",
+        "CREATE TRIGGER IF NOT EXISTS transactions_fts_update AFTER UPDATE OF description ON transactions BEGIN "
+            "INSERT INTO transactions_fts (transactions_fts, rowid, description) VALUES ('delete', OLD.id, OLD.description); "
+            "INSERT INTO transactions_fts (rowid, description) VALUES (NEW.id, NEW.description); "
+        "END;"
+    };
+    bool created = !has_search_index();
+    if(created){
+        QSqlQuery fts_qry = db.exec("CREATE VIRTUAL TABLE transactions_fts USING fts5(description, content='transactions', content_rowid='id');");
+        if(fts_qry.lastError().isValid()){
+            logger->log(Logger::WARNING, "FTS5 unavailable, searches will scan the descriptions", fts_qry.lastError().text());
+            return true;
+        }
+    }
+    bool result = true;
+    for(unsigned i = 0; i < sizeof(triggers) / sizeof(triggers[0]); i++){
+        QSqlQuery trigger_qry = db.exec(triggers[i]);
+        logger->log(Logger::DEBUG, "Search index trigger qry " + QString::number(i), trigger_qry.lastError().text());
+        if(trigger_qry.lastError().isValid()) result = false;
+    }
+    if(created) result = rebuild_search_index() && result;
+    return result;
+}
+
+bool DatabaseManager::rebuild_search_index(){
+    if(!has_search_index()) return true;
+    QElapsedTimer timer;
+    timer.start();
+    QSqlQuery rebuild_qry = db.exec("INSERT INTO transactions_fts (transactions_fts) VALUES ('rebuild');");
+    if(rebuild_qry.lastError().isValid()){
+        logger->log(Logger::CRITICAL, "Error rebuilding the search index", rebuild_qry.lastError().text());
+        return false;
+    }
+    logger->log(Logger::INFO, "Search index rebuilt in " + QString::number(timer.elapsed()) + " ms");
+    return true;
+}
+
+/*
+ * Dated positions compare as a row value, which sqlite turns into one range of the ledger index.
+*/
+QString DatabaseManager::rows_after(QString name, QDate date, bool inclusive){
+    QString op = inclusive ? ">=" : ">";
+    if(date.isValid()) return "(date_added, id) " + op + " (" + name + "_date, " + name + "_id)";
+    return "(date_added IS NOT NULL OR id " + op + " " + name + "_id)";
+}
+
+QString DatabaseManager::rows_before(QString name, QDate date, bool inclusive){
+    QString op = inclusive ? "<=" : "<";
+    if(date.isValid()) return "(date_added IS NULL OR (date_added, id) " + op + " (" + name + "_date, " + name + "_id))";
+    return "(date_added IS NULL AND id " + op + " " + name + "_id)";
+}
+
+void DatabaseManager::bind_position(QSqlQuery & qry, QString name, QDate date, qint64 id){
+    if(date.isValid()) qry.bindValue(name + "_date", date);
+    qry.bindValue(name + "_id", id);
+}
+
+const char * DatabaseManager::statement_sql(Statement statement){
+    switch(statement){
+    case LAST_BALANCE:
+        return "SELECT balance, date_added FROM transactions WHERE account_id = :account ORDER BY date_added DESC, id DESC LIMIT 1;";
+    case INSERT_TRANSACTION:
+        return "INSERT INTO transactions (description, mode, trans_amount, balance, date_added, account_id) VALUES (:desc, :mode, :trans_amount, :balance, :date, :account);";
+    case COUNT_TRANSACTIONS:
+        return "SELECT count(id) FROM transactions WHERE account_id = :account;";
+    case SELECT_ALL_TRANSACTIONS:
+        return "SELECT id, description, mode, trans_amount, balance, date_added FROM transactions WHERE account_id = :account ORDER BY date_added, id;";
+    case BALANCE_ON_DATE:
+        return "SELECT balance FROM transactions WHERE account_id = :account AND date_added <= :date ORDER BY date_added DESC, id DESC LIMIT 1;";
+    case MIN_BALANCE_AFTER_DATE:
+        return "SELECT MIN(balance) FROM transactions WHERE account_id = :account AND date_added > :date;";
+    case SHIFT_BALANCES_AFTER_DATE:
+        return "UPDATE transactions SET balance = balance + :change WHERE account_id = :account AND date_added > :date;";
+    case TRANSACTION_DATE:
+        return "SELECT date_added FROM transactions WHERE id = :id AND account_id = :account;";
+    }
+    return "";
+}
+
+const char * DatabaseManager::statement_name(Statement statement){
+    switch(statement){
+    case LAST_BALANCE:
+        return "last balance";
+    case INSERT_TRANSACTION:
+        return "insert transaction";
+    case COUNT_TRANSACTIONS:
+        return "count transactions";
+    case SELECT_ALL_TRANSACTIONS:
+        return "select all transactions";
+    case BALANCE_ON_DATE:
+        return "balance on date";
+    case MIN_BALANCE_AFTER_DATE:
+        return "min balance after date";
+    case SHIFT_BALANCES_AFTER_DATE:
+        return "shift balances after date";
+    case TRANSACTION_DATE:
+        return "transaction date";
+    }
+    return "";
+}
+
+/*
+ * Looks the statement up in the cache, preparing and caching it on a miss.
+*/
+QSqlQuery & DatabaseManager::prepared(Statement statement){
+    StatementStats & stat = stats[statement];
+    QHash<int, QSqlQuery*>::iterator it = statement_cache.find(statement);
+    if(it != statement_cache.end()){
+        stat.hits++;
+        return *it.value();
+    }
+    stat.misses++;
+    QSqlQuery * qry = new QSqlQuery(db);
+    if(statement == SELECT_ALL_TRANSACTIONS) qry->setForwardOnly(true);
+    if(!qry->prepare(statement_sql(statement))){
+        logger->log(Logger::CRITICAL, "Preparing " + QString(statement_name(statement)), qry->lastError().text());
+    }
+    statement_cache.insert(statement, qry);
+    return *qry;
+}
+
+bool DatabaseManager::exec(Statement statement){
+    QSqlQuery & qry = prepared(statement);
+    QElapsedTimer timer;
+    timer.start();
+    bool result = qry.exec();
+    qint64 elapsed = timer.nsecsElapsed();
+    Metrics::instance().statement_executed(db, qry, "sql." + QString(statement_name(statement)), elapsed);
+    StatementStats & stat = stats[statement];
+    stat.executions++;
+    stat.total_ns += elapsed;
+    if(elapsed > stat.max_ns) stat.max_ns = elapsed;
+    if(!result) logger->log(Logger::CRITICAL, QString(statement_name(statement)) + " qry", qry.lastError().text());
+    return result;
+}
+
+void DatabaseManager::release(Statement statement){
+    QHash<int, QSqlQuery*>::iterator it = statement_cache.find(statement);
+    if(it != statement_cache.end()) it.value()->finish();
+}
+
+QString DatabaseManager::stats_report() const{
+    QString report = "Statement cache stats:";
+    for(QHash<int, StatementStats>::const_iterator it = stats.constBegin(); it != stats.constEnd(); ++it){
+        const StatementStats & stat = it.value();
+        double avg_us = stat.executions > 0 ? (stat.total_ns / 1000.0) / stat.executions : 0;
+        report += QString("\n  %1: hits %2, misses %3, executions %4, avg %5 us, max %6 us")
+                .arg(statement_name(Statement(it.key())))
+                .arg(stat.hits)
+                .arg(stat.misses)
+                .arg(stat.executions)
+                .arg(avg_us, 0, 'f', 1)
+                .arg(stat.max_ns / 1000.0, 0, 'f', 1);
+    }
+    return report;
+}
@@ -0,0 +1,155 @@
+#ifndef DATABASEMANAGER_H
+#define DATABASEMANAGER_H
+
+#include <QObject>
+#include <QDate>
+#include <QHash>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include "Logger.h"
+#include "Money.h"
+
+struct sqlite3;
+
+/*
+ * Owns the single long-lived connection to the transaction database.
+ * The connection is opened once and kept open for the life of the owner, and the
+ * hot statements are prepared once and reused instead of being re-prepared per action.
+*/
+class DatabaseManager : public QObject
+{
+    Q_OBJECT
+public:
+    //statements that are prepared once and cached for the life of the connection
+    enum Statement{
+        LAST_BALANCE,
+        INSERT_TRANSACTION,
+        COUNT_TRANSACTIONS,
+        SELECT_ALL_TRANSACTIONS,
+        //the balance a transaction added on :date starts from (the last one on or before it)
+        BALANCE_ON_DATE,
+        //lowest balance of the transactions dated after :date
+        MIN_BALANCE_AFTER_DATE,
+        //adds :change to the balance of every transaction dated after :date
+        SHIFT_BALANCES_AFTER_DATE,
+        //date_added of the account's transaction :id, its place in ledger order with the id
+        TRANSACTION_DATE
+    };
+
+    //connection settings applied by open()
+    enum Profile{
+        //WAL, full sync on every commit: nothing committed is lost on a crash or power failure
+        SAFE,
+        //WAL, no syncs, large cache and mmap: for bulk loads that can be re-run if the machine goes down
+        FAST_INGEST
+    };
+
+    //stored in PRAGMA user_version. 0 = amounts as DOUBLE dollars, 1 = amounts as INTEGER cents,
+    //2 = rows belong to an account (account_id), every account has its own balance chain,
+    //3 = the chain runs in ledger order (date_added, id) instead of id order
+    static const int SCHEMA_VERSION = 3;
+
+    //the account existing rows are moved to by the migration, always present
+    static const qint64 DEFAULT_ACCOUNT = 1;
+
+    explicit DatabaseManager(Logger * logger, QString db_path, QString connection_name = QLatin1String(QSqlDatabase::defaultConnection), QObject *parent = 0);
+    ~DatabaseManager();
+
+    //the default location of the database file
+    static QString default_path();
+
+    //the profile applied by the next open(), SAFE unless set
+    void set_profile(Profile);
+    Profile profile() const;
+    static QString profile_name(Profile);
+
+    //opens the connection and applies the profile, returns false on failure. Calling this while open is a no-op.
+    bool open();
+
+    //drops all cached statements and closes the connection
+    void close();
+
+    bool is_open() const;
+
+    //the underlying connection, used by models that need a QSqlDatabase
+    QSqlDatabase database() const;
+
+    //the connection's sqlite3 handle for the sqlite C API (online backup), NULL if it isn't open or if the
+    //QSQLITE driver doesn't run on the sqlite library this program links (e.g. Qt's bundled sqlite)
+    sqlite3 * handle() const;
+
+    //creates the necessary table(s) if they do not exist yet, migrating older databases first
+    bool ensure_schema();
+
+    //the PRAGMA user_version of the open database
+    int schema_version() const;
+
+    //the account's total as of its last write, from the account_balances row (no ledger read).
+    //false if there is no row yet, e.g. the database predates it and ensure_schema() hasn't run
+    bool last_known_balance(qint64 account, Money & balance) const;
+
+    //true if the FTS5 index over the descriptions exists (the sqlite build may not have FTS5)
+    bool has_search_index() const;
+
+    //refills the search index from the transactions table, needed after the table is replaced wholesale (import)
+    bool rebuild_search_index();
+
+    //sql condition selecting the rows after the one at (date, id) in ledger order, inclusive also selects that row.
+    //transactions without a date come first, ordered by id. bind the position with bind_position() and the
+    //same name (e.g. ":after" binds :after_date and :after_id)
+    static QString rows_after(QString name, QDate date, bool inclusive = false);
+
+    //the rows before the one at (date, id) in ledger order, see rows_after()
+    static QString rows_before(QString name, QDate date, bool inclusive = false);
+
+    static void bind_position(QSqlQuery & qry, QString name, QDate date, qint64 id);
+
+    //rewrites every stored balance of the account (0 = every account) that doesn't match the chain recomputed in
+    //ledger order, for rows chained in id order before SCHEMA_VERSION 3. returns the # rewritten, -1 on error
+    static qint64 rebalance_ledgers(QSqlDatabase db, Logger * logger, qint64 account = 0);
+
+    //returns the cached prepared query for the statement, preparing it on first use.
+    //every statement is scoped to one account, bind :account before exec()
+    QSqlQuery & prepared(Statement);
+
+    //executes the cached statement (bind values first via prepared()) and records its timing
+    bool exec(Statement);
+
+    //releases the result set of a cached statement so it doesn't hold a read lock
+    void release(Statement);
+
+    //summary of cache hits/misses and per-statement timings
+    QString stats_report() const;
+
+private:
+    struct StatementStats{
+        StatementStats() : hits(0), misses(0), executions(0), total_ns(0), max_ns(0) {}
+        qint64 hits;
+        qint64 misses;
+        qint64 executions;
+        qint64 total_ns;
+        qint64 max_ns;
+    };
+
+    //upgrades the database to SCHEMA_VERSION in one transaction
+    bool migrate();
+
+    //creates the FTS5 index and the triggers that keep it in step, filling it if it is new
+    bool ensure_search_index();
+
+    //runs the profile's pragmas on the open connection and logs the resulting settings
+    bool apply_profile();
+
+    static const char * statement_sql(Statement);
+    static const char * statement_name(Statement);
+
+    Logger * logger;
+    QString db_path;
+    QString connection_name;
+    Profile active_profile;
+    QSqlDatabase db;
+    QHash<int, QSqlQuery*> statement_cache;
+    QHash<int, StatementStats> stats;
+};
+
+#endif // DATABASEMANAGER_H
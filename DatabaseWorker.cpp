@@ -0,0 +1,615 @@
+#include "DatabaseWorker.h"
+#include "DatabaseManager.h"
+#include "SqlImporter.h"
+#include "LedgerSnapshot.h"
+#include "BalanceVerifier.h"
+#include "Metrics.h"
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QPair>
+#include <QtConcurrent>
+
+//name of the worker's connection, the GUI thread keeps the default connection for its models.
+#define WORKER_CONNECTION_NAME "db_worker"
+//PRAGMA auto_vacuum value for incremental.
+#define AUTO_VACUUM_INCREMENTAL 2
+
+DatabaseWorker::DatabaseWorker(Logger * logger, QString db_path, QObject *parent) :
+    QObject(parent),
+    logger(logger),
+    db_path(db_path),
+    db(NULL)
+{
+}
+
+/*
+ * Runs on the worker thread when the thread finishes, the connection is removed on the thread that made it.
+*/
+DatabaseWorker::~DatabaseWorker(){
+    qDeleteAll(ledgers);
+    delete db;
+}
+
+bool DatabaseWorker::is_ready() const{
+    return db != NULL && db->is_open();
+}
+
+Accounts DatabaseWorker::list_accounts(){
+    Accounts accounts;
+    QSqlQuery qry(db->database());
+    qry.setForwardOnly(true);
+    if(!qry.exec("SELECT id, name FROM accounts ORDER BY id;")){
+        logger->log(Logger::CRITICAL, "Error loading accounts", qry.lastError().text());
+        return accounts;
+    }
+    while(qry.next()){
+        Account account;
+        account.id = qry.value(0).toLongLong();
+        account.name = qry.value(1).toString();
+        accounts.append(account);
+    }
+    return accounts;
+}
+
+DatabaseWorker::AccountLedger & DatabaseWorker::ledger_of(qint64 account){
+    QHash<qint64, AccountLedger*>::iterator it = ledgers.find(account);
+    if(it == ledgers.end()) it = ledgers.insert(account, new AccountLedger);
+    return *it.value();
+}
+
+bool DatabaseWorker::ensure_cache(qint64 account){
+    return ledger_of(account).cache.is_loaded() || reload_cache(account);
+}
+
+bool DatabaseWorker::reload_cache(qint64 account){
+    ScopedTimer scope("ledger.cache_load");
+    AccountLedger & ledger = ledger_of(account);
+    ledger.engine.invalidate();
+    ledger.reports.invalidate();
+    return ledger.cache.load(db->database(), account, logger);
+}
+
+/*
+ * Ids alone don't give the row once transactions are back-dated, the row's date is read by primary key so the
+ * cache can search (date, id).
+*/
+int DatabaseWorker::cached_row(qint64 account, qint64 id){
+    db->prepared(DatabaseManager::TRANSACTION_DATE).bindValue(":id", id);
+    db->prepared(DatabaseManager::TRANSACTION_DATE).bindValue(":account", account);
+    if(!db->exec(DatabaseManager::TRANSACTION_DATE)) return -1;
+    QSqlQuery & date_qry = db->prepared(DatabaseManager::TRANSACTION_DATE);
+    bool found = date_qry.next();
+    QDate date = found ? date_qry.value(0).toDate() : QDate();
+    db->release(DatabaseManager::TRANSACTION_DATE);
+    if(!found) return -1;
+    LedgerCache & cache = ledger_of(account).cache;
+    int row = ensure_cache(account) ? cache.row_of(id, date) : -1;
+    if(row < 0 && reload_cache(account)) row = cache.row_of(id, date);
+    return row;
+}
+
+/*
+ * Comes from the cache, the query is only a fallback for when it can't be loaded.
+*/
+Money DatabaseWorker::last_balance(qint64 account){
+    if(ensure_cache(account)) return ledger_of(account).cache.total();
+    Money result;
+    db->prepared(DatabaseManager::LAST_BALANCE).bindValue(":account", account);
+    if(!db->exec(DatabaseManager::LAST_BALANCE)) return result;
+    QSqlQuery & qry = db->prepared(DatabaseManager::LAST_BALANCE);
+    if(qry.next()) result = Money::from_cents(qry.value(0).toLongLong());
+    db->release(DatabaseManager::LAST_BALANCE);
+    return result;
+}
+
+//builds one account's engine from its loaded cache, runs on a pool thread and touches that account only
+struct BuildEngine{
+    typedef void result_type;
+
+    void operator()(const QPair<LedgerCache*, LedgerEngine*> & ledger) const{
+        if(ledger.first->is_loaded()) ledger.second->load(ledger.first->row_ids(), ledger.first->row_deltas());
+    }
+};
+
+/*
+ * Only what the window needs to become usable is done before answering: the schema check and the given
+ * account's ledger. The other accounts are loaded by warm_up(), queued right after the answer.
+*/
+void DatabaseWorker::open(qint64 account){
+    ScopedTimer scope("worker.open");
+    QElapsedTimer timer;
+    timer.start();
+    if(db == NULL) db = new DatabaseManager(logger, db_path, WORKER_CONNECTION_NAME);
+    if(!db->open() || !db->ensure_schema()){
+        emit opened(false, Accounts(), account, Money());
+        return;
+    }
+    qint64 schema_ms = timer.elapsed();
+    Accounts accounts = list_accounts();
+    bool found = false;
+    for(int i = 0; i < accounts.size(); i++){
+        if(accounts[i].id == account) found = true;
+    }
+    if(!found && !accounts.isEmpty()) account = accounts[0].id;
+    Money balance = last_balance(account);
+    logger->log(Logger::INFO, QString("Worker ready in %1 ms (schema check %2 ms, account %3 loaded in %4 ms)")
+                .arg(timer.elapsed())
+                .arg(schema_ms)
+                .arg(account)
+                .arg(timer.elapsed() - schema_ms));
+    emit opened(!accounts.isEmpty(), accounts, account, balance);
+    QMetaObject::invokeMethod(this, "warm_up", Qt::QueuedConnection);
+}
+
+/*
+ * The caches are read one account at a time over the connection, the accounts' engines are then built
+ * in parallel since no two accounts share rows.
+*/
+void DatabaseWorker::warm_up(){
+    ScopedTimer scope("worker.warm_up");
+    if(!is_ready()) return;
+    QElapsedTimer timer;
+    timer.start();
+    Accounts accounts = list_accounts();
+    QList<QPair<LedgerCache*, LedgerEngine*> > to_build;
+    for(int i = 0; i < accounts.size(); i++){
+        if(!ensure_cache(accounts[i].id)) continue;
+        AccountLedger & ledger = ledger_of(accounts[i].id);
+        if(!ledger.engine.is_loaded()) to_build.append(qMakePair(&ledger.cache, &ledger.engine));
+    }
+    QtConcurrent::blockingMap(to_build, BuildEngine());
+    logger->log(Logger::INFO, "Warmed up " + QString::number(accounts.size()) + " account ledger(s) in " + QString::number(timer.elapsed()) + " ms");
+}
+
+void DatabaseWorker::select_account(qint64 account){
+    emit account_selected(account, is_ready() ? last_balance(account) : Money());
+}
+
+void DatabaseWorker::add_account(QString name){
+    ScopedTimer scope("worker.add_account");
+    if(!is_ready()){
+        emit account_added(false, "The database isn't open, please restart the program", Accounts(), -1);
+        return;
+    }
+    name = name.trimmed();
+    if(name.isEmpty()){
+        emit account_added(false, "Please enter a name for the account", list_accounts(), -1);
+        return;
+    }
+    QSqlQuery qry(db->database());
+    qry.prepare("INSERT INTO accounts (name) VALUES (:name);");
+    qry.bindValue(":name", name);
+    if(!qry.exec()){
+        logger->log(Logger::WARNING, "Error adding account " + name, qry.lastError().text());
+        emit account_added(false, "Error adding the account, an account named " + name + " may already exist", list_accounts(), -1);
+        return;
+    }
+    qint64 account = qry.lastInsertId().toLongLong();
+    ledger_of(account).cache.clear();
+    logger->log(Logger::DEBUG, "Added account " + QString::number(account) + " " + name);
+    emit account_added(true, QString(), list_accounts(), account);
+}
+
+/*
+ * Each transaction goes at its place in ledger order: after every transaction dated on or before its date (it
+ * has the highest id, so it is the last of its day). Inside one sql transaction, for each of them in turn:
+ * its balance starts from the balance of the row before it, a withdrawal is also checked against the lowest
+ * balance of the rows dated after it (one MIN over that suffix through the ledger index), then it is inserted
+ * and the suffix's balances are shifted by its amount with one set-based UPDATE. A transaction dated on or after
+ * the last one has an empty suffix, appending only costs a few index lookups more than before.
+ * If one is rejected the whole group is rolled back, nothing is saved.
+*/
+void DatabaseWorker::submit(qint64 account, PendingTransactions transactions){
+    ScopedTimer scope("worker.submit");
+    if(!is_ready()){
+        logger->log(Logger::CRITICAL, "Database not open to save new transactions (submit btn). Transactions not saved");
+        emit submitted(SAVE_FAILED, 0, Money());
+        return;
+    }
+    QSqlDatabase connection = db->database();
+    if(!connection.transaction()){
+        logger->log(Logger::CRITICAL, "Error starting submit transaction", connection.lastError().text());
+        emit submitted(SAVE_FAILED, 0, last_balance(account));
+        return;
+    }
+    QSqlQuery & min_balance_qry = db->prepared(DatabaseManager::MIN_BALANCE_AFTER_DATE);
+    QSqlQuery & add_transaction_qry = db->prepared(DatabaseManager::INSERT_TRANSACTION);
+    QSqlQuery & shift_qry = db->prepared(DatabaseManager::SHIFT_BALANCES_AFTER_DATE);
+    min_balance_qry.bindValue(":account", account);
+    add_transaction_qry.bindValue(":account", account);
+    shift_qry.bindValue(":account", account);
+    QVector<qint64> new_ids;
+    int shifted = 0;
+    int rejected = SAVED;
+    int rejected_row = 0;
+    bool result = true;
+    for(int i = 0; result && rejected == SAVED && i < transactions.size(); i++){
+        const PendingTransaction & transaction = transactions[i];
+        Money balance;
+        result = balance_before(account, transaction.date, balance);
+        if(!result) break;
+        Money before = balance;
+        //an undated transaction would have no place in the ledger
+        switch(!transaction.date.isValid() ? LedgerEngine::INVALID_INPUT : LedgerEngine::apply_transaction(transaction.description, transaction.mode, transaction.amount, balance)){
+        case LedgerEngine::INVALID_INPUT:
+            logger->log(Logger::DEBUG, "Invalid Input\nAmount: " + transaction.amount.to_string() + " Description: " + transaction.description + " Mode: " + transaction.mode);
+            rejected = INVALID_INPUT;
+            break;
+        case LedgerEngine::INSUFFICIENT_FUNDS:
+            logger->log(Logger::DEBUG, "Can't withdraw " + transaction.amount.to_string() + " from " + before.to_string() + " on " + transaction.date.toString(Qt::ISODate));
+            rejected = INSUFFICIENT_FUNDS;
+            break;
+        case LedgerEngine::VALID:
+            break;
+        }
+        if(rejected != SAVED){
+            rejected_row = i;
+            break;
+        }
+        Money delta = balance - before;
+        if(delta.is_negative()){
+            min_balance_qry.bindValue(":date", transaction.date);
+            result = db->exec(DatabaseManager::MIN_BALANCE_AFTER_DATE);
+            if(!result) break;
+            bool below_zero = min_balance_qry.next() && !min_balance_qry.value(0).isNull()
+                    && (Money::from_cents(min_balance_qry.value(0).toLongLong()) + delta).is_negative();
+            db->release(DatabaseManager::MIN_BALANCE_AFTER_DATE);
+            if(below_zero){
+                logger->log(Logger::DEBUG, "Can't withdraw " + transaction.amount.to_string() + " on " + transaction.date.toString(Qt::ISODate) + ", a later balance would go negative");
+                rejected = INSUFFICIENT_FUNDS;
+                rejected_row = i;
+                break;
+            }
+        }
+        add_transaction_qry.bindValue(":desc", transaction.description);
+        add_transaction_qry.bindValue(":mode", transaction.mode);
+        add_transaction_qry.bindValue(":trans_amount", transaction.amount.to_cents());
+        add_transaction_qry.bindValue(":balance", balance.to_cents());
+        add_transaction_qry.bindValue(":date", transaction.date);
+        result = db->exec(DatabaseManager::INSERT_TRANSACTION);
+        if(!result) break;
+        new_ids.append(add_transaction_qry.lastInsertId().toLongLong());
+        shift_qry.bindValue(":change", delta.to_cents());
+        shift_qry.bindValue(":date", transaction.date);
+        result = db->exec(DatabaseManager::SHIFT_BALANCES_AFTER_DATE);
+        if(result) shifted += shift_qry.numRowsAffected();
+    }
+    if(result && rejected == SAVED) result = connection.commit();
+    if(!result || rejected != SAVED){
+        if(!result) logger->log(Logger::CRITICAL, "Error saving transactions, rolling back", connection.lastError().text());
+        connection.rollback();
+        emit submitted(result ? rejected : int(SAVE_FAILED), rejected_row, last_balance(account));
+        return;
+    }
+
+    AccountLedger & ledger = ledger_of(account);
+    if(ledger.cache.is_loaded()){
+        int first_row = ledger.cache.size();
+        for(int i = 0; i < transactions.size(); i++){
+            first_row = qMin(first_row, ledger.cache.insert(new_ids[i], transactions[i].mode, transactions[i].amount, transactions[i].date));
+        }
+        //rows inserted before the end move the rows after them, only the chunks from the first one on change
+        ledger.reports.rows_changed(first_row, ledger.cache.size() - 1);
+    }
+    ledger.engine.invalidate();
+    Metrics::instance().add_count("transactions.submitted", transactions.size());
+    Metrics::instance().add_count("ledger.balances_shifted", shifted);
+    logger->log(Logger::DEBUG, QString::number(transactions.size()) + " transactions saved, " + QString::number(shifted) + " later balances shifted");
+    emit submitted(SAVED, transactions.size(), last_balance(account));
+}
+
+/*
+ * Goes through the ledger index to the last transaction on or before the date. Undated transactions sort
+ * first, they are only looked at when nothing dated comes before it.
+*/
+bool DatabaseWorker::balance_before(qint64 account, QDate date, Money & balance){
+    db->prepared(DatabaseManager::BALANCE_ON_DATE).bindValue(":account", account);
+    db->prepared(DatabaseManager::BALANCE_ON_DATE).bindValue(":date", date);
+    if(!db->exec(DatabaseManager::BALANCE_ON_DATE)) return false;
+    QSqlQuery & balance_qry = db->prepared(DatabaseManager::BALANCE_ON_DATE);
+    bool found = balance_qry.next();
+    if(found) balance = Money::from_cents(balance_qry.value(0).toLongLong());
+    db->release(DatabaseManager::BALANCE_ON_DATE);
+    if(found) return true;
+    QSqlQuery undated_qry(db->database());
+    undated_qry.prepare("SELECT balance FROM transactions WHERE account_id = :account AND date_added IS NULL ORDER BY id DESC LIMIT 1;");
+    undated_qry.bindValue(":account", account);
+    if(!undated_qry.exec()){
+        logger->log(Logger::CRITICAL, "Error reading the balance before " + date.toString(Qt::ISODate), undated_qry.lastError().text());
+        return false;
+    }
+    balance = undated_qry.next() ? Money::from_cents(undated_qry.value(0).toLongLong()) : Money();
+    return true;
+}
+
+/*
+ * Snapshots are bulk loaded, .sql files written by export take the fast path and anything else is replayed in
+ * a scratch database first.
+ * Only the account's rows are replaced, the other accounts' chains are left as they are.
+*/
+void DatabaseWorker::import_file(qint64 account, QString file_name){
+    ScopedTimer scope("worker.import");
+    if(!is_ready()){
+        emit imported(false, "The database isn't open, please restart the program", Money());
+        return;
+    }
+    logger->log(Logger::DEBUG, "Overwriting account " + QString::number(account) + " via import");
+    AccountLedger & ledger = ledger_of(account);
+    ledger.engine.invalidate();
+    ledger.cache.invalidate();
+    SqlImporter importer(logger, db->database(), account);
+    SqlImporter::Result result;
+    if(QFileInfo(file_name).suffix() == LedgerSnapshot::suffix()){
+        result = importer.import_snapshot(file_name);
+    }else{
+        result = importer.import_file(file_name);
+        if(result == SqlImporter::UNRECOGNIZED) result = importer.replay_file(file_name);
+    }
+    if(result == SqlImporter::FAILED){
+        emit imported(false, importer.error() + "\nThe existing transactions were left unchanged.", last_balance(account));
+        return;
+    }
+    db->ensure_schema();
+    reload_cache(account);
+    Metrics::instance().add_count("transactions.imported", importer.rows_imported());
+    logger->log(Logger::DEBUG, "All data successfully imported");
+    QString message = QString::number(importer.rows_imported()) + " transactions successfully imported";
+    if(importer.rows_rebalanced() > 0){
+        message += QString("\n%1 balances were recomputed in date order (the file was exported by an older version)").arg(importer.rows_rebalanced());
+    }
+    //imported balances of current files are taken as they are, the chain is checked once here instead of row by row
+    if(ledger.cache.is_loaded()){
+        BalanceVerifier verifier;
+        if(verifier.verify(ledger.cache) > 0 || verifier.negative() > 0){
+            logger->log(Logger::WARNING, "Imported ledger is inconsistent: " + verifier.summary(), verifier.details());
+            message += QString("\n%1 balances are inconsistent and %2 are negative, use Database > Verify Balances to repair them")
+                    .arg(verifier.inconsistent())
+                    .arg(verifier.negative());
+        }else{
+            logger->log(Logger::DEBUG, verifier.summary());
+        }
+    }
+    emit imported(true, message, last_balance(account));
+}
+
+/*
+ * When no other account has rows the table is emptied with an unqualified DELETE, which sqlite truncates in one
+ * step instead of row by row. That only happens without delete triggers, so they are dropped for it and their
+ * work is done set-based: the search index is cleared and the account's balance row reset.
+ * Otherwise the account's rows are deleted with the triggers in place, each of them only does constant work per row.
+ * ensure_schema() puts the triggers back either way, the freed pages are reclaimed by the idle maintenance.
+ * A truncate also leaves the file nearly empty, so a database created before auto_vacuum was turned on is
+ * converted to incremental vacuum then: the VACUUM only has to rewrite what is left.
+*/
+void DatabaseWorker::delete_all(qint64 account){
+    ScopedTimer scope("worker.delete_all");
+    if(!is_ready()){
+        emit deleted(false);
+        return;
+    }
+    QElapsedTimer timer;
+    timer.start();
+    AccountLedger & ledger = ledger_of(account);
+    ledger.engine.invalidate();
+    QSqlDatabase connection = db->database();
+    if(!connection.transaction()){
+        logger->log(Logger::CRITICAL, "Error starting delete transaction", connection.lastError().text());
+        emit deleted(false);
+        return;
+    }
+    QSqlQuery others_qry(connection);
+    others_qry.prepare("SELECT 1 FROM transactions WHERE account_id <> :account LIMIT 1;");
+    others_qry.bindValue(":account", account);
+    bool success = others_qry.exec();
+    bool truncate = success && !others_qry.next();
+    others_qry.finish();
+
+    QSqlQuery remove_all_records_qry(connection);
+    if(truncate){
+        success = success && !connection.exec("DROP TRIGGER IF EXISTS transactions_fts_delete;").lastError().isValid();
+        success = success && !connection.exec("DROP TRIGGER IF EXISTS account_balances_delete;").lastError().isValid();
+        success = success && remove_all_records_qry.exec("DELETE FROM transactions;");
+        if(success && db->has_search_index()){
+            success = !connection.exec("INSERT INTO transactions_fts (transactions_fts) VALUES ('delete-all');").lastError().isValid();
+        }
+        QSqlQuery reset_balance_qry(connection);
+        reset_balance_qry.prepare("UPDATE account_balances SET last_id = 0, balance = 0 WHERE account_id = :account;");
+        reset_balance_qry.bindValue(":account", account);
+        success = success && reset_balance_qry.exec();
+    }else{
+        remove_all_records_qry.prepare("DELETE FROM transactions WHERE account_id = :account;");
+        remove_all_records_qry.bindValue(":account", account);
+        success = success && remove_all_records_qry.exec();
+    }
+    logger->log(Logger::DEBUG, "delete account transactions qry" + remove_all_records_qry.lastError().text());
+    if(success) success = connection.commit();
+    if(success){
+        ledger.cache.clear();
+        ledger.reports.invalidate();
+    }else{
+        logger->log(Logger::CRITICAL, "Error deleting account transactions, rolling back", connection.lastError().isValid() ? connection.lastError().text() : remove_all_records_qry.lastError().text());
+        connection.rollback();
+    }
+    db->ensure_schema();
+    if(success && truncate){
+        QSqlQuery auto_vacuum_qry = connection.exec("PRAGMA auto_vacuum;");
+        bool incremental = auto_vacuum_qry.next() && auto_vacuum_qry.value(0).toInt() == AUTO_VACUUM_INCREMENTAL;
+        auto_vacuum_qry.finish();
+        if(!incremental){
+            connection.exec("PRAGMA auto_vacuum = INCREMENTAL;");
+            QSqlQuery vacuum_qry = connection.exec("VACUUM;");
+            if(vacuum_qry.lastError().isValid()){
+                logger->log(Logger::WARNING, "Error converting the emptied database to incremental vacuum", vacuum_qry.lastError().text());
+            }else{
+                logger->log(Logger::INFO, "Converted the emptied database to incremental vacuum");
+            }
+        }
+    }
+    logger->log(Logger::DEBUG, success ? "Account " + QString::number(account) + " sucessfully deleted" : QString("Error deleting account transactions"));
+    if(success) logger->log(Logger::INFO, QString("Deleted account %1's transactions (%2) in %3 ms")
+                            .arg(account)
+                            .arg(truncate ? "truncated" : "row by row")
+                            .arg(timer.elapsed()));
+    emit deleted(success);
+}
+
+void DatabaseWorker::set_mode(qint64 account, qint64 id, QString mode){
+    LedgerCache & cache = ledger_of(account).cache;
+    int row = is_ready() ? cached_row(account, id) : -1;
+    edit_transaction(account, id, mode, row >= 0 ? cache.amount_at(row) : Money());
+}
+
+void DatabaseWorker::set_amount(qint64 account, qint64 id, Money amount){
+    LedgerCache & cache = ledger_of(account).cache;
+    int row = is_ready() ? cached_row(account, id) : -1;
+    edit_transaction(account, id, row >= 0 ? cache.mode_at(row) : QString(), amount);
+}
+
+/*
+ * A new date moves the transaction to another place in the ledger and only the rows it moves past change
+ * balance, all by its amount (moving it later takes its amount out of them, earlier adds it). The move is made
+ * in the cache first so their new balances can be checked, then written with two statements in one sql
+ * transaction: the row (date and balance) and one set-based UPDATE over the ledger range between its old and
+ * new place.
+*/
+void DatabaseWorker::set_date(qint64 account, qint64 id, QDate date){
+    ScopedTimer scope("worker.set_date");
+    if(!is_ready()){
+        emit transaction_edited(false, "The database isn't open, please restart the program", id, Money(), Money());
+        return;
+    }
+    AccountLedger & ledger = ledger_of(account);
+    int row = cached_row(account, id);
+    if(row < 0 || !date.isValid()){
+        logger->log(Logger::WARNING, "Can't move transaction " + QString::number(id) + " of account " + QString::number(account) + " to " + date.toString(Qt::ISODate));
+        emit transaction_edited(false, "Error loading transactions, please try again", id, Money(), last_balance(account));
+        return;
+    }
+    QDate old_date = ledger.cache.date_at(row);
+    qint64 delta = LedgerEngine::signed_amount(ledger.cache.mode_at(row), ledger.cache.amount_at(row)).to_cents();
+    int new_row = ledger.cache.set_date(row, date);
+    int first = qMin(row, new_row);
+    int last = qMax(row, new_row);
+    if(first < last && ledger.cache.min_balance(first, last).is_negative()){
+        ledger.cache.set_date(new_row, old_date);
+        logger->log(Logger::DEBUG, "moving the transaction makes a balance negative, reverting");
+        emit transaction_edited(false, "Resulting calculation is negative, reverting all changes...", id, Money(), ledger.cache.total());
+        return;
+    }
+
+    QSqlDatabase connection = db->database();
+    bool later = new_row > row;
+    bool result = connection.transaction();
+    QSqlQuery move_row_qry(connection);
+    QSqlQuery shift_qry(connection);
+    if(result){
+        move_row_qry.prepare("UPDATE transactions SET date_added = :date, balance = :balance WHERE id = :id;");
+        move_row_qry.bindValue(":date", date);
+        move_row_qry.bindValue(":balance", ledger.cache.balance_at(new_row).to_cents());
+        move_row_qry.bindValue(":id", id);
+        result = Metrics::exec(connection, move_row_qry, "sql.move row");
+    }
+    if(result && first < last){
+        //strictly between the old and the new place, the row itself is at its new place already
+        QDate from = later ? old_date : date;
+        QDate to = later ? date : old_date;
+        shift_qry.prepare("UPDATE transactions SET balance = balance + :change WHERE account_id = :account AND "
+                          + DatabaseManager::rows_after(":from", from) + " AND " + DatabaseManager::rows_before(":to", to) + ";");
+        shift_qry.bindValue(":change", later ? -delta : delta);
+        shift_qry.bindValue(":account", account);
+        DatabaseManager::bind_position(shift_qry, ":from", from, id);
+        DatabaseManager::bind_position(shift_qry, ":to", to, id);
+        result = Metrics::exec(connection, shift_qry, "sql.shift moved past");
+    }
+    if(result) result = connection.commit();
+    if(!result){
+        logger->log(Logger::CRITICAL, "Error moving the transaction, rolling back", shift_qry.lastError().isValid() ? shift_qry.lastError().text() : move_row_qry.lastError().text());
+        connection.rollback();
+        ledger.cache.set_date(new_row, old_date);
+        emit transaction_edited(false, "Error updating the date, please try again", id, Money(), ledger.cache.total());
+        return;
+    }
+    ledger.engine.invalidate();
+    //rows outside [first, last] keep their place and their balance relative to the chunk
+    ledger.reports.rows_changed(first, last);
+    Metrics::instance().add_count("ledger.balances_shifted", last - first);
+    logger->log(Logger::DEBUG, QString("Moved transaction %1 from row %2 to %3").arg(id).arg(row).arg(new_row));
+    emit transaction_edited(true, QString(), id, Money(), ledger.cache.total());
+}
+
+/*
+ * The ledger engine is built from the cache's arrays if it is stale, and the cache is reloaded if it doesn't
+ * know the transaction yet. Both are updated together so their rows keep lining up.
+*/
+void DatabaseWorker::edit_transaction(qint64 account, qint64 id, QString mode, Money amount){
+    ScopedTimer scope("worker.edit");
+    if(!is_ready()){
+        emit transaction_edited(false, "The database isn't open, please restart the program", id, Money(), Money());
+        return;
+    }
+    AccountLedger & ledger = ledger_of(account);
+    int row = cached_row(account, id);
+    if(row < 0){
+        logger->log(Logger::WARNING, "Transaction " + QString::number(id) + " not found in account " + QString::number(account) + "'s ledger cache");
+        emit transaction_edited(false, "Error loading transactions, please try again", id, Money(), last_balance(account));
+        return;
+    }
+    if(!ledger.engine.is_loaded()) ledger.engine.load(ledger.cache.row_ids(), ledger.cache.row_deltas());
+    if(!ledger.engine.can_set_delta(row, LedgerEngine::signed_amount(mode, amount))){
+        logger->log(Logger::DEBUG, "resulting calculation negative, reverting all");
+        emit transaction_edited(false, "Resulting calculation is negative, reverting all changes...", id, Money(), ledger.cache.total());
+        return;
+    }
+    Money change = Money::from_cents(LedgerEngine::signed_amount(mode, amount).to_cents() - ledger.engine.delta_at(row).to_cents());
+    bool result = ledger.engine.apply_edit(db->database(), account, row, ledger.cache.date_at(row), mode, amount, logger);
+    if(result){
+        ledger.cache.set_transaction(row, mode, amount);
+        ledger.reports.row_changed(row);
+    }
+    logger->log(Logger::DEBUG, "ledger edit status: " + (result ? QString("True") : QString("False")));
+    emit transaction_edited(result, result ? QString() : "Error updating the transaction, please try again", id, result ? change : Money(), ledger.cache.total());
+}
+
+void DatabaseWorker::build_reports(qint64 account){
+    ScopedTimer scope("worker.build_reports");
+    if(!is_ready() || !ensure_cache(account)){
+        emit reports_built(false, ReportPeriods(), ReportPeriods());
+        return;
+    }
+    AccountLedger & ledger = ledger_of(account);
+    QElapsedTimer timer;
+    timer.start();
+    int recomputed = ledger.reports.update(ledger.cache);
+    logger->log(Logger::INFO, "Reports updated, " + QString::number(recomputed) + " of " + QString::number(ledger.reports.chunk_count())
+                + " chunks recomputed in " + QString::number(timer.elapsed()) + " ms");
+    emit reports_built(true, ledger.reports.monthly(), ledger.reports.yearly());
+}
+
+/*
+ * The cache is reloaded first so the stored balances are checked, not the ones the worker kept in step.
+*/
+void DatabaseWorker::verify(qint64 account, bool repair){
+    ScopedTimer scope("worker.verify");
+    if(!is_ready() || !reload_cache(account)){
+        emit verified(false, "Error loading transactions, please try again", QString(), 0, false, Money());
+        return;
+    }
+    AccountLedger & ledger = ledger_of(account);
+    BalanceVerifier verifier;
+    verifier.verify(ledger.cache);
+    QString summary = verifier.summary();
+    QString details = verifier.details();
+    logger->log(Logger::INFO, summary);
+    bool repaired = false;
+    if(repair && verifier.inconsistent() > 0){
+        if(!verifier.repair(db->database(), account, logger)){
+            emit verified(false, "Error repairing the balances, nothing was changed", details, verifier.inconsistent(), false, last_balance(account));
+            return;
+        }
+        repaired = true;
+        reload_cache(account);
+    }
+    emit verified(true, summary, details, verifier.inconsistent(), repaired, last_balance(account));
+}
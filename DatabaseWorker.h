@@ -0,0 +1,156 @@
+#ifndef DATABASEWORKER_H
+#define DATABASEWORKER_H
+
+#include <QObject>
+#include <QDate>
+#include <QHash>
+#include <QMetaType>
+#include <QVector>
+#include "Logger.h"
+#include "Money.h"
+#include "LedgerEngine.h"
+#include "LedgerCache.h"
+#include "LedgerReports.h"
+
+class DatabaseManager;
+
+//a transaction entered in the window, not saved yet
+struct PendingTransaction{
+    QString description;
+    QString mode;
+    Money amount;
+    QDate date;
+};
+typedef QVector<PendingTransaction> PendingTransactions;
+Q_DECLARE_METATYPE(PendingTransactions)
+
+struct Account{
+    qint64 id;
+    QString name;
+};
+typedef QVector<Account> Accounts;
+Q_DECLARE_METATYPE(Accounts)
+
+/*
+ * Does the window's database writes on a dedicated thread so the GUI never blocks on sqlite.
+ * Move it to its own QThread and talk to it only through queued signals/slots: every slot is one request
+ * and answers with exactly one signal. The worker opens its own connection on its thread (in open()),
+ * keeps it for its whole life and owns, for every account, the ledger cache (loaded once, updated on every
+ * write it makes), the ledger engine used to validate and apply edits and the reports aggregated from the
+ * cache, so balances, edits and reports don't query the database. New transactions may be back-dated, they are
+ * checked inside the sql transaction that saves them against the rows around their date.
+ * Ledger order is by date, then by id (see DatabaseManager::ensure_schema()).
+ * Accounts have independent balance chains: a request names its account and only reads and writes that
+ * account's rows and ledger.
+*/
+class DatabaseWorker : public QObject
+{
+    Q_OBJECT
+public:
+    //outcome of a submit request
+    enum SubmitResult{
+        SAVED,
+        INVALID_INPUT,
+        INSUFFICIENT_FUNDS,
+        SAVE_FAILED
+    };
+
+    explicit DatabaseWorker(Logger * logger, QString db_path, QObject *parent = 0);
+    ~DatabaseWorker();
+
+public slots:
+    //opens the connection, creates/migrates the schema and loads the account's ledger
+    //(the first account's if it doesn't exist). answers with opened(), then loads the other ledgers
+    void open(qint64 account);
+
+    //answers with account_selected()
+    void select_account(qint64 account);
+
+    //creates an empty account. answers with account_added()
+    void add_account(QString name);
+
+    //validates every transaction against the account's balance and saves them all in one sql transaction,
+    //or none of them if one fails. answers with submitted()
+    void submit(qint64 account, PendingTransactions transactions);
+
+    //replaces the account's transactions with the contents of an exported .sql file. answers with imported()
+    void import_file(qint64 account, QString file_name);
+
+    //deletes every transaction of the account. answers with deleted()
+    void delete_all(qint64 account);
+
+    //change a transaction's mode or amount and shift the balances after it. answer with transaction_edited()
+    void set_mode(qint64 account, qint64 id, QString mode);
+    void set_amount(qint64 account, qint64 id, Money amount);
+
+    //moves a transaction to another date, rebalancing the rows it moves past. answers with transaction_edited()
+    void set_date(qint64 account, qint64 id, QDate date);
+
+    //brings the account's monthly/yearly reports up to date, only the parts touched since the last time are
+    //recomputed. answers with reports_built()
+    void build_reports(qint64 account);
+
+    //checks the account's stored balances against its amounts, with repair every inconsistent balance is
+    //rewritten in one sql transaction. answers with verified()
+    void verify(qint64 account, bool repair);
+
+signals:
+    //account is the one loaded, balance its total
+    void opened(bool success, Accounts accounts, qint64 account, Money balance);
+    void account_selected(qint64 account, Money balance);
+    //account is the new account's id
+    void account_added(bool success, QString message, Accounts accounts, qint64 account);
+    //row is the index of the rejected transaction, or the # saved when result is SAVED
+    void submitted(int result, int row, Money balance);
+    void imported(bool success, QString message, Money balance);
+    void deleted(bool success);
+    //change is how much every balance after the edited transaction moved
+    void transaction_edited(bool success, QString message, qint64 id, Money change, Money total);
+    void reports_built(bool success, ReportPeriods monthly, ReportPeriods yearly);
+    //inconsistent is the # of rows left with a wrong balance, details lists them
+    void verified(bool success, QString summary, QString details, int inconsistent, bool repaired, Money balance);
+
+private slots:
+    //loads every account's ledger not loaded yet and builds the engines, queued by open()
+    void warm_up();
+
+private:
+    //everything kept in memory for one account, built from its rows only
+    struct AccountLedger{
+        LedgerCache cache;
+        LedgerEngine engine;
+        LedgerReports reports;
+    };
+
+    //true once open() succeeded
+    bool is_ready() const;
+
+    //every account, by id
+    Accounts list_accounts();
+
+    //the account's ledger, created empty (not loaded) on first use
+    AccountLedger & ledger_of(qint64 account);
+
+    //loads the account's cache if it is stale, false if it can't be loaded
+    bool ensure_cache(qint64 account);
+
+    //(re)loads the account's cache, everything built from it is marked stale
+    bool reload_cache(qint64 account);
+
+    //the transaction's row in the account's cache, reloading the cache once if it isn't there. -1 if not found
+    int cached_row(qint64 account, qint64 id);
+
+    Money last_balance(qint64 account);
+
+    //balance of the last transaction on or before the date, the one a transaction added on that date follows
+    bool balance_before(qint64 account, QDate date, Money & balance);
+
+    void edit_transaction(qint64 account, qint64 id, QString mode, Money amount);
+
+    Logger * logger;
+    QString db_path;
+    DatabaseManager * db;
+    QHash<qint64, AccountLedger*> ledgers;
+};
+
+#endif // DATABASEWORKER_H
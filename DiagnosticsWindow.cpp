@@ -0,0 +1,96 @@
+#include "DiagnosticsWindow.h"
+#include "Metrics.h"
+#include <QDateTime>
+#include <QFileDialog>
+#include <QFontDatabase>
+#include <QGridLayout>
+#include <QIcon>
+#include <QMessageBox>
+#include <QScrollBar>
+
+//ms between refreshes while the window is shown.
+#define DIAGNOSTICS_REFRESH_MS 1000
+
+DiagnosticsWindow::DiagnosticsWindow(Logger * logger, QWidget *parent) :
+    QWidget(parent),
+    logger(logger)
+{
+    setWindowIcon(QIcon(":/imgs/money_management.gif"));
+    setWindowTitle("Diagnostics");
+
+    report = new QPlainTextEdit(this);
+    report->setReadOnly(true);
+    report->setLineWrapMode(QPlainTextEdit::NoWrap);
+    report->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    threshold_edit = new QSpinBox(this);
+    threshold_edit->setRange(0, 60000);
+    threshold_edit->setSuffix(" ms");
+    threshold_edit->setValue(int(Metrics::instance().slow_threshold_ms()));
+    threshold_edit->setToolTip("Statements running at least this long have their query plan captured");
+    reset_button = new QPushButton("Reset", this);
+    save_button = new QPushButton("Save to File...", this);
+    status = new QLabel(this);
+
+    QGridLayout * layout = new QGridLayout(this);
+    layout->addWidget(new QLabel("Capture plans of statements slower than", this), 0, 0);
+    layout->addWidget(threshold_edit, 0, 1);
+    layout->addWidget(reset_button, 0, 3);
+    layout->addWidget(save_button, 0, 4);
+    layout->setColumnStretch(2, 1);
+    layout->addWidget(report, 1, 0, 1, 5);
+    layout->addWidget(status, 2, 0, 1, 5);
+
+    refresh_timer.setInterval(DIAGNOSTICS_REFRESH_MS);
+    connect(&refresh_timer, SIGNAL(timeout()), this, SLOT(refresh()));
+    connect(reset_button, SIGNAL(clicked()), this, SLOT(reset()));
+    connect(save_button, SIGNAL(clicked()), this, SLOT(save()));
+    connect(threshold_edit, SIGNAL(valueChanged(int)), this, SLOT(threshold_changed(int)));
+}
+
+/*
+ * Keeps the scroll position so the report can be read while it updates.
+*/
+void DiagnosticsWindow::refresh(){
+    int vertical = report->verticalScrollBar()->value();
+    int horizontal = report->horizontalScrollBar()->value();
+    report->setPlainText(Metrics::instance().report());
+    report->verticalScrollBar()->setValue(vertical);
+    report->horizontalScrollBar()->setValue(horizontal);
+    status->setText("Updated " + QDateTime::currentDateTime().toString("h:mm:ss AP"));
+}
+
+void DiagnosticsWindow::showEvent(QShowEvent * event){
+    QWidget::showEvent(event);
+    refresh();
+    refresh_timer.start();
+}
+
+void DiagnosticsWindow::hideEvent(QHideEvent * event){
+    refresh_timer.stop();
+    QWidget::hideEvent(event);
+}
+
+void DiagnosticsWindow::reset(){
+    logger->log(Logger::DEBUG, "Diagnostics reset");
+    Metrics::instance().reset();
+    refresh();
+}
+
+void DiagnosticsWindow::save(){
+    QString file_name = QFileDialog::getSaveFileName(this, "Save Diagnostics",
+                                                     "diagnostics-" + QDateTime::currentDateTime().toString("yyyyMMdd-HHmmss") + ".txt",
+                                                     "Text File (*.txt)");
+    if(file_name.isEmpty()) return;
+    QString error;
+    if(!Metrics::instance().dump(file_name, error)){
+        logger->log(Logger::WARNING, error);
+        QMessageBox::warning(this, "Error", error);
+        return;
+    }
+    logger->log(Logger::INFO, "Diagnostics saved to " + file_name);
+    status->setText("Saved to " + file_name);
+}
+
+void DiagnosticsWindow::threshold_changed(int ms){
+    Metrics::instance().set_slow_threshold_ms(ms);
+}
@@ -0,0 +1,44 @@
+#ifndef DIAGNOSTICSWINDOW_H
+#define DIAGNOSTICSWINDOW_H
+
+#include <QWidget>
+#include <QLabel>
+#include <QPlainTextEdit>
+#include <QPushButton>
+#include <QSpinBox>
+#include <QTimer>
+#include "Logger.h"
+
+/*
+ * Diagnostics window: the Metrics report (timings, histograms, counters and the query plans of slow
+ * statements), refreshed while the window is shown. It can be reset, and saved to a file to compare runs.
+*/
+class DiagnosticsWindow : public QWidget
+{
+    Q_OBJECT
+public:
+    explicit DiagnosticsWindow(Logger * logger, QWidget *parent = 0);
+
+public slots:
+    void refresh();
+
+protected:
+    void showEvent(QShowEvent * event);
+    void hideEvent(QHideEvent * event);
+
+private slots:
+    void reset();
+    void save();
+    void threshold_changed(int ms);
+
+private:
+    Logger * logger;
+    QPlainTextEdit * report;
+    QSpinBox * threshold_edit;
+    QPushButton * reset_button;
+    QPushButton * save_button;
+    QLabel * status;
+    QTimer refresh_timer;
+};
+
+#endif // DIAGNOSTICSWINDOW_H
@@ -0,0 +1,223 @@
+#include "LedgerCache.h"
+#include <QElapsedTimer>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QVariant>
+#include <limits>
+
+LedgerCache::LedgerCache() : loaded(false)
+{
+}
+
+/*
+ * One forward-only pass, each column is appended to its own array.
+*/
+bool LedgerCache::load(QSqlDatabase db, qint64 account, Logger * logger){
+    QElapsedTimer timer;
+    timer.start();
+    QSqlQuery qry(db);
+    qry.setForwardOnly(true);
+    qry.prepare("SELECT id, mode, trans_amount, balance, date_added FROM transactions WHERE account_id = :account ORDER BY date_added, id;");
+    qry.bindValue(":account", account);
+    bool result = qry.exec();
+    logger->log(Logger::DEBUG, "load ledger cache qry", qry.lastError().text());
+    if(!result){
+        invalidate();
+        return false;
+    }
+    clear();
+    while(qry.next()){
+        append(qry.value(0).toLongLong(), qry.value(1).toString(), Money::from_cents(qry.value(2).toLongLong()),
+               Money::from_cents(qry.value(3).toLongLong()), qry.value(4).toDate());
+    }
+    qry.finish();
+    ids.squeeze();
+    amounts.squeeze();
+    balances.squeeze();
+    deposits.squeeze();
+    dates.squeeze();
+    logger->log(Logger::INFO, "Account " + QString::number(account) + ": " + memory_report() + ", loaded in " + QString::number(timer.elapsed()) + " ms");
+    return true;
+}
+
+void LedgerCache::clear(){
+    ids.clear();
+    amounts.clear();
+    balances.clear();
+    deposits.clear();
+    dates.clear();
+    loaded = true;
+}
+
+void LedgerCache::invalidate(){
+    loaded = false;
+}
+
+bool LedgerCache::is_loaded() const{
+    return loaded;
+}
+
+int LedgerCache::size() const{
+    return ids.size();
+}
+
+void LedgerCache::append(qint64 id, QString mode, Money amount, Money balance, QDate date){
+    ids.append(id);
+    amounts.append(amount.to_cents());
+    balances.append(balance.to_cents());
+    deposits.append(mode == "Deposit" ? 1 : 0);
+    dates.append(date.isValid() ? qint32(date.toJulianDay()) : 0);
+}
+
+/*
+ * Rows without a date are day 0, so they sort first like NULL does in sqlite.
+*/
+int LedgerCache::insert_position(QDate date, qint64 id) const{
+    qint32 day = date.isValid() ? qint32(date.toJulianDay()) : 0;
+    const qint32 * day_data = dates.constData();
+    const qint64 * id_data = ids.constData();
+    int lo = 0;
+    int hi = ids.size();
+    while(lo < hi){
+        int mid = (lo + hi) / 2;
+        if(day_data[mid] < day || (day_data[mid] == day && id_data[mid] < id)){
+            lo = mid + 1;
+        }else{
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+int LedgerCache::insert(qint64 id, QString mode, Money amount, QDate date){
+    int row = insert_position(date, id);
+    ids.insert(row, id);
+    amounts.insert(row, amount.to_cents());
+    balances.insert(row, 0);
+    deposits.insert(row, mode == "Deposit" ? 1 : 0);
+    dates.insert(row, date.isValid() ? qint32(date.toJulianDay()) : 0);
+    recompute(row, ids.size() - 1);
+    return row;
+}
+
+void LedgerCache::set_transaction(int row, QString mode, Money amount){
+    amounts[row] = amount.to_cents();
+    deposits[row] = mode == "Deposit" ? 1 : 0;
+    recompute(row, ids.size() - 1);
+}
+
+/*
+ * The row is taken out and put back at its new place, only the rows between the two places change balance.
+*/
+int LedgerCache::set_date(int row, QDate date){
+    qint64 id = ids[row];
+    qint64 amount = amounts[row];
+    quint8 deposit = deposits[row];
+    ids.remove(row);
+    amounts.remove(row);
+    balances.remove(row);
+    deposits.remove(row);
+    dates.remove(row);
+    int new_row = insert_position(date, id);
+    ids.insert(new_row, id);
+    amounts.insert(new_row, amount);
+    balances.insert(new_row, 0);
+    deposits.insert(new_row, deposit);
+    dates.insert(new_row, date.isValid() ? qint32(date.toJulianDay()) : 0);
+    recompute(qMin(row, new_row), qMax(row, new_row));
+    return new_row;
+}
+
+void LedgerCache::recompute(int from, int to){
+    qint64 balance = from > 0 ? balances[from - 1] : 0;
+    const qint64 * amount_data = amounts.constData();
+    const quint8 * deposit_data = deposits.constData();
+    qint64 * balance_data = balances.data();
+    for(int i = from; i <= to; i++){
+        balance += deposit_data[i] ? amount_data[i] : -amount_data[i];
+        balance_data[i] = balance;
+    }
+}
+
+/*
+ * Ids alone aren't sorted once transactions are back-dated, (date, id) is: the row is where it would be inserted.
+*/
+int LedgerCache::row_of(qint64 id, QDate date) const{
+    int row = insert_position(date, id);
+    return row < ids.size() && ids[row] == id ? row : -1;
+}
+
+Money LedgerCache::min_balance(int from, int to) const{
+    qint64 lowest = std::numeric_limits<qint64>::max();
+    const qint64 * balance_data = balances.constData();
+    for(int i = from; i <= to; i++){
+        if(balance_data[i] < lowest) lowest = balance_data[i];
+    }
+    return Money::from_cents(lowest);
+}
+
+qint64 LedgerCache::id_at(int row) const{
+    return ids[row];
+}
+
+QString LedgerCache::mode_at(int row) const{
+    return deposits[row] ? QString("Deposit") : QString("Withdraw");
+}
+
+Money LedgerCache::amount_at(int row) const{
+    return Money::from_cents(amounts[row]);
+}
+
+Money LedgerCache::balance_at(int row) const{
+    return Money::from_cents(balances[row]);
+}
+
+QDate LedgerCache::date_at(int row) const{
+    return dates[row] != 0 ? QDate::fromJulianDay(dates[row]) : QDate();
+}
+
+Money LedgerCache::total() const{
+    return balances.isEmpty() ? Money() : Money::from_cents(balances.last());
+}
+
+const QVector<qint64> & LedgerCache::row_ids() const{
+    return ids;
+}
+
+QVector<qint64> LedgerCache::row_deltas() const{
+    QVector<qint64> deltas(ids.size());
+    const qint64 * amount_data = amounts.constData();
+    const quint8 * deposit_data = deposits.constData();
+    qint64 * delta_data = deltas.data();
+    for(int i = 0; i < ids.size(); i++){
+        delta_data[i] = deposit_data[i] ? amount_data[i] : -amount_data[i];
+    }
+    return deltas;
+}
+
+const QVector<qint64> & LedgerCache::row_amounts() const{
+    return amounts;
+}
+
+const QVector<quint8> & LedgerCache::row_deposits() const{
+    return deposits;
+}
+
+const QVector<qint32> & LedgerCache::row_days() const{
+    return dates;
+}
+
+qint64 LedgerCache::memory_bytes() const{
+    return qint64(ids.capacity()) * sizeof(qint64)
+            + qint64(amounts.capacity()) * sizeof(qint64)
+            + qint64(balances.capacity()) * sizeof(qint64)
+            + qint64(deposits.capacity()) * sizeof(quint8)
+            + qint64(dates.capacity()) * sizeof(qint32);
+}
+
+QString LedgerCache::memory_report() const{
+    return QString("Ledger cache: %1 rows, %2 KiB, %3 bytes/row")
+            .arg(size())
+            .arg(memory_bytes() / 1024.0, 0, 'f', 1)
+            .arg(size() > 0 ? double(memory_bytes()) / size() : 0, 0, 'f', 1);
+}
@@ -0,0 +1,95 @@
+#ifndef LEDGERCACHE_H
+#define LEDGERCACHE_H
+
+#include <QDate>
+#include <QSqlDatabase>
+#include <QString>
+#include <QVector>
+#include "Logger.h"
+#include "Money.h"
+
+/*
+ * In-memory copy of one account's transactions in ledger (date_added, id) order, laid out as one contiguous array per column
+ * (structure of arrays) so totals, validations and recomputes are plain loops over ints instead of model
+ * cells or queries. Descriptions aren't cached.
+ * Loaded once and kept in step by whoever writes, a row index here is the same row in the LedgerEngine.
+*/
+class LedgerCache
+{
+public:
+    LedgerCache();
+
+    //loads every transaction of the account in ledger order, returns false if the query fails
+    bool load(QSqlDatabase db, qint64 account, Logger * logger);
+
+    //empties the cache, it stays loaded (an empty ledger)
+    void clear();
+
+    //marks the cache stale, it must be loaded again before use
+    void invalidate();
+    bool is_loaded() const;
+
+    int size() const;
+
+    //adds a transaction after the last one, it must sort after it in ledger order
+    void append(qint64 id, QString mode, Money amount, Money balance, QDate date);
+
+    //row a transaction at (date, id) belongs at, every row from it onwards sorts after it
+    int insert_position(QDate date, qint64 id) const;
+
+    //adds a transaction at its insert_position(), shifting every later balance. returns its row
+    int insert(qint64 id, QString mode, Money amount, QDate date);
+
+    //replaces the row's mode/amount and recomputes every balance from that row onwards
+    void set_transaction(int row, QString mode, Money amount);
+
+    //changes the row's date, moving it to its new place in ledger order and recomputing the balances of
+    //every row it moved past. returns its new row
+    int set_date(int row, QDate date);
+
+    //row of the transaction with the given id and date, -1 if it isn't cached (or not on that date)
+    int row_of(qint64 id, QDate date) const;
+
+    //lowest balance in rows [from, to]
+    Money min_balance(int from, int to) const;
+
+    qint64 id_at(int row) const;
+    QString mode_at(int row) const;
+    Money amount_at(int row) const;
+    Money balance_at(int row) const;
+    QDate date_at(int row) const;
+
+    //balance after the last row
+    Money total() const;
+
+    //ids and signed amounts, to build a LedgerEngine without going back to the database
+    const QVector<qint64> & row_ids() const;
+    QVector<qint64> row_deltas() const;
+
+    //the raw columns, for aggregations that loop over the arrays (LedgerReports)
+    const QVector<qint64> & row_amounts() const;
+    const QVector<quint8> & row_deposits() const;
+    const QVector<qint32> & row_days() const;
+
+    //bytes held by the arrays (allocated capacity)
+    qint64 memory_bytes() const;
+
+    //one line with the row count and memory per row
+    QString memory_report() const;
+
+private:
+    //recomputes the balances of rows [from, to] from the balance before from
+    void recompute(int from, int to);
+
+    QVector<qint64> ids;
+    //cents
+    QVector<qint64> amounts;
+    QVector<qint64> balances;
+    //1 = deposit, 0 = withdrawal
+    QVector<quint8> deposits;
+    //julian day, 0 when the row has no date
+    QVector<qint32> dates;
+    bool loaded;
+};
+
+#endif // LEDGERCACHE_H
@@ -0,0 +1,209 @@
+#include "LedgerEngine.h"
+#include "DatabaseManager.h"
+#include "Metrics.h"
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QVariant>
+#include <algorithm>
+#include <limits>
+
+LedgerEngine::LedgerEngine() : loaded(false)
+{
+}
+
+bool LedgerEngine::load(QSqlDatabase db, qint64 account, Logger * logger){
+    QSqlQuery qry(db);
+    qry.setForwardOnly(true);
+    qry.prepare("SELECT id, mode, trans_amount FROM transactions WHERE account_id = :account ORDER BY date_added, id;");
+    qry.bindValue(":account", account);
+    bool result = qry.exec();
+    logger->log(Logger::DEBUG, "load ledger engine qry", qry.lastError().text());
+    if(!result){
+        invalidate();
+        return false;
+    }
+    QVector<qint64> row_ids;
+    QVector<qint64> row_deltas;
+    while(qry.next()){
+        row_ids.append(qry.value(0).toLongLong());
+        row_deltas.append(signed_amount(qry.value(1).toString(), Money::from_cents(qry.value(2).toLongLong())).to_cents());
+    }
+    load(row_ids, row_deltas);
+    logger->log(Logger::DEBUG, "Ledger engine loaded " + QString::number(size()) + " rows");
+    return true;
+}
+
+/*
+ * Builds both trees in O(n).
+*/
+void LedgerEngine::load(const QVector<qint64> & row_ids, const QVector<qint64> & row_deltas){
+    ScopedTimer scope("ledger.engine_build");
+    ids = row_ids;
+    deltas = row_deltas;
+    int n = deltas.size();
+
+    //fenwick tree built in place: each node pushes its partial sum to its parent.
+    fenwick = QVector<qint64>(n + 1, 0);
+    for(int i = 0; i < n; i++){
+        fenwick[i + 1] += deltas[i];
+        int parent = (i + 1) + ((i + 1) & -(i + 1));
+        if(parent <= n) fenwick[parent] += fenwick[i + 1];
+    }
+
+    QVector<qint64> balances(n);
+    qint64 balance = 0;
+    for(int i = 0; i < n; i++){
+        balance += deltas[i];
+        balances[i] = balance;
+    }
+    tree_min = QVector<qint64>(n > 0 ? 4 * n : 0, 0);
+    tree_add = QVector<qint64>(n > 0 ? 4 * n : 0, 0);
+    if(n > 0) build(1, 0, n - 1, balances);
+    loaded = true;
+}
+
+void LedgerEngine::invalidate(){
+    loaded = false;
+}
+
+bool LedgerEngine::is_loaded() const{
+    return loaded;
+}
+
+int LedgerEngine::size() const{
+    return ids.size();
+}
+
+qint64 LedgerEngine::id_at(int row) const{
+    return ids[row];
+}
+
+Money LedgerEngine::delta_at(int row) const{
+    return Money::from_cents(deltas[row]);
+}
+
+Money LedgerEngine::balance_at(int row) const{
+    return Money::from_cents(fenwick_sum(row));
+}
+
+Money LedgerEngine::total() const{
+    return ids.isEmpty() ? Money() : Money::from_cents(fenwick_sum(size() - 1));
+}
+
+Money LedgerEngine::min_balance(int from, int to) const{
+    if(from > to || ids.isEmpty()) return Money::from_cents(std::numeric_limits<qint64>::max());
+    return Money::from_cents(range_min(1, 0, size() - 1, from, to));
+}
+
+bool LedgerEngine::can_set_delta(int row, Money new_delta) const{
+    qint64 change = new_delta.to_cents() - deltas[row];
+    return range_min(1, 0, size() - 1, row, size() - 1) + change >= 0;
+}
+
+void LedgerEngine::set_delta(int row, Money new_delta){
+    qint64 change = new_delta.to_cents() - deltas[row];
+    deltas[row] = new_delta.to_cents();
+    fenwick_add(row, change);
+    range_add(1, 0, size() - 1, row, size() - 1, change);
+}
+
+/*
+ * Every later balance moves by the same amount, so the edited row and the rest of the account's chain are
+ * written with two statements in one transaction: the row itself, then one set-based UPDATE over the rows
+ * after it (a range of the (account_id, date_added, id) index) instead of one UPDATE per row.
+*/
+bool LedgerEngine::apply_edit(QSqlDatabase db, qint64 account, int row, QDate date, QString mode, Money amount, Logger * logger){
+    Money old_delta = delta_at(row);
+    Money new_delta = signed_amount(mode, amount);
+    qint64 change = new_delta.to_cents() - old_delta.to_cents();
+    set_delta(row, new_delta);
+
+    if(!db.transaction()){
+        logger->log(Logger::CRITICAL, "Error starting ledger edit transaction", db.lastError().text());
+        set_delta(row, old_delta);
+        return false;
+    }
+    QSqlQuery update_row_qry(db);
+    update_row_qry.prepare("UPDATE transactions SET mode = :mode, trans_amount = :trans_amount, balance = :balance WHERE id = :id;");
+    update_row_qry.bindValue(":mode", mode);
+    update_row_qry.bindValue(":trans_amount", amount.to_cents());
+    update_row_qry.bindValue(":balance", fenwick_sum(row));
+    update_row_qry.bindValue(":id", ids[row]);
+    bool result = Metrics::exec(db, update_row_qry, "sql.edit row");
+
+    QSqlQuery update_balance_qry(db);
+    if(result && change != 0 && row + 1 < size()){
+        update_balance_qry.prepare("UPDATE transactions SET balance = balance + :change WHERE account_id = :account AND "
+                                   + DatabaseManager::rows_after(":after", date) + ";");
+        update_balance_qry.bindValue(":change", change);
+        update_balance_qry.bindValue(":account", account);
+        DatabaseManager::bind_position(update_balance_qry, ":after", date, ids[row]);
+        result = Metrics::exec(db, update_balance_qry, "sql.shift balances");
+    }
+    if(result) result = db.commit();
+    if(!result){
+        logger->log(Logger::CRITICAL, "Error rewriting balances, rolling back", update_balance_qry.lastError().isValid() ? update_balance_qry.lastError().text() : update_row_qry.lastError().text());
+        db.rollback();
+        set_delta(row, old_delta);
+        return false;
+    }
+    Metrics::instance().add_count("ledger.balances_shifted", size() - row - 1);
+    logger->log(Logger::DEBUG, "Shifted " + QString::number(size() - row - 1) + " balances after row " + QString::number(row) + " by " + QString::number(change));
+    return true;
+}
+
+Money LedgerEngine::signed_amount(QString mode, Money amount){
+    return mode == "Deposit" ? amount : -amount;
+}
+
+LedgerEngine::Validation LedgerEngine::apply_transaction(QString description, QString mode, Money amount, Money & balance){
+    if(amount.is_negative() || amount.is_zero() || description.isEmpty() || (mode != "Deposit" && mode != "Withdraw")) return INVALID_INPUT;
+    if(mode == "Withdraw" && (balance - amount).is_negative()) return INSUFFICIENT_FUNDS;
+    balance += signed_amount(mode, amount);
+    return VALID;
+}
+
+void LedgerEngine::build(int node, int lo, int hi, const QVector<qint64> & balances){
+    if(lo == hi){
+        tree_min[node] = balances[lo];
+        return;
+    }
+    int mid = (lo + hi) / 2;
+    build(2 * node, lo, mid, balances);
+    build(2 * node + 1, mid + 1, hi, balances);
+    tree_min[node] = std::min(tree_min[2 * node], tree_min[2 * node + 1]);
+}
+
+void LedgerEngine::range_add(int node, int lo, int hi, int from, int to, qint64 value){
+    if(to < lo || hi < from) return;
+    if(from <= lo && hi <= to){
+        tree_min[node] += value;
+        tree_add[node] += value;
+        return;
+    }
+    int mid = (lo + hi) / 2;
+    range_add(2 * node, lo, mid, from, to, value);
+    range_add(2 * node + 1, mid + 1, hi, from, to, value);
+    tree_min[node] = std::min(tree_min[2 * node], tree_min[2 * node + 1]) + tree_add[node];
+}
+
+qint64 LedgerEngine::range_min(int node, int lo, int hi, int from, int to) const{
+    if(to < lo || hi < from) return std::numeric_limits<qint64>::max();
+    if(from <= lo && hi <= to) return tree_min[node];
+    int mid = (lo + hi) / 2;
+    return std::min(range_min(2 * node, lo, mid, from, to), range_min(2 * node + 1, mid + 1, hi, from, to)) + tree_add[node];
+}
+
+void LedgerEngine::fenwick_add(int row, qint64 value){
+    for(int i = row + 1; i < fenwick.size(); i += i & -i){
+        fenwick[i] += value;
+    }
+}
+
+qint64 LedgerEngine::fenwick_sum(int row) const{
+    qint64 sum = 0;
+    for(int i = row + 1; i > 0; i -= i & -i){
+        sum += fenwick[i];
+    }
+    return sum;
+}
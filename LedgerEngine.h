@@ -0,0 +1,90 @@
+#ifndef LEDGERENGINE_H
+#define LEDGERENGINE_H
+
+#include <QDate>
+#include <QVector>
+#include <QSqlDatabase>
+#include "Logger.h"
+#include "Money.h"
+
+/*
+ * Keeps the signed amount (delta) of every transaction in ledger (date_added, id) order so edits don't
+ * have to walk every subsequent row. Deltas and balances are held as cents, so the sums are exact.
+ * A fenwick tree over the deltas answers "balance after row i" in O(log n) and a segment tree over the
+ * running balances (with lazy range adds) answers "minimum balance from row i onwards" in O(log n),
+ * so validating and applying an edit is O(log n). Persisting it is two statements: the edited row and one
+ * set-based UPDATE shifting every later balance of the account.
+*/
+class LedgerEngine
+{
+public:
+    //result of checking a new transaction against the ledger rules
+    enum Validation{
+        VALID,
+        //missing description, amount not positive or mode isn't Deposit/Withdraw
+        INVALID_INPUT,
+        //a withdrawal that would make the balance negative
+        INSUFFICIENT_FUNDS
+    };
+
+    LedgerEngine();
+
+    //loads every transaction of the account in ledger order, returns false if the query fails
+    bool load(QSqlDatabase db, qint64 account, Logger * logger);
+
+    //loads from already fetched rows (ledger order)
+    void load(const QVector<qint64> & row_ids, const QVector<qint64> & row_deltas);
+
+    //marks the engine stale so it is reloaded before the next edit
+    void invalidate();
+    bool is_loaded() const;
+
+    int size() const;
+
+    qint64 id_at(int row) const;
+    Money delta_at(int row) const;
+
+    //running balance after the given row
+    Money balance_at(int row) const;
+
+    //balance after the last row
+    Money total() const;
+
+    //lowest running balance in rows [from, to]
+    Money min_balance(int from, int to) const;
+
+    //true if replacing the row's delta keeps every balance from that row onwards non-negative
+    bool can_set_delta(int row, Money new_delta) const;
+
+    //replaces the row's delta, shifting every later balance
+    void set_delta(int row, Money new_delta);
+
+    //updates the row's mode/amount and shifts every later balance of the account in one sql transaction.
+    //date is the row's date, it places the row in ledger order. the engine is left untouched if anything fails.
+    bool apply_edit(QSqlDatabase db, qint64 account, int row, QDate date, QString mode, Money amount, Logger * logger);
+
+    //+amount for deposits, -amount for withdrawals
+    static Money signed_amount(QString mode, Money amount);
+
+    //the rules every new transaction must pass, shared by the entry form and batch ingestion.
+    //balance is updated only when the transaction is VALID.
+    static Validation apply_transaction(QString description, QString mode, Money amount, Money & balance);
+
+private:
+    void build(int node, int lo, int hi, const QVector<qint64> & balances);
+    void range_add(int node, int lo, int hi, int from, int to, qint64 value);
+    qint64 range_min(int node, int lo, int hi, int from, int to) const;
+    void fenwick_add(int row, qint64 value);
+    qint64 fenwick_sum(int row) const;
+
+    QVector<qint64> ids;
+    //cents
+    QVector<qint64> deltas;
+    QVector<qint64> fenwick;
+    //segment tree, a node's min already includes its own pending add
+    QVector<qint64> tree_min;
+    QVector<qint64> tree_add;
+    bool loaded;
+};
+
+#endif // LEDGERENGINE_H
@@ -0,0 +1,184 @@
+#include "LedgerReports.h"
+#include <QDate>
+#include <QtConcurrent>
+
+//# of ledger rows summarized together, also the most a single edit has to recompute.
+#define REPORT_CHUNK_ROWS 16384
+
+struct LedgerReports::Summarize{
+    typedef ChunkSummary result_type;
+
+    explicit Summarize(const LedgerCache * cache) : cache(cache) {}
+
+    ChunkSummary operator()(int chunk) const{
+        return LedgerReports::summarize(*cache, chunk);
+    }
+
+    const LedgerCache * cache;
+};
+
+LedgerReports::LedgerReports() : merged(false)
+{
+}
+
+void LedgerReports::row_changed(int row){
+    int chunk = row / REPORT_CHUNK_ROWS;
+    if(chunk < stale.size()) stale[chunk] = true;
+    merged = false;
+}
+
+/*
+ * A back-dated insert moves every row after it one place on, so its caller passes the rest of the ledger.
+ * Chunks past the current count are marked by update() when it grows.
+*/
+void LedgerReports::rows_changed(int from, int to){
+    int last = qMin(to / REPORT_CHUNK_ROWS, stale.size() - 1);
+    for(int chunk = qMax(0, from / REPORT_CHUNK_ROWS); chunk <= last; chunk++){
+        stale[chunk] = true;
+    }
+    merged = false;
+}
+
+void LedgerReports::invalidate(){
+    chunks.clear();
+    stale.clear();
+    merged = false;
+}
+
+/*
+ * Only the stale chunks are mapped across the thread pool, the merge walks every summary in order carrying the
+ * balance before each chunk. Summaries are per period, so the merge is cheap next to the rows.
+*/
+int LedgerReports::update(const LedgerCache & cache){
+    int count = (cache.size() + REPORT_CHUNK_ROWS - 1) / REPORT_CHUNK_ROWS;
+    if(count != chunks.size()){
+        int old_count = chunks.size();
+        chunks.resize(count);
+        stale.resize(count);
+        for(int i = old_count; i < count; i++) stale[i] = true;
+        merged = false;
+    }
+    QVector<int> stale_chunks;
+    for(int i = 0; i < count; i++){
+        if(stale[i]) stale_chunks.append(i);
+    }
+    if(!stale_chunks.isEmpty()){
+        QVector<ChunkSummary> summaries = QtConcurrent::blockingMapped<QVector<ChunkSummary> >(stale_chunks, Summarize(&cache));
+        for(int i = 0; i < stale_chunks.size(); i++){
+            chunks[stale_chunks[i]] = summaries[i];
+            stale[stale_chunks[i]] = false;
+        }
+    }
+    if(merged) return stale_chunks.size();
+
+    QMap<int, Bucket> month_buckets;
+    qint64 offset = 0;
+    for(int i = 0; i < chunks.size(); i++){
+        QMap<int, Bucket>::const_iterator it = chunks[i].periods.constBegin();
+        for(; it != chunks[i].periods.constEnd(); ++it){
+            add_bucket(month_buckets, it.key(), it.value(), offset);
+        }
+        offset += chunks[i].net;
+    }
+    QMap<int, Bucket> year_buckets;
+    QMap<int, Bucket>::const_iterator it = month_buckets.constBegin();
+    for(; it != month_buckets.constEnd(); ++it){
+        add_bucket(year_buckets, it.key() / 100, it.value(), 0);
+    }
+    months = to_periods(month_buckets, true);
+    years = to_periods(year_buckets, false);
+    merged = true;
+    return stale_chunks.size();
+}
+
+int LedgerReports::chunk_count() const{
+    return chunks.size();
+}
+
+const ReportPeriods & LedgerReports::monthly() const{
+    return months;
+}
+
+const ReportPeriods & LedgerReports::yearly() const{
+    return years;
+}
+
+/*
+ * Runs on a pool thread, reads the cache's arrays only. Consecutive rows are usually on the same day, so the
+ * period key is only worked out again when the day changes.
+*/
+LedgerReports::ChunkSummary LedgerReports::summarize(const LedgerCache & cache, int chunk){
+    ChunkSummary summary;
+    int begin = chunk * REPORT_CHUNK_ROWS;
+    int end = qMin(begin + REPORT_CHUNK_ROWS, cache.size());
+    const qint64 * amounts = cache.row_amounts().constData();
+    const quint8 * deposits = cache.row_deposits().constData();
+    const qint32 * days = cache.row_days().constData();
+    qint64 balance = 0;
+    qint32 last_day = -1;
+    Bucket * bucket = NULL;
+    for(int i = begin; i < end; i++){
+        if(days[i] != last_day || bucket == NULL){
+            last_day = days[i];
+            int key = 0;
+            if(last_day != 0){
+                QDate date = QDate::fromJulianDay(last_day);
+                key = date.year() * 100 + date.month();
+            }
+            QMap<int, Bucket>::iterator it = summary.periods.find(key);
+            if(it == summary.periods.end()){
+                Bucket empty = {0, 0, 0, 0, 0};
+                it = summary.periods.insert(key, empty);
+                it.value().low = balance + (deposits[i] ? amounts[i] : -amounts[i]);
+                it.value().high = it.value().low;
+            }
+            bucket = &it.value();
+        }
+        if(deposits[i]){
+            balance += amounts[i];
+            bucket->deposits += amounts[i];
+        }else{
+            balance -= amounts[i];
+            bucket->withdrawals += amounts[i];
+        }
+        bucket->count++;
+        if(balance < bucket->low) bucket->low = balance;
+        if(balance > bucket->high) bucket->high = balance;
+    }
+    summary.net = balance;
+    return summary;
+}
+
+void LedgerReports::add_bucket(QMap<int, Bucket> & periods, int key, const Bucket & bucket, qint64 offset){
+    QMap<int, Bucket>::iterator it = periods.find(key);
+    if(it == periods.end()){
+        Bucket moved = bucket;
+        moved.low += offset;
+        moved.high += offset;
+        periods.insert(key, moved);
+        return;
+    }
+    it.value().count += bucket.count;
+    it.value().deposits += bucket.deposits;
+    it.value().withdrawals += bucket.withdrawals;
+    it.value().low = qMin(it.value().low, bucket.low + offset);
+    it.value().high = qMax(it.value().high, bucket.high + offset);
+}
+
+ReportPeriods LedgerReports::to_periods(const QMap<int, Bucket> & periods, bool months){
+    ReportPeriods result;
+    result.reserve(periods.size());
+    QMap<int, Bucket>::const_iterator it = periods.constBegin();
+    for(; it != periods.constEnd(); ++it){
+        ReportPeriod period;
+        period.year = months ? it.key() / 100 : it.key();
+        period.month = months ? it.key() % 100 : 0;
+        period.count = it.value().count;
+        period.deposits = Money::from_cents(it.value().deposits);
+        period.withdrawals = Money::from_cents(it.value().withdrawals);
+        period.min_balance = Money::from_cents(it.value().low);
+        period.max_balance = Money::from_cents(it.value().high);
+        result.append(period);
+    }
+    return result;
+}
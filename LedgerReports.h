@@ -0,0 +1,92 @@
+#ifndef LEDGERREPORTS_H
+#define LEDGERREPORTS_H
+
+#include <QMap>
+#include <QMetaType>
+#include <QVector>
+#include "LedgerCache.h"
+#include "Money.h"
+
+//totals of one month (or one year when month is 0). year 0 holds the transactions without a date.
+struct ReportPeriod{
+    int year;
+    int month;
+    int count;
+    Money deposits;
+    Money withdrawals;
+    Money min_balance;
+    Money max_balance;
+
+    Money net() const { return deposits - withdrawals; }
+};
+typedef QVector<ReportPeriod> ReportPeriods;
+Q_DECLARE_METATYPE(ReportPeriods)
+
+/*
+ * Monthly and yearly aggregates over a LedgerCache.
+ * The ledger is split into fixed size chunks of rows. Each chunk is summarized on its own, with its balances
+ * taken relative to the balance before the chunk, so the summaries are computed in parallel with QtConcurrent
+ * and kept between updates. A write only marks the chunk holding the row as stale: an edit shifts every later
+ * balance by the same amount, which only moves the later chunks' offsets. Inserts and date moves mark the
+ * chunks whose rows moved. update() recomputes the stale chunks
+ * and merges every summary in ledger order.
+*/
+class LedgerReports
+{
+public:
+    LedgerReports();
+
+    //the row was inserted/edited, its chunk is recomputed on the next update
+    void row_changed(int row);
+
+    //rows from..to (inclusive) were moved or inserted, only their chunks are recomputed on the next update
+    void rows_changed(int from, int to);
+
+    //every chunk is recomputed on the next update, used when the cache is reloaded
+    void invalidate();
+
+    //brings the reports up to date with the cache, returns the # of chunks that had to be recomputed
+    int update(const LedgerCache & cache);
+
+    //# of chunks the ledger is split in
+    int chunk_count() const;
+
+    //ordered by period
+    const ReportPeriods & monthly() const;
+    const ReportPeriods & yearly() const;
+
+private:
+    //balances are relative to the balance before the chunk until merged
+    struct Bucket{
+        int count;
+        qint64 deposits;
+        qint64 withdrawals;
+        qint64 low;
+        qint64 high;
+    };
+
+    //buckets are keyed by year * 100 + month, 0 for rows without a date
+    struct ChunkSummary{
+        qint64 net;
+        QMap<int, Bucket> periods;
+    };
+
+    //QtConcurrent functor summarizing one chunk of the cache
+    struct Summarize;
+
+    static ChunkSummary summarize(const LedgerCache & cache, int chunk);
+
+    //merges bucket into periods[key], moving its balances by offset
+    static void add_bucket(QMap<int, Bucket> & periods, int key, const Bucket & bucket, qint64 offset);
+
+    static ReportPeriods to_periods(const QMap<int, Bucket> & periods, bool months);
+
+    QVector<ChunkSummary> chunks;
+    QVector<bool> stale;
+    ReportPeriods months;
+    ReportPeriods years;
+    //false when months/years need to be merged again
+    bool merged;
+};
+
+#endif // LEDGERREPORTS_H
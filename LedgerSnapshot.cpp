@@ -0,0 +1,243 @@
+#include "LedgerSnapshot.h"
+#include <QtEndian>
+#include <climits>
+#include <string.h>
+
+//"MMSNAP" then two zero bytes.
+static const char SNAPSHOT_MAGIC[8] = {'M', 'M', 'S', 'N', 'A', 'P', 0, 0};
+//magic, version, header size, row count, string table size, checksum, reserved.
+#define SNAPSHOT_HEADER_SIZE 40
+//every block starts on a multiple of this.
+#define SNAPSHOT_ALIGNMENT 8
+#define MODE_DEPOSIT 1
+#define MODE_WITHDRAW 2
+
+static qint64 aligned(qint64 offset){
+    return (offset + SNAPSHOT_ALIGNMENT - 1) / SNAPSHOT_ALIGNMENT * SNAPSHOT_ALIGNMENT;
+}
+
+QString LedgerSnapshot::suffix(){
+    return "mmsnap";
+}
+
+LedgerSnapshot::LedgerSnapshot() : mapped(NULL), rows(0), mapped_version(0)
+{
+    offsets.append(0);
+}
+
+void LedgerSnapshot::clear(){
+    if(mapped != NULL) file.unmap(const_cast<uchar*>(mapped));
+    mapped = NULL;
+    rows = 0;
+    mapped_version = 0;
+    if(file.isOpen()) file.close();
+    amounts.clear();
+    balances.clear();
+    days.clear();
+    offsets.clear();
+    offsets.append(0);
+    modes.clear();
+    strings.clear();
+}
+
+void LedgerSnapshot::reserve(int rows){
+    amounts.reserve(rows);
+    balances.reserve(rows);
+    days.reserve(rows);
+    offsets.reserve(rows + 1);
+    modes.reserve(rows);
+}
+
+bool LedgerSnapshot::append(QString description, QString mode, Money amount, Money balance, QDate date){
+    quint8 mode_code = mode == "Deposit" ? MODE_DEPOSIT : mode == "Withdraw" ? MODE_WITHDRAW : 0;
+    if(mode_code == 0) return false;
+    amounts.append(amount.to_cents());
+    balances.append(balance.to_cents());
+    days.append(date.isValid() ? qint32(date.toJulianDay()) : 0);
+    modes.append(mode_code);
+    strings.append(description.toUtf8());
+    offsets.append(quint32(strings.size()));
+    return true;
+}
+
+LedgerSnapshot::Layout LedgerSnapshot::layout(qint64 rows, qint64 string_bytes){
+    Layout result;
+    result.amounts = SNAPSHOT_HEADER_SIZE;
+    result.balances = aligned(result.amounts + rows * 8);
+    result.days = aligned(result.balances + rows * 8);
+    result.offsets = aligned(result.days + rows * 4);
+    result.modes = aligned(result.offsets + (rows + 1) * 4);
+    result.strings = aligned(result.modes + rows);
+    result.end = result.strings + string_bytes;
+    return result;
+}
+
+qint64 LedgerSnapshot::file_size() const{
+    return layout(amounts.size(), strings.size()).end;
+}
+
+/*
+ * The whole file is laid out in one buffer and written with a single call, the checksum is filled in last.
+*/
+bool LedgerSnapshot::write(QString file_name, QString & error) const{
+    int count = amounts.size();
+    Layout blocks = layout(count, strings.size());
+    QByteArray buffer(int(blocks.end), '\0');
+    uchar * out = reinterpret_cast<uchar*>(buffer.data());
+    for(int i = 0; i < count; i++){
+        qToLittleEndian<qint64>(amounts[i], out + blocks.amounts + i * 8);
+        qToLittleEndian<qint64>(balances[i], out + blocks.balances + i * 8);
+        qToLittleEndian<qint32>(days[i], out + blocks.days + i * 4);
+    }
+    for(int i = 0; i <= count; i++){
+        qToLittleEndian<quint32>(offsets[i], out + blocks.offsets + i * 4);
+    }
+    memcpy(out + blocks.modes, modes.constData(), count);
+    memcpy(out + blocks.strings, strings.constData(), strings.size());
+
+    memcpy(out, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    qToLittleEndian<quint32>(FORMAT_VERSION, out + 8);
+    qToLittleEndian<quint32>(SNAPSHOT_HEADER_SIZE, out + 12);
+    qToLittleEndian<quint64>(count, out + 16);
+    qToLittleEndian<quint64>(strings.size(), out + 24);
+    qToLittleEndian<quint32>(crc32(out + SNAPSHOT_HEADER_SIZE, blocks.end - SNAPSHOT_HEADER_SIZE), out + 32);
+
+    QFile snapshot_file(file_name);
+    if(!snapshot_file.open(QFile::WriteOnly | QFile::Truncate)){
+        error = "Error opening " + file_name + " for export, please try again";
+        return false;
+    }
+    if(snapshot_file.write(buffer) != buffer.size()){
+        error = "Error writing to " + file_name + ", please try again";
+        snapshot_file.close();
+        snapshot_file.remove();
+        return false;
+    }
+    snapshot_file.close();
+    return true;
+}
+
+/*
+ * Everything the accessors rely on is checked here: the magic, the version, that the blocks fit the file
+ * exactly, the checksum, that the description offsets only ever move forward inside the string table and that
+ * every mode is a known one.
+*/
+bool LedgerSnapshot::map(QString file_name, QString & error){
+    clear();
+    file.setFileName(file_name);
+    if(!file.open(QFile::ReadOnly)){
+        error = "Error opening " + file_name + " for import, please try again";
+        return false;
+    }
+    qint64 size = file.size();
+    const uchar * data = size >= SNAPSHOT_HEADER_SIZE ? file.map(0, size) : NULL;
+    if(data == NULL || memcmp(data, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0){
+        if(data != NULL) file.unmap(const_cast<uchar*>(data));
+        file.close();
+        error = file_name + " is not a transaction snapshot";
+        return false;
+    }
+    quint32 version = qFromLittleEndian<quint32>(data + 8);
+    quint32 header_size = qFromLittleEndian<quint32>(data + 12);
+    quint64 count = qFromLittleEndian<quint64>(data + 16);
+    quint64 string_bytes = qFromLittleEndian<quint64>(data + 24);
+    quint32 checksum = qFromLittleEndian<quint32>(data + 32);
+    mapped = data;
+    if(version < MIN_FORMAT_VERSION || version > FORMAT_VERSION){
+        error = file_name + (version > FORMAT_VERSION ? " was written by a newer version" : " uses an unsupported snapshot format")
+                + " (snapshot format " + QString::number(version) + ", expected " + QString::number(MIN_FORMAT_VERSION)
+                + " to " + QString::number(FORMAT_VERSION) + ")";
+        clear();
+        return false;
+    }
+    if(header_size != SNAPSHOT_HEADER_SIZE){
+        error = file_name + " is damaged (bad header size)";
+        clear();
+        return false;
+    }
+    if(count > quint64(INT_MAX) || string_bytes > quint64(size) || layout(qint64(count), qint64(string_bytes)).end != size){
+        error = file_name + " is truncated or damaged";
+        clear();
+        return false;
+    }
+    if(crc32(data + SNAPSHOT_HEADER_SIZE, size - SNAPSHOT_HEADER_SIZE) != checksum){
+        error = file_name + " is damaged (checksum mismatch)";
+        clear();
+        return false;
+    }
+    mapped_layout = layout(qint64(count), qint64(string_bytes));
+    quint32 previous = 0;
+    for(quint64 i = 0; i <= count; i++){
+        quint32 offset = qFromLittleEndian<quint32>(data + mapped_layout.offsets + i * 4);
+        if(offset < previous || offset > string_bytes || (i == 0 && offset != 0)){
+            error = file_name + " is damaged (bad description offsets)";
+            clear();
+            return false;
+        }
+        previous = offset;
+    }
+    for(quint64 i = 0; i < count; i++){
+        quint8 mode = data[mapped_layout.modes + i];
+        if(mode != MODE_DEPOSIT && mode != MODE_WITHDRAW){
+            error = file_name + " is damaged (transaction " + QString::number(i + 1) + " has an unknown mode)";
+            clear();
+            return false;
+        }
+    }
+    rows = int(count);
+    mapped_version = version;
+    return true;
+}
+
+int LedgerSnapshot::size() const{
+    return mapped != NULL ? rows : amounts.size();
+}
+
+QString LedgerSnapshot::description_at(int row) const{
+    quint32 begin = qFromLittleEndian<quint32>(mapped + mapped_layout.offsets + row * 4);
+    quint32 end = qFromLittleEndian<quint32>(mapped + mapped_layout.offsets + (row + 1) * 4);
+    return QString::fromUtf8(reinterpret_cast<const char*>(mapped + mapped_layout.strings + begin), int(end - begin));
+}
+
+quint32 LedgerSnapshot::format_version() const{
+    return mapped_version;
+}
+
+QString LedgerSnapshot::mode_at(int row) const{
+    return mapped[mapped_layout.modes + row] == MODE_DEPOSIT ? QString("Deposit") : QString("Withdraw");
+}
+
+Money LedgerSnapshot::amount_at(int row) const{
+    return Money::from_cents(qFromLittleEndian<qint64>(mapped + mapped_layout.amounts + row * 8));
+}
+
+Money LedgerSnapshot::balance_at(int row) const{
+    return Money::from_cents(qFromLittleEndian<qint64>(mapped + mapped_layout.balances + row * 8));
+}
+
+QDate LedgerSnapshot::date_at(int row) const{
+    qint32 day = qFromLittleEndian<qint32>(mapped + mapped_layout.days + row * 4);
+    return day != 0 ? QDate::fromJulianDay(day) : QDate();
+}
+
+static QVector<quint32> crc_table(){
+    QVector<quint32> table(256);
+    for(quint32 i = 0; i < 256; i++){
+        quint32 value = i;
+        for(int bit = 0; bit < 8; bit++){
+            value = (value & 1) ? (value >> 1) ^ 0xEDB88320u : value >> 1;
+        }
+        table[i] = value;
+    }
+    return table;
+}
+
+quint32 LedgerSnapshot::crc32(const uchar * data, qint64 size, quint32 crc){
+    static const QVector<quint32> table = crc_table();
+    const quint32 * entries = table.constData();
+    crc = ~crc;
+    for(qint64 i = 0; i < size; i++){
+        crc = entries[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
@@ -0,0 +1,94 @@
+#ifndef LEDGERSNAPSHOT_H
+#define LEDGERSNAPSHOT_H
+
+#include <QByteArray>
+#include <QDate>
+#include <QFile>
+#include <QString>
+#include <QVector>
+#include "Money.h"
+
+/*
+ * Binary snapshot of one account's transactions, a compact alternative to the .sql dump.
+ * Layout (little endian, every block starts 8 byte aligned):
+ *   header      magic "MMSNAP\0\0", format version, header size, row count, string table size, CRC32 of the body
+ *   amounts     qint64 cents per row
+ *   balances    qint64 cents per row
+ *   days        qint32 julian day per row, 0 = no date
+ *   offsets     quint32 per row + 1, where each description starts in the string table
+ *   modes       quint8 per row, 1 = Deposit, 2 = Withdraw
+ *   strings     the descriptions' UTF-8, back to back
+ * Rows are in ledger order: (date, id) since format 2, id order in format 1 (same layout, still read).
+ * Build one with append() and write() it, or map() a file and read it in place:
+ * the file is memory mapped and only checked (size, checksum), nothing is copied or parsed up front.
+*/
+class LedgerSnapshot
+{
+public:
+    static const quint32 FORMAT_VERSION = 2;
+    //oldest format map() reads
+    static const quint32 MIN_FORMAT_VERSION = 1;
+
+    //suffix of snapshot files, the import picks the format by it
+    static QString suffix();
+
+    LedgerSnapshot();
+
+    //building
+    void reserve(int rows);
+    //false if mode isn't Deposit or Withdraw
+    bool append(QString description, QString mode, Money amount, Money balance, QDate date);
+    bool write(QString file_name, QString & error) const;
+
+    //reading, the mapping lasts until the snapshot is destroyed or mapped again
+    bool map(QString file_name, QString & error);
+
+    int size() const;
+    QString description_at(int row) const;
+    QString mode_at(int row) const;
+
+    //format of the mapped file
+    quint32 format_version() const;
+    Money amount_at(int row) const;
+    Money balance_at(int row) const;
+    QDate date_at(int row) const;
+
+    //file size for the rows appended so far
+    qint64 file_size() const;
+
+    //CRC-32 (IEEE) of data
+    static quint32 crc32(const uchar * data, qint64 size, quint32 crc = 0);
+
+private:
+    //unmaps the file (if any) and drops the built rows
+    void clear();
+
+    //block offsets from the start of the file for rows rows and a string table of string_bytes bytes
+    struct Layout{
+        qint64 amounts;
+        qint64 balances;
+        qint64 days;
+        qint64 offsets;
+        qint64 modes;
+        qint64 strings;
+        qint64 end;
+    };
+    static Layout layout(qint64 rows, qint64 string_bytes);
+
+    //built rows
+    QVector<qint64> amounts;
+    QVector<qint64> balances;
+    QVector<qint32> days;
+    QVector<quint32> offsets;
+    QVector<quint8> modes;
+    QByteArray strings;
+
+    //mapped file
+    QFile file;
+    const uchar * mapped;
+    int rows;
+    quint32 mapped_version;
+    Layout mapped_layout;
+};
+
+#endif // LEDGERSNAPSHOT_H
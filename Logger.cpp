@@ -4,7 +4,27 @@
 #include <QDebug>
 #include <QDir>
 #include <QMessageBox>
+#include <QApplication>
 #include <QStandardPaths>
+#include <QThread>
+
+//size (bytes) a batch of formatted records may grow to before it is written out.
+#define WRITE_BATCH_SIZE (64 * 1024)
+//max # of ms the writer sleeps before re-checking the queue.
+#define WRITER_IDLE_WAIT 100
+
+class LogWriter : public QThread
+{
+public:
+    explicit LogWriter(Logger * logger) : logger(logger) {}
+protected:
+    void run(){
+        logger->drain();
+    }
+private:
+    Logger * logger;
+};
+
 Logger::Logger(QObject *parent) : QObject(parent)
 {
 //    QString log_folder_path = QDir::fromNativeSeparators(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/logs");
@@ -13,15 +33,37 @@ Logger::Logger(QObject *parent) : QObject(parent)
     if(!log_folder.exists()) QDir().mkdir(log_folder_path);
     QString file_name = QDir::fromNativeSeparators(log_folder_path + "/" + QDateTime::currentDateTime().toString("MMddyyyyhhmmssA") + ".txt");
     log_file = new QFile(file_name);
-    stream = new QTextStream(log_file);
-    if(!log_file->open(QFile::WriteOnly)) QMessageBox::critical(NULL, "Error", "Error opening " + file_name + " for writing");
+    if(!log_file->open(QFile::WriteOnly)){
+        //headless runs have no widgets to show a message box with
+        if(qobject_cast<QApplication*>(QCoreApplication::instance()) != NULL){
+            QMessageBox::critical(NULL, "Error", "Error opening " + file_name + " for writing");
+        }else{
+            qWarning() << "Error opening" << file_name << "for writing";
+        }
+    }
+#ifdef QT_NO_DEBUG
+    set_minimum_level(INFO);
+#else
+    set_minimum_level(DEBUG);
+#endif
+    stub.next.storeRelease(NULL);
+    head.storeRelease(&stub);
+    tail = &stub;
+    written = 0;
+    writer = new LogWriter(this);
+    writer->start(QThread::LowPriority);
 }
 
 Logger::~Logger(){
-    stream->flush();
+    flush();
+    stopping.storeRelease(1);
+    mutex.lock();
+    work_available.wakeAll();
+    mutex.unlock();
+    writer->wait();
+    delete writer;
     log_file->flush();
     log_file->close();
-    delete stream;
     delete log_file;
 }
 
@@ -29,9 +71,105 @@ QString Logger::get_file_name(){
     return log_file->fileName();
 }
 
+int Logger::severity(Level level){
+    switch(level){
+    case CRITICAL:
+        return 0;
+    case WARNING:
+        return 1;
+    case INFO:
+        return 2;
+    case DEBUG:
+        return 3;
+    }
+    return 3;
+}
+
+void Logger::set_minimum_level(Level level){
+    min_severity.storeRelease(severity(level));
+}
+
+Logger::Level Logger::minimum_level() const{
+    switch(min_severity.loadAcquire()){
+    case 0:
+        return CRITICAL;
+    case 1:
+        return WARNING;
+    case 2:
+        return INFO;
+    default:
+        return DEBUG;
+    }
+}
+
+bool Logger::is_enabled(Level level) const{
+    return severity(level) <= min_severity.loadAcquire();
+}
+
+/*
+ * Queues the record for the writer thread. Formatting happens on the writer thread,
+ * a query error (qry_text that isn't " ") is always logged as CRITICAL.
+*/
 void Logger::log(Level level, QString msg, QString qry_text){
+    bool query_error = !qry_text.isNull() && qry_text != " ";
+    if(query_error) level = CRITICAL;
+    if(!is_enabled(level)) return;
+
+    Record * record = new Record;
+    record->level = level;
+    record->msg = msg;
+    record->qry_text = qry_text;
+    enqueue(record);
+
+    if(level == CRITICAL) flush();
+}
+
+/*
+ * Multi-producer push, producers only ever touch head.
+*/
+void Logger::enqueue(Record * record){
+    record->next.storeRelease(NULL);
+    enqueued.fetchAndAddOrdered(1);
+    Record * prev = head.fetchAndStoreOrdered(record);
+    prev->next.storeRelease(record);
+    if(writer_sleeping.loadAcquire()){
+        QMutexLocker locker(&mutex);
+        work_available.wakeAll();
+    }
+}
+
+/*
+ * Single-consumer pop, returns NULL when the queue is empty or a push is still in progress.
+*/
+Logger::Record * Logger::dequeue(){
+    Record * current = tail;
+    Record * next = current->next.loadAcquire();
+    if(current == &stub){
+        if(next == NULL) return NULL;
+        tail = next;
+        current = next;
+        next = next->next.loadAcquire();
+    }
+    if(next != NULL){
+        tail = next;
+        return current;
+    }
+    if(current != head.loadAcquire()) return NULL;
+    //current is the last record, re-insert the stub behind it so it can be detached
+    stub.next.storeRelease(NULL);
+    Record * prev = head.fetchAndStoreOrdered(&stub);
+    prev->next.storeRelease(&stub);
+    next = current->next.loadAcquire();
+    if(next != NULL){
+        tail = next;
+        return current;
+    }
+    return NULL;
+}
+
+QString Logger::format(const Record * record){
     QString edited_msg;
-    switch(level){
+    switch(record->level){
     case WARNING:
         edited_msg = "[WARNING] - ";
         break;
@@ -47,22 +185,72 @@ void Logger::log(Level level, QString msg, QString qry_text){
     default:
         break;
     }
-    if(!qry_text.isNull()){
-        if(qry_text != " "){
+    if(!record->qry_text.isNull()){
+        if(record->qry_text != " "){
             edited_msg = "[CRITICAL] - ";
-            edited_msg.append(msg);
+            edited_msg.append(record->msg);
             edited_msg.append('\n');
             edited_msg.append("Query Error: ");
-            edited_msg.append(qry_text);
+            edited_msg.append(record->qry_text);
         }else{
-            edited_msg.append(msg);
+            edited_msg.append(record->msg);
             edited_msg.append(": Successful");
         }
     }else{
-        edited_msg += msg;
+        edited_msg += record->msg;
+    }
+    return edited_msg;
+}
+
+/*
+ * Writer thread loop. Everything available is formatted into one buffer and written with a single
+ * write call, then the writer sleeps until woken by a producer, a flush request or the idle timeout.
+*/
+void Logger::drain(){
+    QByteArray batch;
+    batch.reserve(WRITE_BATCH_SIZE);
+    forever{
+        quint64 count = 0;
+        Record * record;
+        while((record = dequeue()) != NULL){
+            batch.append(format(record).toUtf8());
+            batch.append('\n');
+            delete record;
+            count++;
+            if(batch.size() >= WRITE_BATCH_SIZE){
+                log_file->write(batch);
+                batch.resize(0);
+            }
+        }
+        if(!batch.isEmpty()){
+            log_file->write(batch);
+            batch.resize(0);
+        }
+        QMutexLocker locker(&mutex);
+        if(count > 0){
+            log_file->flush();
+            written += count;
+            batch_written.wakeAll();
+            continue;
+        }
+        if(written == enqueued.load()){
+            if(stopping.loadAcquire()) break;
+            writer_sleeping.fetchAndStoreOrdered(1);
+            if(written == enqueued.load()) work_available.wait(&mutex, WRITER_IDLE_WAIT);
+            writer_sleeping.fetchAndStoreOrdered(0);
+        }else{
+            //a push is half way done, give the producer a moment to link it in
+            locker.unlock();
+            QThread::yieldCurrentThread();
+        }
+    }
+}
+
+void Logger::flush(){
+    quint64 target = enqueued.load();
+    QMutexLocker locker(&mutex);
+    work_available.wakeAll();
+    while(written < target && writer->isRunning()){
+        batch_written.wait(&mutex, WRITER_IDLE_WAIT);
     }
-    
-    (*stream) << edited_msg << endl;
-    stream->flush();
-    log_file->flush();
 }
@@ -3,7 +3,18 @@
 
 #include <QObject>
 #include <QFile>
-#include <QTextStream>
+#include <QAtomicInt>
+#include <QAtomicPointer>
+#include <QAtomicInteger>
+#include <QMutex>
+#include <QWaitCondition>
+
+class LogWriter;
+
+/*
+ * Records are handed to a lock-free queue and formatted/written by a background writer thread,
+ * so logging never blocks the GUI thread on file io.
+*/
 class Logger : public QObject
 {
     Q_OBJECT
@@ -16,12 +27,57 @@ public:
         INFO,
         DEBUG
     };
-    
+
     QString get_file_name();
     void log(Level, QString msg, QString = QString());
+
+    //records less severe than the minimum level are dropped before anything is queued
+    void set_minimum_level(Level);
+    Level minimum_level() const;
+
+    //cheap check so callers can skip building expensive messages
+    bool is_enabled(Level) const;
+
+    //blocks until every queued record has been written to the log file
+    void flush();
 private:
+    friend class LogWriter;
+
+    struct Record{
+        Level level;
+        QString msg;
+        QString qry_text;
+        QAtomicPointer<Record> next;
+    };
+
+    //0 is the most severe, used to compare levels since the enum isn't ordered by severity
+    static int severity(Level);
+
+    //producer side of the queue, safe to call from any thread
+    void enqueue(Record *);
+    //consumer side of the queue, only called by the writer thread
+    Record * dequeue();
+    static QString format(const Record *);
+
+    //writer thread body, drains the queue in batches until stopped
+    void drain();
+
     QFile * log_file;
-    QTextStream * stream;
+    LogWriter * writer;
+    QAtomicInt min_severity;
+    QAtomicInt stopping;
+    QAtomicInt writer_sleeping;
+
+    //multi-producer single-consumer queue, head is pushed to by producers, tail is owned by the writer
+    QAtomicPointer<Record> head;
+    Record * tail;
+    Record stub;
+
+    QAtomicInteger<quint64> enqueued;
+    quint64 written;
+    QMutex mutex;
+    QWaitCondition work_available;
+    QWaitCondition batch_written;
 };
 
 #endif // LOGGER_H
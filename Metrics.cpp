@@ -0,0 +1,215 @@
+#include "Metrics.h"
+#include <QFile>
+#include <QMutexLocker>
+#include <QSettings>
+#include <QSqlError>
+#include <QStringList>
+#include <QTextStream>
+
+//statements slower than this (ms) get their query plan captured, 0 = capture every statement once.
+#define SLOW_STATEMENT_MS_KEY "diagnostics/slow_statement_ms"
+#define SLOW_STATEMENT_MS_DEFAULT 20
+//slowest statements kept with their plans, the fastest of them is dropped for a new one.
+#define SLOW_STATEMENT_LIMIT 50
+
+Metrics & Metrics::instance(){
+    static Metrics metrics;
+    return metrics;
+}
+
+Metrics::Metrics()
+{
+    slow_ns.store(QSettings().value(SLOW_STATEMENT_MS_KEY, SLOW_STATEMENT_MS_DEFAULT).toLongLong() * 1000000);
+}
+
+int Metrics::bucket_of(qint64 ns){
+    qint64 us = ns / 1000;
+    int bucket = 0;
+    while(us > 1 && bucket < HISTOGRAM_BUCKETS - 1){
+        us >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+qint64 Metrics::Timing::percentile_ns(double p) const{
+    qint64 wanted = qint64(p * count + 0.5);
+    if(wanted < 1) wanted = 1;
+    qint64 seen = 0;
+    for(int i = 0; i < buckets.size(); i++){
+        seen += buckets[i];
+        if(seen >= wanted) return qMin(max_ns, (qint64(2) << i) * 1000);
+    }
+    return max_ns;
+}
+
+void Metrics::add_time(const QString & name, qint64 ns){
+    QMutexLocker locker(&mutex);
+    Timing & timing = timings[name];
+    if(timing.count == 0 || ns < timing.min_ns) timing.min_ns = ns;
+    if(ns > timing.max_ns) timing.max_ns = ns;
+    timing.count++;
+    timing.total_ns += ns;
+    timing.buckets[bucket_of(ns)]++;
+}
+
+void Metrics::add_count(const QString & name, qint64 n){
+    QMutexLocker locker(&mutex);
+    counts[name] += n;
+}
+
+/*
+ * The plan is captured outside the lock (it runs another statement) and only the first time a statement is
+ * slow, after that only its slowest time is updated.
+*/
+void Metrics::statement_executed(QSqlDatabase db, const QSqlQuery & query, const QString & name, qint64 ns){
+    add_time(name, ns);
+    if(ns < slow_ns.load()) return;
+    QString sql = query.lastQuery();
+    {
+        QMutexLocker locker(&mutex);
+        QMap<QString, SlowStatement>::iterator it = slow.find(sql);
+        if(it != slow.end()){
+            if(ns > it->ns){
+                it->ns = ns;
+                it->when = QDateTime::currentDateTime();
+            }
+            return;
+        }
+    }
+    SlowStatement statement;
+    statement.name = name;
+    statement.sql = sql;
+    statement.ns = ns;
+    statement.plan = explain(db, query);
+    statement.when = QDateTime::currentDateTime();
+
+    QMutexLocker locker(&mutex);
+    if(slow.size() >= SLOW_STATEMENT_LIMIT){
+        QMap<QString, SlowStatement>::iterator fastest = slow.begin();
+        for(QMap<QString, SlowStatement>::iterator it = slow.begin(); it != slow.end(); ++it){
+            if(it->ns < fastest->ns) fastest = it;
+        }
+        if(fastest->ns >= ns) return;
+        slow.erase(fastest);
+    }
+    slow.insert(sql, statement);
+}
+
+bool Metrics::exec(QSqlDatabase db, QSqlQuery & query, const QString & name){
+    QElapsedTimer timer;
+    timer.start();
+    bool result = query.exec();
+    instance().statement_executed(db, query, name, timer.nsecsElapsed());
+    return result;
+}
+
+QString Metrics::explain(QSqlDatabase db, const QSqlQuery & query){
+    QSqlQuery plan_qry(db);
+    if(!plan_qry.prepare("EXPLAIN QUERY PLAN " + query.lastQuery())) return "(no plan: " + plan_qry.lastError().text() + ")";
+    QMap<QString, QVariant> values = query.boundValues();
+    for(QMap<QString, QVariant>::const_iterator it = values.constBegin(); it != values.constEnd(); ++it){
+        plan_qry.bindValue(it.key(), it.value());
+    }
+    if(!plan_qry.exec()) return "(no plan: " + plan_qry.lastError().text() + ")";
+    //columns: id, parent, notused, detail. steps are indented under their parent
+    QMap<int, int> depth;
+    QStringList steps;
+    while(plan_qry.next()){
+        int id = plan_qry.value(0).toInt();
+        int parent = plan_qry.value(1).toInt();
+        depth[id] = depth.value(parent, -1) + 1;
+        steps << QString(depth[id] * 2, ' ') + plan_qry.value(3).toString();
+    }
+    return steps.join("\n");
+}
+
+qint64 Metrics::slow_threshold_ms() const{
+    return slow_ns.load() / 1000000;
+}
+
+void Metrics::set_slow_threshold_ms(qint64 ms){
+    slow_ns.store(ms * 1000000);
+    QSettings().setValue(SLOW_STATEMENT_MS_KEY, ms);
+}
+
+QString Metrics::report() const{
+    QMutexLocker locker(&mutex);
+    QString report;
+    QTextStream out(&report);
+    out << QString("%1 %2 %3 %4 %5 %6 %7 %8\n")
+           .arg("Timings (ms)", -36).arg("count", 9).arg("total", 11).arg("mean", 10)
+           .arg("p50", 10).arg("p95", 10).arg("p99", 10).arg("max", 10);
+    for(QMap<QString, Timing>::const_iterator it = timings.constBegin(); it != timings.constEnd(); ++it){
+        const Timing & timing = it.value();
+        out << QString("%1 %2 %3 %4 %5 %6 %7 %8\n")
+               .arg(it.key(), -36)
+               .arg(timing.count, 9)
+               .arg(timing.total_ns / 1e6, 11, 'f', 2)
+               .arg(timing.total_ns / 1e6 / timing.count, 10, 'f', 3)
+               .arg(timing.percentile_ns(0.50) / 1e6, 10, 'f', 3)
+               .arg(timing.percentile_ns(0.95) / 1e6, 10, 'f', 3)
+               .arg(timing.percentile_ns(0.99) / 1e6, 10, 'f', 3)
+               .arg(timing.max_ns / 1e6, 10, 'f', 3);
+        QStringList histogram;
+        for(int i = 0; i < timing.buckets.size(); i++){
+            if(timing.buckets[i] > 0) histogram << QString("<%1us:%2").arg(qint64(2) << i).arg(timing.buckets[i]);
+        }
+        out << "    " << histogram.join(" ") << "\n";
+    }
+    out << "\nCounters\n";
+    for(QMap<QString, qint64>::const_iterator it = counts.constBegin(); it != counts.constEnd(); ++it){
+        out << QString("%1 %2\n").arg(it.key(), -36).arg(it.value(), 12);
+    }
+    out << "\nSlow statements (>= " << slow_ns.load() / 1000000 << " ms)\n";
+    for(QMap<QString, SlowStatement>::const_iterator it = slow.constBegin(); it != slow.constEnd(); ++it){
+        const SlowStatement & statement = it.value();
+        out << QString("%1, slowest %2 ms at %3\n")
+               .arg(statement.name)
+               .arg(statement.ns / 1e6, 0, 'f', 3)
+               .arg(statement.when.toString(Qt::ISODate));
+        out << "  " << statement.sql << "\n";
+        foreach(QString step, statement.plan.split("\n")){
+            out << "    " << step << "\n";
+        }
+    }
+    out.flush();
+    return report;
+}
+
+bool Metrics::dump(QString file_name, QString & error) const{
+    QFile file(file_name);
+    if(!file.open(QFile::WriteOnly | QFile::Truncate | QFile::Text)){
+        error = "Error opening " + file_name + " for writing, please try again";
+        return false;
+    }
+    QTextStream out(&file);
+    out << "Diagnostics taken " << QDateTime::currentDateTime().toString(Qt::ISODate) << "\n\n" << report();
+    out.flush();
+    if(out.status() != QTextStream::Ok){
+        error = "Error writing to " + file_name + ", please try again";
+        return false;
+    }
+    return true;
+}
+
+void Metrics::reset(){
+    QMutexLocker locker(&mutex);
+    timings.clear();
+    counts.clear();
+    slow.clear();
+}
+
+ScopedTimer::ScopedTimer(const char * name) :
+    name(name)
+{
+    timer.start();
+}
+
+ScopedTimer::~ScopedTimer(){
+    Metrics::instance().add_time(QLatin1String(name), timer.nsecsElapsed());
+}
+
+qint64 ScopedTimer::elapsed_ms() const{
+    return timer.elapsed();
+}
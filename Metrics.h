@@ -0,0 +1,106 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QAtomicInteger>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QMap>
+#include <QMutex>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QString>
+#include <QVector>
+
+/*
+ * Process-wide timings, counters and latency histograms for the database calls and ledger recomputes,
+ * shown live in the Diagnostics window and dumpable to a file.
+ * Timings are recorded by name from any thread (ScopedTimer, or exec() for a query). A statement slower than
+ * the slow threshold has its EXPLAIN QUERY PLAN captured once, the slowest run of each statement is kept.
+ * Recording is a mutex and a map lookup, cheap next to the sqlite call it measures.
+*/
+class Metrics
+{
+public:
+    static Metrics & instance();
+
+    //adds one sample to the name's timing
+    void add_time(const QString & name, qint64 ns);
+
+    //adds n to the name's counter
+    void add_count(const QString & name, qint64 n = 1);
+
+    //records a statement that ran for ns under name, capturing its query plan if it was slow.
+    //query must have just been exec()'d on db, its bound values are reused for the plan
+    void statement_executed(QSqlDatabase db, const QSqlQuery & query, const QString & name, qint64 ns);
+
+    //exec()'s the prepared query and records it as above
+    static bool exec(QSqlDatabase db, QSqlQuery & query, const QString & name);
+
+    //statements running longer than this get their plan captured, read from the settings (ms)
+    qint64 slow_threshold_ms() const;
+    void set_slow_threshold_ms(qint64 ms);
+
+    //every timing, counter and captured plan as text, sorted by name so two dumps diff cleanly
+    QString report() const;
+
+    //writes report() to file_name, with the time it was taken
+    bool dump(QString file_name, QString & error) const;
+
+    void reset();
+
+private:
+    Metrics();
+
+    //bucket i holds the samples of [2^i, 2^(i+1)) us, bucket 0 also the ones under 1 us
+    static const int HISTOGRAM_BUCKETS = 24;
+
+    struct Timing{
+        Timing() : count(0), total_ns(0), min_ns(0), max_ns(0), buckets(HISTOGRAM_BUCKETS) {}
+        qint64 count;
+        qint64 total_ns;
+        qint64 min_ns;
+        qint64 max_ns;
+        QVector<qint64> buckets;
+        //upper bound of the bucket the p'th percentile falls in, capped at the max
+        qint64 percentile_ns(double p) const;
+    };
+
+    struct SlowStatement{
+        QString name;
+        QString sql;
+        qint64 ns;
+        QString plan;
+        QDateTime when;
+    };
+
+    static int bucket_of(qint64 ns);
+
+    //EXPLAIN QUERY PLAN of the query's statement with its bound values, one step per line
+    static QString explain(QSqlDatabase db, const QSqlQuery & query);
+
+    mutable QMutex mutex;
+    QMap<QString, Timing> timings;
+    QMap<QString, qint64> counts;
+    //by statement text
+    QMap<QString, SlowStatement> slow;
+    QAtomicInteger<qint64> slow_ns;
+};
+
+/*
+ * Times the enclosing scope under name, e.g. { ScopedTimer timer("worker.submit"); ... }
+*/
+class ScopedTimer
+{
+public:
+    explicit ScopedTimer(const char * name);
+    ~ScopedTimer();
+
+    qint64 elapsed_ms() const;
+
+private:
+    Q_DISABLE_COPY(ScopedTimer)
+    const char * name;
+    QElapsedTimer timer;
+};
+
+#endif // METRICS_H
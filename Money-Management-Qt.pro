@@ -4,20 +4,64 @@
 #
 #-------------------------------------------------
 
-QT       += core gui sql
+QT       += core gui sql concurrent
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
 TARGET = Money-Management-Qt
 TEMPLATE = app
 
+#the online backup uses the sqlite C API on the QSQLITE driver's handle when Qt is built w/ -system-sqlite,
+#otherwise the driver's sqlite is detected at run time and backups fall back to VACUUM INTO
+LIBS += -lsqlite3
+
 
 SOURCES += main.cpp\
         mainwindow.cpp \
-    Logger.cpp
+    Logger.cpp \
+    DatabaseManager.cpp \
+    LedgerEngine.cpp \
+    SqlExporter.cpp \
+    SqlImporter.cpp \
+    TransactionPageModel.cpp \
+    BatchIngestor.cpp \
+    Money.cpp \
+    TransactionTableModel.cpp \
+    DatabaseWorker.cpp \
+    LedgerCache.cpp \
+    LedgerReports.cpp \
+    TransactionSearch.cpp \
+    SearchWindow.cpp \
+    DatabaseBackup.cpp \
+    LedgerSnapshot.cpp \
+    SnapshotExporter.cpp \
+    Metrics.cpp \
+    DatabaseMaintenance.cpp \
+    DiagnosticsWindow.cpp \
+    BalanceVerifier.cpp
 
 HEADERS  += mainwindow.h \
-    Logger.h
+    Logger.h \
+    DatabaseManager.h \
+    LedgerEngine.h \
+    SqlExporter.h \
+    SqlImporter.h \
+    TransactionPageModel.h \
+    BatchIngestor.h \
+    Money.h \
+    TransactionTableModel.h \
+    DatabaseWorker.h \
+    LedgerCache.h \
+    LedgerReports.h \
+    TransactionSearch.h \
+    SearchWindow.h \
+    DatabaseBackup.h \
+    LedgerSnapshot.h \
+    SnapshotExporter.h \
+    Metrics.h \
+    DatabaseMaintenance.h \
+    DiagnosticsWindow.h \
+    BalanceVerifier.h
 
 FORMS    += mainwindow.ui
 
@@ -0,0 +1,71 @@
+#include "Money.h"
+#include <QtGlobal>
+
+Money Money::from_cents(qint64 cents){
+    Money money;
+    money.cents = cents;
+    return money;
+}
+
+/*
+ * The digits are read directly so "0.1" is exactly 10 cents, no double is involved.
+ * Anything else (e.g. an exponent) goes through toDouble() and is rounded.
+*/
+Money Money::from_string(QString text, bool * ok){
+    text = text.trimmed();
+    bool negative = false;
+    int pos = 0;
+    if(pos < text.size() && (text[pos] == '-' || text[pos] == '+')){
+        negative = text[pos] == '-';
+        pos++;
+    }
+    qint64 whole = 0;
+    int whole_digits = 0;
+    while(pos < text.size() && text[pos].isDigit() && whole_digits < 16){
+        whole = whole * 10 + text[pos].digitValue();
+        whole_digits++;
+        pos++;
+    }
+    qint64 fraction = 0;
+    int fraction_digits = 0;
+    bool round_up = false;
+    if(pos < text.size() && text[pos] == '.'){
+        pos++;
+        while(pos < text.size() && text[pos].isDigit()){
+            if(fraction_digits < 2){
+                fraction = fraction * 10 + text[pos].digitValue();
+            }else if(fraction_digits == 2){
+                round_up = text[pos].digitValue() >= 5;
+            }
+            fraction_digits++;
+            pos++;
+        }
+    }
+    if(pos == text.size() && whole_digits + fraction_digits > 0){
+        if(fraction_digits == 1) fraction *= 10;
+        qint64 cents = whole * 100 + fraction + (round_up ? 1 : 0);
+        if(ok != 0) *ok = true;
+        return from_cents(negative ? -cents : cents);
+    }
+
+    bool parsed = false;
+    double value = text.toDouble(&parsed);
+    if(ok != 0) *ok = parsed;
+    return parsed ? from_double(value) : Money();
+}
+
+Money Money::from_double(double value){
+    return from_cents(qRound64(value * 100));
+}
+
+QString Money::to_string() const{
+    qint64 magnitude = qAbs(cents);
+    return QString("%1%2.%3")
+            .arg(cents < 0 ? "-" : "")
+            .arg(magnitude / 100)
+            .arg(magnitude % 100, 2, 10, QChar('0'));
+}
+
+QString Money::to_currency(const QLocale & locale) const{
+    return locale.toCurrencyString(to_double());
+}
@@ -0,0 +1,56 @@
+#ifndef MONEY_H
+#define MONEY_H
+
+#include <QLocale>
+#include <QMetaType>
+#include <QString>
+
+/*
+ * An amount of money stored as a whole number of cents.
+ * Used for every amount and balance so sums are exact, the database stores the cents as INTEGER.
+*/
+class Money
+{
+public:
+    Money() : cents(0) {}
+
+    static Money from_cents(qint64 cents);
+
+    //parses a plain decimal such as "12", "12.5" or "-0.07" (no grouping or currency symbol), rounding to
+    //the nearest cent. ok is set to false if the text isn't a number.
+    static Money from_string(QString text, bool * ok = 0);
+
+    //rounds to the nearest cent, only meant for legacy DOUBLE values
+    static Money from_double(double value);
+
+    qint64 to_cents() const { return cents; }
+    double to_double() const { return cents / 100.0; }
+
+    //plain decimal with two places, e.g. "-12.05", locale independent
+    QString to_string() const;
+
+    //formatted for display with the locale's currency symbol
+    QString to_currency(const QLocale & locale = QLocale()) const;
+
+    bool is_negative() const { return cents < 0; }
+    bool is_zero() const { return cents == 0; }
+
+    Money operator-() const { return from_cents(-cents); }
+    Money operator+(const Money & other) const { return from_cents(cents + other.cents); }
+    Money operator-(const Money & other) const { return from_cents(cents - other.cents); }
+    Money & operator+=(const Money & other) { cents += other.cents; return *this; }
+    Money & operator-=(const Money & other) { cents -= other.cents; return *this; }
+    bool operator==(const Money & other) const { return cents == other.cents; }
+    bool operator!=(const Money & other) const { return cents != other.cents; }
+    bool operator<(const Money & other) const { return cents < other.cents; }
+    bool operator<=(const Money & other) const { return cents <= other.cents; }
+    bool operator>(const Money & other) const { return cents > other.cents; }
+    bool operator>=(const Money & other) const { return cents >= other.cents; }
+
+private:
+    qint64 cents;
+};
+
+Q_DECLARE_METATYPE(Money)
+
+#endif // MONEY_H
@@ -0,0 +1,128 @@
+#include "SearchWindow.h"
+#include <QDoubleValidator>
+#include <QGridLayout>
+#include <QHeaderView>
+#include <QIcon>
+
+//# of ms without an edit before the search runs.
+#define SEARCH_DEBOUNCE_MS 250
+
+SearchWindow::SearchWindow(TransactionSearch * searcher, qint64 account, Logger * logger, QWidget *parent) :
+    QWidget(parent),
+    searcher(searcher),
+    logger(logger),
+    request(0),
+    account(account)
+{
+    setWindowIcon(QIcon(":/imgs/money_management.gif"));
+    setWindowTitle("Search Transactions");
+
+    text_edit = new QLineEdit(this);
+    text_edit->setPlaceholderText("Description contains...");
+    from_check = new QCheckBox("From", this);
+    from_edit = new QDateEdit(QDate::currentDate().addMonths(-1), this);
+    from_edit->setCalendarPopup(true);
+    to_check = new QCheckBox("To", this);
+    to_edit = new QDateEdit(QDate::currentDate(), this);
+    to_edit->setCalendarPopup(true);
+    min_amount_edit = new QLineEdit(this);
+    min_amount_edit->setPlaceholderText("Min amount");
+    min_amount_edit->setValidator(new QDoubleValidator(0, 10000000, 2, min_amount_edit));
+    max_amount_edit = new QLineEdit(this);
+    max_amount_edit->setPlaceholderText("Max amount");
+    max_amount_edit->setValidator(new QDoubleValidator(0, 10000000, 2, max_amount_edit));
+    results = new QTableWidget(0, 5, this);
+    results->setHorizontalHeaderLabels(QStringList() << "Description" << "Mode" << "Amount" << "Balance" << "Date Added");
+    results->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    results->setSelectionBehavior(QAbstractItemView::SelectRows);
+    results->verticalHeader()->setVisible(false);
+    results->horizontalHeader()->setStretchLastSection(true);
+    status = new QLabel(this);
+
+    QGridLayout * layout = new QGridLayout(this);
+    layout->addWidget(text_edit, 0, 0, 1, 4);
+    layout->addWidget(from_check, 1, 0);
+    layout->addWidget(from_edit, 1, 1);
+    layout->addWidget(to_check, 1, 2);
+    layout->addWidget(to_edit, 1, 3);
+    layout->addWidget(min_amount_edit, 2, 0, 1, 2);
+    layout->addWidget(max_amount_edit, 2, 2, 1, 2);
+    layout->addWidget(results, 3, 0, 1, 4);
+    layout->addWidget(status, 4, 0, 1, 4);
+
+    debounce.setSingleShot(true);
+    debounce.setInterval(SEARCH_DEBOUNCE_MS);
+    connect(&debounce, SIGNAL(timeout()), this, SLOT(run_search()));
+    connect(text_edit, SIGNAL(textEdited(QString)), this, SLOT(filter_edited()));
+    connect(min_amount_edit, SIGNAL(textEdited(QString)), this, SLOT(filter_edited()));
+    connect(max_amount_edit, SIGNAL(textEdited(QString)), this, SLOT(filter_edited()));
+    connect(from_check, SIGNAL(toggled(bool)), this, SLOT(filter_edited()));
+    connect(to_check, SIGNAL(toggled(bool)), this, SLOT(filter_edited()));
+    connect(from_edit, SIGNAL(dateChanged(QDate)), this, SLOT(filter_edited()));
+    connect(to_edit, SIGNAL(dateChanged(QDate)), this, SLOT(filter_edited()));
+    connect(this, SIGNAL(search_requested(int,SearchFilter)), searcher, SLOT(search(int,SearchFilter)));
+    connect(searcher, SIGNAL(searched(int,bool,SearchHits,bool,qint64)), this, SLOT(show_results(int,bool,SearchHits,bool,qint64)));
+}
+
+void SearchWindow::refresh(){
+    if(!current_filter().is_empty()) run_search();
+}
+
+void SearchWindow::set_account(qint64 account){
+    this->account = account;
+    run_search();
+}
+
+void SearchWindow::filter_edited(){
+    debounce.start();
+}
+
+SearchFilter SearchWindow::current_filter() const{
+    SearchFilter filter;
+    filter.account = account;
+    filter.text = text_edit->text();
+    if(from_check->isChecked()) filter.from = from_edit->date();
+    if(to_check->isChecked()) filter.to = to_edit->date();
+    bool ok = false;
+    filter.min_amount = Money::from_string(min_amount_edit->text(), &ok);
+    filter.use_min_amount = ok && !min_amount_edit->text().isEmpty();
+    filter.max_amount = Money::from_string(max_amount_edit->text(), &ok);
+    filter.use_max_amount = ok && !max_amount_edit->text().isEmpty();
+    return filter;
+}
+
+/*
+ * An empty filter would list the whole ledger, that's what View All Transactions is for.
+*/
+void SearchWindow::run_search(){
+    debounce.stop();
+    SearchFilter filter = current_filter();
+    request++;
+    if(filter.is_empty()){
+        results->setRowCount(0);
+        status->clear();
+        return;
+    }
+    status->setText("Searching...");
+    searcher->supersede(request);
+    emit search_requested(request, filter);
+}
+
+void SearchWindow::show_results(int request, bool success, SearchHits hits, bool truncated, qint64 elapsed_ms){
+    if(request != this->request) return;
+    logger->log(Logger::DEBUG, "search " + QString::number(request) + ": " + QString::number(hits.size()) + " hits in " + QString::number(elapsed_ms) + " ms");
+    if(!success){
+        status->setText("Error searching, please try again");
+        return;
+    }
+    results->setRowCount(hits.size());
+    for(int i = 0; i < hits.size(); i++){
+        results->setItem(i, 0, new QTableWidgetItem(hits[i].description));
+        results->setItem(i, 1, new QTableWidgetItem(hits[i].mode));
+        results->setItem(i, 2, new QTableWidgetItem(hits[i].amount.to_currency(format)));
+        results->setItem(i, 3, new QTableWidgetItem(hits[i].balance.to_currency(format)));
+        results->setItem(i, 4, new QTableWidgetItem(hits[i].date.toString("MM/dd/yyyy")));
+    }
+    status->setText(QString::number(hits.size()) + (truncated ? "+" : "") + " transactions found in " + QString::number(elapsed_ms) + " ms"
+                    + (truncated ? ", refine the search to see the rest" : ""));
+}
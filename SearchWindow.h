@@ -0,0 +1,65 @@
+#ifndef SEARCHWINDOW_H
+#define SEARCHWINDOW_H
+
+#include <QWidget>
+#include <QCheckBox>
+#include <QDateEdit>
+#include <QLabel>
+#include <QLineEdit>
+#include <QTableWidget>
+#include <QTimer>
+#include "Logger.h"
+#include "TransactionSearch.h"
+
+/*
+ * Search Transactions window: description words plus optional date and amount ranges, filtered as the user
+ * types. Edits are debounced and the query runs on the TransactionSearch thread, only the answer to the latest
+ * search is shown.
+*/
+class SearchWindow : public QWidget
+{
+    Q_OBJECT
+public:
+    //searcher must already live on its own thread
+    explicit SearchWindow(TransactionSearch * searcher, qint64 account, Logger * logger, QWidget *parent = 0);
+
+public slots:
+    //runs the current search again, e.g. after the transactions changed
+    void refresh();
+
+    //searches another account from now on
+    void set_account(qint64 account);
+
+signals:
+    void search_requested(int request, SearchFilter filter);
+
+private slots:
+    //restarts the debounce timer
+    void filter_edited();
+
+    void run_search();
+    void show_results(int request, bool success, SearchHits hits, bool truncated, qint64 elapsed_ms);
+
+private:
+    SearchFilter current_filter() const;
+
+    TransactionSearch * searcher;
+    Logger * logger;
+    QTimer debounce;
+    //id of the latest search sent, older answers are dropped
+    int request;
+    qint64 account;
+    QLocale format;
+
+    QLineEdit * text_edit;
+    QCheckBox * from_check;
+    QDateEdit * from_edit;
+    QCheckBox * to_check;
+    QDateEdit * to_edit;
+    QLineEdit * min_amount_edit;
+    QLineEdit * max_amount_edit;
+    QTableWidget * results;
+    QLabel * status;
+};
+
+#endif // SEARCHWINDOW_H
@@ -0,0 +1,104 @@
+#include "SnapshotExporter.h"
+#include "DatabaseManager.h"
+#include "LedgerSnapshot.h"
+#include "Metrics.h"
+#include <QElapsedTimer>
+#include <QSqlError>
+#include <QVariant>
+
+//# of rows between progress updates.
+#define EXPORT_PROGRESS_INTERVAL 5000
+
+SnapshotExporter::SnapshotExporter(Logger * logger, QString db_path, QString file_name, qint64 account, qint64 total_rows, QObject *parent) :
+    QObject(parent),
+    logger(logger),
+    db_path(db_path),
+    file_name(file_name),
+    account(account),
+    total_rows(total_rows)
+{
+}
+
+void SnapshotExporter::cancel(){
+    cancelled.storeRelease(1);
+}
+
+/*
+ * Sets total_rows, false if the count fails or there is nothing to export.
+*/
+bool SnapshotExporter::count_rows(DatabaseManager & db){
+    db.prepared(DatabaseManager::COUNT_TRANSACTIONS).bindValue(":account", account);
+    if(!db.exec(DatabaseManager::COUNT_TRANSACTIONS)) return false;
+    QSqlQuery & count_qry = db.prepared(DatabaseManager::COUNT_TRANSACTIONS);
+    total_rows = count_qry.next() ? count_qry.value(0).toLongLong() : 0;
+    db.release(DatabaseManager::COUNT_TRANSACTIONS);
+    return total_rows > 0;
+}
+
+/*
+ * Runs on the export thread. The rows are gathered into the snapshot's columns, which are written out in one go.
+*/
+void SnapshotExporter::run(){
+    ScopedTimer scope("export.snapshot");
+    QElapsedTimer timer;
+    timer.start();
+    qint64 count = 0;
+    qint64 bytes = 0;
+    bool success = true;
+    QString message;
+    {
+        DatabaseManager db(logger, db_path, "snapshot_export_" + QString::number(quintptr(this)));
+        if(!db.open()){
+            success = false;
+            message = "Error opening the database for export";
+        }else if(total_rows < 0 && !count_rows(db)){
+            success = false;
+            message = total_rows == 0 ? "There are no transactions to export, export cancelled" : "Error counting the transactions to export";
+        }else{
+            LedgerSnapshot snapshot;
+            snapshot.reserve(int(total_rows));
+            db.prepared(DatabaseManager::SELECT_ALL_TRANSACTIONS).bindValue(":account", account);
+            success = db.exec(DatabaseManager::SELECT_ALL_TRANSACTIONS);
+            QSqlQuery & get_all_transactions_qry = db.prepared(DatabaseManager::SELECT_ALL_TRANSACTIONS);
+            logger->log(Logger::DEBUG, "Get all transactions for snapshot qry", get_all_transactions_qry.lastError().text());
+            while(success && get_all_transactions_qry.next()){
+                //columns are id, description, mode, trans_amount, balance, date_added
+                success = snapshot.append(get_all_transactions_qry.value(1).toString(),
+                                          get_all_transactions_qry.value(2).toString(),
+                                          Money::from_cents(get_all_transactions_qry.value(3).toLongLong()),
+                                          Money::from_cents(get_all_transactions_qry.value(4).toLongLong()),
+                                          get_all_transactions_qry.value(5).toDate());
+                if(!success) message = "Transaction " + get_all_transactions_qry.value(0).toString() + " has an unknown mode, export cancelled";
+                count++;
+                if(count % EXPORT_PROGRESS_INTERVAL == 0){
+                    if(total_rows > 0) emit progress(int(qMin<qint64>(99, count * 100 / total_rows)));
+                    if(cancelled.loadAcquire()){
+                        success = false;
+                        message = "Export cancelled";
+                    }
+                }
+            }
+            db.release(DatabaseManager::SELECT_ALL_TRANSACTIONS);
+            if(success) success = snapshot.write(file_name, message);
+            bytes = snapshot.file_size();
+        }
+    }
+
+    double seconds = timer.nsecsElapsed() / 1e9;
+    if(success){
+        message = QString::number(count) + " transactions exported to " + file_name;
+        logger->log(Logger::INFO, QString("%1 transactions (%2 bytes, snapshot) written to %3 in %4 s, %5 rows/s, %6 MB/s")
+                    .arg(count)
+                    .arg(bytes)
+                    .arg(file_name)
+                    .arg(seconds, 0, 'f', 3)
+                    .arg(seconds > 0 ? count / seconds : 0, 0, 'f', 0)
+                    .arg(seconds > 0 ? bytes / seconds / (1024 * 1024) : 0, 0, 'f', 2));
+    }else{
+        if(message.isEmpty()) message = "Error reading the transactions to export, please try again";
+        logger->log(Logger::WARNING, message);
+    }
+    emit progress(100);
+    if(success) Metrics::instance().add_count("transactions.exported", count);
+    emit finished(success, count, message);
+}
@@ -0,0 +1,45 @@
+#ifndef SNAPSHOTEXPORTER_H
+#define SNAPSHOTEXPORTER_H
+
+#include <QObject>
+#include <QAtomicInt>
+#include "Logger.h"
+
+class DatabaseManager;
+
+/*
+ * Writes every transaction of one account to a binary snapshot (see LedgerSnapshot), the compact and fast
+ * counterpart of SqlExporter with the same interface: move it onto its own QThread, it opens its own
+ * connection there, and connect to progress/finished.
+*/
+class SnapshotExporter : public QObject
+{
+    Q_OBJECT
+public:
+    //total_rows is only used for progress, pass -1 to have run() count the rows on the export thread
+    explicit SnapshotExporter(Logger * logger, QString db_path, QString file_name, qint64 account, qint64 total_rows = -1, QObject *parent = 0);
+
+public slots:
+    //does the export, emits finished when done
+    void run();
+
+    //safe to call from any thread, the export stops at the next row
+    void cancel();
+
+signals:
+    //percent of rows read so far
+    void progress(int);
+    void finished(bool success, qint64 rows, QString message);
+
+private:
+    bool count_rows(DatabaseManager & db);
+
+    Logger * logger;
+    QString db_path;
+    QString file_name;
+    qint64 account;
+    qint64 total_rows;
+    QAtomicInt cancelled;
+};
+
+#endif // SNAPSHOTEXPORTER_H
@@ -0,0 +1,160 @@
+#include "SqlExporter.h"
+#include "DatabaseManager.h"
+#include "Metrics.h"
+#include <QElapsedTimer>
+#include <QFile>
+#include <QSqlError>
+#include <QVariant>
+
+//size (bytes) the row buffer may grow to before it is written to the file.
+#define EXPORT_CHUNK_SIZE (1024 * 1024)
+//# of rows between progress updates.
+#define EXPORT_PROGRESS_INTERVAL 5000
+
+SqlExporter::SqlExporter(Logger * logger, QString db_path, QString file_name, qint64 account, qint64 total_rows, QObject *parent) :
+    QObject(parent),
+    logger(logger),
+    db_path(db_path),
+    file_name(file_name),
+    account(account),
+    total_rows(total_rows)
+{
+}
+
+void SqlExporter::cancel(){
+    cancelled.storeRelease(1);
+}
+
+void SqlExporter::append_sql_string(QByteArray & buffer, const QString & value){
+    QByteArray utf8 = value.toUtf8();
+    buffer.append('\'');
+    for(int i = 0; i < utf8.size(); i++){
+        char c = utf8.at(i);
+        if(c == '\''){
+            buffer.append("''");
+        }else if(c == '\n' || c == '\r'){
+            buffer.append("' || char(");
+            buffer.append(QByteArray::number(int(c)));
+            buffer.append(") || '");
+        }else{
+            buffer.append(c);
+        }
+    }
+    buffer.append('\'');
+}
+
+/*
+ * Sets total_rows, false if the count fails or there is nothing to export.
+*/
+bool SqlExporter::count_rows(DatabaseManager & db){
+    db.prepared(DatabaseManager::COUNT_TRANSACTIONS).bindValue(":account", account);
+    if(!db.exec(DatabaseManager::COUNT_TRANSACTIONS)) return false;
+    QSqlQuery & count_qry = db.prepared(DatabaseManager::COUNT_TRANSACTIONS);
+    total_rows = count_qry.next() ? count_qry.value(0).toLongLong() : 0;
+    db.release(DatabaseManager::COUNT_TRANSACTIONS);
+    return total_rows > 0;
+}
+
+/*
+ * Runs on the export thread. The connection is created and removed on this thread.
+*/
+void SqlExporter::run(){
+    ScopedTimer scope("export.sql");
+    QElapsedTimer timer;
+    timer.start();
+    qint64 count = 0;
+    qint64 bytes = 0;
+    bool success = true;
+    QString message;
+    {
+        DatabaseManager db(logger, db_path, "export_" + QString::number(quintptr(this)));
+        QFile export_file(file_name);
+        if(!db.open()){
+            success = false;
+            message = "Error opening the database for export";
+        }else if(total_rows < 0 && !count_rows(db)){
+            success = false;
+            message = total_rows == 0 ? "There are no transactions to export, export cancelled" : "Error counting the transactions to export";
+        }else if(!export_file.open(QFile::WriteOnly | QFile::Unbuffered)){
+            logger->log(Logger::CRITICAL, "Error opening " + file_name + " for export");
+            success = false;
+            message = "Error opening " + file_name + " for export, please try again";
+        }else{
+            QByteArray buffer;
+            buffer.reserve(EXPORT_CHUNK_SIZE + 4096);
+            buffer.append("PRAGMA foreign_keys=OFF;\n");
+            //marks the amounts as cents, files without it are from before the switch and hold dollars
+            buffer.append("PRAGMA user_version=" + QByteArray::number(DatabaseManager::SCHEMA_VERSION) + ";\n");
+            buffer.append("BEGIN TRANSACTION;\n");
+            buffer.append("CREATE TABLE transactions(id INTEGER PRIMARY KEY AUTOINCREMENT, description TEXT, mode TEXT, trans_amount INTEGER, balance INTEGER, date_added DATE);\n");
+
+            db.prepared(DatabaseManager::SELECT_ALL_TRANSACTIONS).bindValue(":account", account);
+            success = db.exec(DatabaseManager::SELECT_ALL_TRANSACTIONS);
+            QSqlQuery & get_all_transactions_qry = db.prepared(DatabaseManager::SELECT_ALL_TRANSACTIONS);
+            logger->log(Logger::DEBUG, "Get all transactions for export qry", get_all_transactions_qry.lastError().text());
+            while(success && get_all_transactions_qry.next()){
+                //columns are id, description, mode, trans_amount, balance, date_added
+                buffer.append("INSERT INTO transactions (id, description, mode, trans_amount, balance, date_added) VALUES (");
+                buffer.append(QByteArray::number(get_all_transactions_qry.value(0).toLongLong()));
+                buffer.append(", ");
+                append_sql_string(buffer, get_all_transactions_qry.value(1).toString());
+                buffer.append(", ");
+                append_sql_string(buffer, get_all_transactions_qry.value(2).toString());
+                buffer.append(", ");
+                buffer.append(QByteArray::number(get_all_transactions_qry.value(3).toLongLong()));
+                buffer.append(", ");
+                buffer.append(QByteArray::number(get_all_transactions_qry.value(4).toLongLong()));
+                buffer.append(", ");
+                //undated transactions stay NULL, '' isn't NULL to the ledger's date_added IS NULL checks
+                if(get_all_transactions_qry.value(5).isNull()){
+                    buffer.append("NULL");
+                }else{
+                    append_sql_string(buffer, get_all_transactions_qry.value(5).toString());
+                }
+                buffer.append(");\n");
+                count++;
+
+                if(buffer.size() >= EXPORT_CHUNK_SIZE){
+                    success = export_file.write(buffer) == buffer.size();
+                    bytes += buffer.size();
+                    buffer.resize(0);
+                }
+                if(count % EXPORT_PROGRESS_INTERVAL == 0){
+                    if(total_rows > 0) emit progress(int(qMin<qint64>(100, count * 100 / total_rows)));
+                    if(cancelled.loadAcquire()){
+                        success = false;
+                        message = "Export cancelled";
+                    }
+                }
+            }
+            db.release(DatabaseManager::SELECT_ALL_TRANSACTIONS);
+            if(success){
+                buffer.append("COMMIT;");
+                success = export_file.write(buffer) == buffer.size();
+                bytes += buffer.size();
+            }
+            export_file.close();
+            if(!success){
+                if(message.isEmpty()) message = "Error writing to " + file_name + ", please try again";
+                export_file.remove();
+            }
+        }
+    }
+
+    double seconds = timer.nsecsElapsed() / 1e9;
+    if(success){
+        message = QString::number(count) + " transactions exported to " + file_name;
+        logger->log(Logger::INFO, QString("%1 transactions (%2 bytes) written to %3 in %4 s, %5 rows/s, %6 MB/s")
+                    .arg(count)
+                    .arg(bytes)
+                    .arg(file_name)
+                    .arg(seconds, 0, 'f', 3)
+                    .arg(seconds > 0 ? count / seconds : 0, 0, 'f', 0)
+                    .arg(seconds > 0 ? bytes / seconds / (1024 * 1024) : 0, 0, 'f', 2));
+    }else{
+        logger->log(Logger::WARNING, message);
+    }
+    emit progress(100);
+    if(success) Metrics::instance().add_count("transactions.exported", count);
+    emit finished(success, count, message);
+}
@@ -0,0 +1,50 @@
+#ifndef SQLEXPORTER_H
+#define SQLEXPORTER_H
+
+#include <QObject>
+#include <QAtomicInt>
+#include <QByteArray>
+#include "Logger.h"
+
+class DatabaseManager;
+
+/*
+ * Streams every transaction of one account into a .sql file that the import action can replay (into any account).
+ * Meant to be moved onto its own QThread, it opens its own connection there, reads with a forward-only
+ * query and formats rows into a reusable buffer that is written out in large chunks.
+*/
+class SqlExporter : public QObject
+{
+    Q_OBJECT
+public:
+    //total_rows is only used for progress, pass -1 to have run() count the rows on the export thread
+    explicit SqlExporter(Logger * logger, QString db_path, QString file_name, qint64 account, qint64 total_rows = -1, QObject *parent = 0);
+
+    //appends value as a single quoted sql string literal, quotes are doubled and line breaks are written
+    //as char() so every statement stays on one line
+    static void append_sql_string(QByteArray & buffer, const QString & value);
+
+public slots:
+    //does the export, emits finished when done
+    void run();
+
+    //safe to call from any thread, the export stops at the next row
+    void cancel();
+
+signals:
+    //percent of rows written so far
+    void progress(int);
+    void finished(bool success, qint64 rows, QString message);
+
+private:
+    bool count_rows(DatabaseManager & db);
+
+    Logger * logger;
+    QString db_path;
+    QString file_name;
+    qint64 account;
+    qint64 total_rows;
+    QAtomicInt cancelled;
+};
+
+#endif // SQLEXPORTER_H
@@ -0,0 +1,441 @@
+#include "SqlImporter.h"
+#include "DatabaseManager.h"
+#include "LedgerSnapshot.h"
+#include "Metrics.h"
+#include <QElapsedTimer>
+#include <QFile>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QTextStream>
+#include <QVariant>
+#include <cstring>
+
+//# of rows inserted per committed transaction.
+#define IMPORT_BATCH_SIZE 10000
+
+static const char INSERT_PREFIX[] = "INSERT INTO transactions (id, description, mode, trans_amount, balance, date_added) VALUES (";
+
+namespace {
+
+void skip_spaces(const char *& p, const char * end){
+    while(p < end && *p == ' ') p++;
+}
+
+bool read_number(const char *& p, const char * end, QByteArray & token){
+    skip_spaces(p, end);
+    const char * start = p;
+    while(p < end && *p != ',' && *p != ' ' && *p != ')') p++;
+    if(p == start) return false;
+    token = QByteArray::fromRawData(start, int(p - start));
+    return true;
+}
+
+bool read_integer(const char *& p, const char * end, qint64 & value){
+    QByteArray token;
+    bool ok = false;
+    if(read_number(p, end, token)) value = token.toLongLong(&ok);
+    return ok;
+}
+
+bool read_money(const char *& p, const char * end, bool in_cents, Money & value){
+    QByteArray token;
+    bool ok = false;
+    if(!read_number(p, end, token)) return false;
+    if(in_cents){
+        value = Money::from_cents(token.toLongLong(&ok));
+    }else{
+        value = Money::from_string(QString::fromLatin1(token), &ok);
+    }
+    return ok;
+}
+
+/*
+ * Reads a string literal, including the 'a' || char(10) || 'b' concatenations the exporter uses for line breaks.
+*/
+bool read_string(const char *& p, const char * end, QString & value){
+    QByteArray bytes;
+    forever{
+        skip_spaces(p, end);
+        if(p < end && *p == '\''){
+            p++;
+            forever{
+                if(p >= end) return false;
+                if(*p == '\''){
+                    if(p + 1 < end && p[1] == '\''){
+                        bytes.append('\'');
+                        p += 2;
+                        continue;
+                    }
+                    p++;
+                    break;
+                }
+                bytes.append(*p++);
+            }
+        }else if(end - p >= 5 && std::strncmp(p, "char(", 5) == 0){
+            p += 5;
+            qint64 code;
+            if(!read_integer(p, end, code) || p >= end || *p != ')') return false;
+            p++;
+            bytes.append(char(code));
+        }else{
+            return false;
+        }
+        skip_spaces(p, end);
+        if(end - p >= 2 && p[0] == '|' && p[1] == '|'){
+            p += 2;
+            continue;
+        }
+        break;
+    }
+    value = QString::fromUtf8(bytes);
+    return true;
+}
+
+/*
+ * A bare NULL (an undated transaction) reads as a null QString, which binds as NULL.
+*/
+bool read_nullable_string(const char *& p, const char * end, QString & value){
+    skip_spaces(p, end);
+    if(end - p >= 4 && std::strncmp(p, "NULL", 4) == 0){
+        p += 4;
+        value = QString();
+        return true;
+    }
+    return read_string(p, end, value);
+}
+
+bool read_comma(const char *& p, const char * end){
+    skip_spaces(p, end);
+    if(p >= end || *p != ',') return false;
+    p++;
+    return true;
+}
+
+}
+
+SqlImporter::SqlImporter(Logger * logger, QSqlDatabase db, qint64 account, QObject *parent) :
+    QObject(parent),
+    logger(logger),
+    db(db),
+    account(account),
+    rows(0),
+    rebalanced(0)
+{
+}
+
+qint64 SqlImporter::rows_imported() const{
+    return rows;
+}
+
+QString SqlImporter::error() const{
+    return error_text;
+}
+
+qint64 SqlImporter::rows_rebalanced() const{
+    return rebalanced;
+}
+
+bool SqlImporter::parse_insert(const QByteArray & line, Row & row, bool in_cents){
+    if(!line.startsWith(INSERT_PREFIX)) return false;
+    const char * p = line.constData() + sizeof(INSERT_PREFIX) - 1;
+    const char * end = line.constData() + line.size();
+    while(end > p && (end[-1] == '\n' || end[-1] == '\r' || end[-1] == ' ')) end--;
+    if(end - p < 2 || end[-1] != ';' || end[-2] != ')') return false;
+    end -= 2;
+    return read_integer(p, end, row.id) && read_comma(p, end)
+            && read_string(p, end, row.description) && read_comma(p, end)
+            && read_string(p, end, row.mode) && read_comma(p, end)
+            && read_money(p, end, in_cents, row.trans_amount) && read_comma(p, end)
+            && read_money(p, end, in_cents, row.balance) && read_comma(p, end)
+            && read_nullable_string(p, end, row.date_added)
+            && (skip_spaces(p, end), p == end);
+}
+
+bool SqlImporter::is_envelope(const QByteArray & line){
+    QByteArray trimmed = line.trimmed();
+    return trimmed.isEmpty()
+            || trimmed == "PRAGMA foreign_keys=OFF;"
+            || trimmed == "BEGIN TRANSACTION;"
+            || trimmed == "COMMIT;"
+            || trimmed.startsWith("CREATE TABLE transactions(");
+}
+
+int SqlImporter::format_version(const QByteArray & line){
+    static const char VERSION_PREFIX[] = "PRAGMA user_version=";
+    QByteArray trimmed = line.trimmed();
+    if(!trimmed.startsWith(VERSION_PREFIX) || !trimmed.endsWith(';')) return -1;
+    bool ok = false;
+    int version = trimmed.mid(sizeof(VERSION_PREFIX) - 1, trimmed.size() - int(sizeof(VERSION_PREFIX))).toInt(&ok);
+    return ok ? version : -1;
+}
+
+bool SqlImporter::create_staging(){
+    QSqlQuery staging_qry = db.exec("DROP TABLE IF EXISTS transactions_import;");
+    staging_qry = db.exec("CREATE TABLE transactions_import(id INTEGER PRIMARY KEY AUTOINCREMENT, description TEXT, mode TEXT, trans_amount INTEGER, balance INTEGER, date_added DATE);");
+    logger->log(Logger::DEBUG, "create import staging table qry", staging_qry.lastError().text());
+    if(staging_qry.lastError().isValid()){
+        error_text = "Error preparing the import: " + staging_qry.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+void SqlImporter::discard_staging(bool in_transaction){
+    if(in_transaction) db.rollback();
+    QSqlQuery drop_staging_qry = db.exec("DROP TABLE IF EXISTS transactions_import;");
+    logger->log(Logger::DEBUG, "drop import staging table qry", drop_staging_qry.lastError().text());
+}
+
+/*
+ * The account's rows are deleted and the staging rows inserted with the account's id, all or nothing.
+ * They are inserted in ledger order so the new ids keep same-day rows in the order their balances run.
+ * Only rows of this account are touched. The account_balances triggers would do per row work on both sides, so
+ * they are dropped: the account's total is set once at the end (ensure_schema() puts the triggers back).
+*/
+bool SqlImporter::swap_in(bool id_order){
+    bool in_swap = db.transaction();
+    bool swapped = in_swap;
+    QSqlQuery swap_qry(db);
+    swapped = swapped && swap_qry.exec("DROP TRIGGER IF EXISTS account_balances_insert;");
+    swapped = swapped && swap_qry.exec("DROP TRIGGER IF EXISTS account_balances_delete;");
+    swapped = swapped && swap_qry.prepare("DELETE FROM transactions WHERE account_id = :account;");
+    swap_qry.bindValue(":account", account);
+    swapped = swapped && swap_qry.exec();
+    swapped = swapped && swap_qry.prepare("INSERT INTO transactions (description, mode, trans_amount, balance, date_added, account_id) "
+                                          "SELECT description, mode, trans_amount, balance, date_added, :account FROM transactions_import ORDER BY date_added, id;");
+    swap_qry.bindValue(":account", account);
+    swapped = swapped && swap_qry.exec();
+    if(swapped && id_order){
+        rebalanced = DatabaseManager::rebalance_ledgers(db, logger, account);
+        swapped = rebalanced >= 0;
+    }
+    swapped = swapped && swap_qry.prepare("INSERT OR REPLACE INTO account_balances (account_id, last_id, balance) SELECT accounts.id, "
+                                          "COALESCE((SELECT id FROM transactions WHERE account_id = accounts.id ORDER BY date_added DESC, id DESC LIMIT 1), 0), "
+                                          "COALESCE((SELECT balance FROM transactions WHERE account_id = accounts.id ORDER BY date_added DESC, id DESC LIMIT 1), 0) "
+                                          "FROM accounts WHERE accounts.id = :account;");
+    swap_qry.bindValue(":account", account);
+    swapped = swapped && swap_qry.exec();
+    swapped = swapped && swap_qry.exec("DROP TABLE transactions_import;");
+    swapped = swapped && db.commit();
+    if(!swapped){
+        error_text = "Error replacing the existing transactions: " + swap_qry.lastError().text();
+        logger->log(Logger::CRITICAL, "Import swap failed, rolling back", swap_qry.lastError().text());
+        discard_staging(in_swap);
+    }
+    return swapped;
+}
+
+/*
+ * Loads the file into transactions_import in batches, then swaps it in for the account's rows.
+*/
+SqlImporter::Result SqlImporter::import_file(QString file_name){
+    ScopedTimer scope("import.sql");
+    QElapsedTimer timer;
+    timer.start();
+    rows = rebalanced = 0;
+    error_text.clear();
+
+    QFile import_file(file_name);
+    if(!import_file.open(QFile::ReadOnly)){
+        logger->log(Logger::CRITICAL, "Error opening " + file_name + " for import");
+        error_text = "Error opening " + file_name + " for import, please try again";
+        return FAILED;
+    }
+
+    if(!create_staging()) return FAILED;
+
+    QSqlQuery insert_qry(db);
+    insert_qry.prepare("INSERT INTO transactions_import (id, description, mode, trans_amount, balance, date_added) VALUES (?, ?, ?, ?, ?, ?);");
+    Row row;
+    qint64 line_number = 0;
+    bool in_batch = false;
+    int version = 0;
+    while(!import_file.atEnd()){
+        QByteArray line = import_file.readLine();
+        line_number++;
+        if(!parse_insert(line, row, version >= 1)){
+            int line_version = format_version(line);
+            if(line_version >= 0){
+                version = line_version;
+                continue;
+            }
+            if(is_envelope(line)) continue;
+            logger->log(Logger::INFO, "Line " + QString::number(line_number) + " is not an exported row, falling back to statement replay");
+            discard_staging(in_batch);
+            return UNRECOGNIZED;
+        }
+        if(!in_batch){
+            in_batch = db.transaction();
+        }
+        insert_qry.bindValue(0, row.id);
+        insert_qry.bindValue(1, row.description);
+        insert_qry.bindValue(2, row.mode);
+        insert_qry.bindValue(3, row.trans_amount.to_cents());
+        insert_qry.bindValue(4, row.balance.to_cents());
+        insert_qry.bindValue(5, row.date_added.isNull() ? QVariant(QVariant::String) : QVariant(row.date_added));
+        if(!insert_qry.exec()){
+            error_text = "Error on line " + QString::number(line_number) + ": " + insert_qry.lastError().text();
+            logger->log(Logger::CRITICAL, "Import failed on line " + QString::number(line_number) + ", rolling back", insert_qry.lastError().text());
+            discard_staging(in_batch);
+            return FAILED;
+        }
+        rows++;
+        if(rows % IMPORT_BATCH_SIZE == 0 && in_batch){
+            if(!db.commit()){
+                error_text = "Error committing imported rows: " + db.lastError().text();
+                discard_staging(true);
+                return FAILED;
+            }
+            in_batch = false;
+        }
+    }
+    if(in_batch && !db.commit()){
+        error_text = "Error committing imported rows: " + db.lastError().text();
+        discard_staging(true);
+        return FAILED;
+    }
+    insert_qry.finish();
+
+    if(!swap_in(version < 3)) return FAILED;
+
+    double seconds = timer.nsecsElapsed() / 1e9;
+    logger->log(Logger::INFO, QString("Imported %1 transactions from %2 in %3 s, %4 rows/s, %5 MB/s")
+                .arg(rows)
+                .arg(file_name)
+                .arg(seconds, 0, 'f', 3)
+                .arg(seconds > 0 ? rows / seconds : 0, 0, 'f', 0)
+                .arg(seconds > 0 ? import_file.size() / seconds / (1024 * 1024) : 0, 0, 'f', 2));
+    return IMPORTED;
+}
+
+/*
+ * The snapshot is memory mapped and checked as a whole first, so a damaged file fails before anything is
+ * written. The columns are then bound straight from the mapping into the staging table in one transaction.
+*/
+SqlImporter::Result SqlImporter::import_snapshot(QString file_name){
+    ScopedTimer scope("import.snapshot");
+    QElapsedTimer timer;
+    timer.start();
+    rows = rebalanced = 0;
+    error_text.clear();
+
+    LedgerSnapshot snapshot;
+    if(!snapshot.map(file_name, error_text)){
+        logger->log(Logger::CRITICAL, "Snapshot import failed", error_text);
+        return FAILED;
+    }
+    if(!create_staging()) return FAILED;
+
+    bool in_batch = db.transaction();
+    QSqlQuery insert_qry(db);
+    bool loaded = in_batch && insert_qry.prepare("INSERT INTO transactions_import (description, mode, trans_amount, balance, date_added) VALUES (?, ?, ?, ?, ?);");
+    for(int i = 0; loaded && i < snapshot.size(); i++){
+        insert_qry.bindValue(0, snapshot.description_at(i));
+        insert_qry.bindValue(1, snapshot.mode_at(i));
+        insert_qry.bindValue(2, snapshot.amount_at(i).to_cents());
+        insert_qry.bindValue(3, snapshot.balance_at(i).to_cents());
+        insert_qry.bindValue(4, snapshot.date_at(i));
+        loaded = insert_qry.exec();
+        if(loaded) rows++;
+    }
+    insert_qry.finish();
+    if(!loaded || !db.commit()){
+        error_text = "Error loading snapshot row " + QString::number(rows + 1) + ": " + (insert_qry.lastError().isValid() ? insert_qry.lastError().text() : db.lastError().text());
+        logger->log(Logger::CRITICAL, "Snapshot import failed, rolling back", error_text);
+        discard_staging(in_batch);
+        return FAILED;
+    }
+
+    if(!swap_in(snapshot.format_version() < 2)) return FAILED;
+
+    double seconds = timer.nsecsElapsed() / 1e9;
+    logger->log(Logger::INFO, QString("Imported %1 transactions from snapshot %2 in %3 s, %4 rows/s")
+                .arg(rows)
+                .arg(file_name)
+                .arg(seconds, 0, 'f', 3)
+                .arg(seconds > 0 ? rows / seconds : 0, 0, 'f', 0));
+    return IMPORTED;
+}
+
+/*
+ * The file runs as is against a private in-memory database, so its DROP/CREATE TABLE statements can't reach
+ * the real tables. Its transactions table is then copied to the staging table and swapped in like the fast path.
+ * Any failing statement fails the import, nothing is changed.
+*/
+SqlImporter::Result SqlImporter::replay_file(QString file_name){
+    ScopedTimer scope("import.replay");
+    QElapsedTimer timer;
+    timer.start();
+    rows = rebalanced = 0;
+    error_text.clear();
+
+    QFile import_file(file_name);
+    if(!import_file.open(QFile::ReadOnly)){
+        logger->log(Logger::CRITICAL, "Error opening " + file_name + " for import");
+        error_text = "Error opening " + file_name + " for import, please try again";
+        return FAILED;
+    }
+    if(!create_staging()) return FAILED;
+
+    QString scratch_name = "import_replay_" + QString::number(quintptr(this));
+    bool loaded = false;
+    int version = 0;
+    {
+        QSqlDatabase scratch = QSqlDatabase::addDatabase("QSQLITE", scratch_name);
+        scratch.setDatabaseName(":memory:");
+        int errors = 0;
+        if(scratch.open()){
+            QTextStream in(&import_file);
+            while(!in.atEnd()){
+                QString statement = in.readLine();
+                if(statement.trimmed().isEmpty()) continue;
+                QSqlQuery qry = scratch.exec(statement);
+                if(qry.lastError().isValid()){
+                    errors++;
+                    logger->log(Logger::CRITICAL, "Error on statement " + statement, qry.lastError().text());
+                }
+            }
+        }else{
+            errors++;
+        }
+        import_file.close();
+
+        //files without a version line hold dollar amounts
+        QSqlQuery version_qry = scratch.exec("PRAGMA user_version;");
+        version = version_qry.next() ? version_qry.value(0).toInt() : 0;
+        bool in_cents = version >= 1;
+        version_qry.finish();
+
+        QSqlQuery rows_qry(scratch);
+        rows_qry.setForwardOnly(true);
+        bool in_batch = false;
+        if(errors == 0 && rows_qry.exec("SELECT id, description, mode, trans_amount, balance, date_added FROM transactions ORDER BY id;")){
+            in_batch = db.transaction();
+            QSqlQuery insert_qry(db);
+            loaded = in_batch && insert_qry.prepare("INSERT INTO transactions_import (id, description, mode, trans_amount, balance, date_added) VALUES (?, ?, ?, ?, ?, ?);");
+            while(loaded && rows_qry.next()){
+                insert_qry.bindValue(0, rows_qry.value(0));
+                insert_qry.bindValue(1, rows_qry.value(1));
+                insert_qry.bindValue(2, rows_qry.value(2));
+                insert_qry.bindValue(3, in_cents ? rows_qry.value(3).toLongLong() : Money::from_double(rows_qry.value(3).toDouble()).to_cents());
+                insert_qry.bindValue(4, in_cents ? rows_qry.value(4).toLongLong() : Money::from_double(rows_qry.value(4).toDouble()).to_cents());
+                insert_qry.bindValue(5, rows_qry.value(5));
+                loaded = insert_qry.exec();
+                if(loaded) rows++;
+            }
+            loaded = loaded && db.commit();
+            in_batch = in_batch && !loaded;
+        }
+        rows_qry.finish();
+        if(!loaded){
+            error_text = errors > 0 ? "Encountered " + QString::number(errors) + " error(s) replaying " + file_name
+                                    : "Error reading the transactions of " + file_name;
+            discard_staging(in_batch);
+        }
+        scratch.close();
+    }
+    QSqlDatabase::removeDatabase(scratch_name);
+    if(!loaded || !swap_in(version < 3)) return FAILED;
+    logger->log(Logger::INFO, QString("Replayed %1 transactions from %2 in %3 ms").arg(rows).arg(file_name).arg(timer.elapsed()));
+    return IMPORTED;
+}
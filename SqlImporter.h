@@ -0,0 +1,90 @@
+#ifndef SQLIMPORTER_H
+#define SQLIMPORTER_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QSqlDatabase>
+#include "Logger.h"
+#include "Money.h"
+
+/*
+ * Imports a .sql file into one account, replacing that account's transactions and no other account's.
+ * Files written by SqlExporter take the fast path: INSERT rows are parsed into typed values and loaded through
+ * one reused prepared statement into a staging table, committing in batches. Other files are replayed statement
+ * by statement into a scratch in-memory database and copied to the staging table from there.
+ * The staging table only replaces the account's rows once every row has loaded, so a failure at any point leaves
+ * the existing data untouched. The rows get new ids (ids are shared by every account), in the file's order.
+ * Files with a PRAGMA user_version line hold amounts as cents, older files hold dollars and are rounded to cents.
+ * Files older than schema version 3 chained their balances in id order, their balances are recomputed in ledger
+ * order in the swap transaction, the way the schema migration does it.
+ * Binary snapshots (LedgerSnapshot) are memory mapped and bulk loaded into the staging table the same way.
+ * The swap drops the account_balances triggers, call DatabaseManager::ensure_schema() after a successful import.
+*/
+class SqlImporter : public QObject
+{
+    Q_OBJECT
+public:
+    enum Result{
+        IMPORTED,
+        FAILED,
+        //the file contains statements the fast path doesn't understand, nothing was changed
+        UNRECOGNIZED
+    };
+
+    //one transaction row as written by the exporter
+    struct Row{
+        qint64 id;
+        QString description;
+        QString mode;
+        Money trans_amount;
+        Money balance;
+        //null for an undated transaction
+        QString date_added;
+    };
+
+    explicit SqlImporter(Logger * logger, QSqlDatabase db, qint64 account, QObject *parent = 0);
+
+    //the fast path, UNRECOGNIZED if the file wasn't written by the exporter
+    Result import_file(QString file_name);
+
+    //the slow path for any other .sql file that creates and fills a transactions table, never UNRECOGNIZED
+    Result replay_file(QString file_name);
+
+    //loads a binary snapshot written by SnapshotExporter, never UNRECOGNIZED
+    Result import_snapshot(QString file_name);
+
+    qint64 rows_imported() const;
+    QString error() const;
+
+    //# of balances recomputed because the file chained them in id order
+    qint64 rows_rebalanced() const;
+
+    //parses one exporter INSERT line, returns false if the line isn't one.
+    //in_cents is true for files with a version line, false for older files with dollar amounts.
+    static bool parse_insert(const QByteArray & line, Row & row, bool in_cents = true);
+
+    //true for the header/footer lines the exporter writes around the rows
+    static bool is_envelope(const QByteArray & line);
+
+    //the version in a "PRAGMA user_version=N;" line, -1 for any other line
+    static int format_version(const QByteArray & line);
+
+private:
+    bool create_staging();
+
+    //rolls back the open batch (if any) and drops the staging table after a failure
+    void discard_staging(bool in_transaction);
+
+    //replaces the account's rows with the staging table's in one transaction.
+    //id_order recomputes the balances in ledger order before committing
+    bool swap_in(bool id_order);
+
+    Logger * logger;
+    QSqlDatabase db;
+    qint64 account;
+    qint64 rows;
+    qint64 rebalanced;
+    QString error_text;
+};
+
+#endif // SQLIMPORTER_H
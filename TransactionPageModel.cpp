@@ -0,0 +1,188 @@
+#include "TransactionPageModel.h"
+#include "DatabaseManager.h"
+#include "Money.h"
+#include <QSqlError>
+#include <QElapsedTimer>
+
+//# of rows fetched per page.
+#define PAGE_SIZE 256
+//max # of pages kept in memory.
+#define PAGE_CACHE_SIZE 64
+
+TransactionPageModel::TransactionPageModel(QSqlDatabase db, qint64 account, Logger * logger, QObject *parent) :
+    QAbstractTableModel(parent),
+    db(db),
+    account(account),
+    logger(logger),
+    row_count(0)
+{
+    for(int dated = 0; dated < 2; dated++){
+        QString after = DatabaseManager::rows_after(":after", dated ? QDate::currentDate() : QDate());
+        page_qrys[dated] = QSqlQuery(db);
+        page_qrys[dated].setForwardOnly(true);
+        page_qrys[dated].prepare("SELECT id, description, mode, trans_amount, balance, date_added FROM transactions WHERE account_id = :account AND " + after + " ORDER BY date_added, id LIMIT " + QString::number(PAGE_SIZE) + ";");
+        boundary_qrys[dated] = QSqlQuery(db);
+        boundary_qrys[dated].setForwardOnly(true);
+        boundary_qrys[dated].prepare("SELECT id, date_added FROM transactions WHERE account_id = :account AND " + after + " ORDER BY date_added, id LIMIT 1 OFFSET :skip;");
+    }
+    pages.setMaxCost(PAGE_CACHE_SIZE);
+    refresh();
+}
+
+/*
+ * The account is bound once here, the (account_id, date_added, id) index keeps every page lookup a seek.
+ * The first page starts after (no date, id -1), i.e. before every row.
+*/
+void TransactionPageModel::refresh(){
+    beginResetModel();
+    pages.clear();
+    page_after.clear();
+    Key start = {QDate(), -1};
+    page_after.insert(0, start);
+    for(int dated = 0; dated < 2; dated++){
+        page_qrys[dated].bindValue(":account", account);
+        boundary_qrys[dated].bindValue(":account", account);
+    }
+    QSqlQuery count_qry(db);
+    count_qry.prepare("SELECT count(id) FROM transactions WHERE account_id = :account;");
+    count_qry.bindValue(":account", account);
+    row_count = count_qry.exec() && count_qry.next() ? count_qry.value(0).toInt() : 0;
+    logger->log(Logger::DEBUG, "View all transactions row count: " + QString::number(row_count));
+    endResetModel();
+}
+
+void TransactionPageModel::set_account(qint64 account){
+    this->account = account;
+    refresh();
+}
+
+int TransactionPageModel::rowCount(const QModelIndex & parent) const{
+    return parent.isValid() ? 0 : row_count;
+}
+
+int TransactionPageModel::columnCount(const QModelIndex & parent) const{
+    return parent.isValid() ? 0 : COLUMN_COUNT;
+}
+
+QVariant TransactionPageModel::data(const QModelIndex & index, int role) const{
+    if(!index.isValid() || role != Qt::DisplayRole) return QVariant();
+    Page * rows = page(index.row() / PAGE_SIZE);
+    if(rows == NULL) return QVariant();
+    int offset = (index.row() % PAGE_SIZE) * COLUMN_COUNT + index.column();
+    return offset < rows->values.size() ? rows->values.at(offset) : QVariant();
+}
+
+QVariant TransactionPageModel::headerData(int section, Qt::Orientation orientation, int role) const{
+    if(role != Qt::DisplayRole) return QVariant();
+    if(orientation == Qt::Vertical) return section + 1;
+    switch(section){
+    case DESCRIPTION:
+        return tr("Description");
+    case MODE:
+        return tr("Mode");
+    case TRANSACTION_AMOUNT:
+        return tr("Transaction Amount");
+    case BALANCE:
+        return tr("Resulting Balance");
+    case DATE_ADDED:
+        return tr("Date Added");
+    }
+    return QVariant();
+}
+
+/*
+ * Finds the key page_number starts after. Known boundaries are reused, otherwise the ledger index is walked
+ * forward from the closest known boundary before it (the OFFSET only touches the index, never the rows).
+*/
+bool TransactionPageModel::page_boundary(int page_number, Key & after) const{
+    QMap<int, Key>::const_iterator it = page_after.constFind(page_number);
+    if(it != page_after.constEnd()){
+        after = it.value();
+        return true;
+    }
+    it = page_after.lowerBound(page_number);
+    --it;
+    QSqlQuery & boundary_qry = boundary_qrys[it.value().date.isValid() ? 1 : 0];
+    DatabaseManager::bind_position(boundary_qry, ":after", it.value().date, it.value().id);
+    boundary_qry.bindValue(":skip", (page_number - it.key()) * PAGE_SIZE - 1);
+    bool result = boundary_qry.exec() && boundary_qry.next();
+    if(result){
+        after.id = boundary_qry.value(0).toLongLong();
+        after.date = boundary_qry.value(1).toDate();
+        page_after.insert(page_number, after);
+    }else{
+        logger->log(Logger::WARNING, "Finding start of page " + QString::number(page_number), boundary_qry.lastError().text());
+    }
+    boundary_qry.finish();
+    return result;
+}
+
+TransactionPageModel::Page * TransactionPageModel::page(int page_number) const{
+    Page * cached = pages.object(page_number);
+    if(cached != NULL) return cached;
+
+    Key after;
+    if(!page_boundary(page_number, after)) return NULL;
+
+    QElapsedTimer timer;
+    timer.start();
+    QSqlQuery & page_qry = page_qrys[after.date.isValid() ? 1 : 0];
+    DatabaseManager::bind_position(page_qry, ":after", after.date, after.id);
+    if(!page_qry.exec()){
+        logger->log(Logger::CRITICAL, "Fetching page " + QString::number(page_number), page_qry.lastError().text());
+        return NULL;
+    }
+    Page * fetched = new Page;
+    fetched->values.reserve(PAGE_SIZE * COLUMN_COUNT);
+    fetched->last = after;
+    while(page_qry.next()){
+        fetched->last.id = page_qry.value(0).toLongLong();
+        fetched->last.date = page_qry.value(5).toDate();
+        for(int column = 0; column < COLUMN_COUNT; column++){
+            fetched->values.append(display_value(column, page_qry.value(column + 1)));
+        }
+    }
+    page_qry.finish();
+    if(fetched->values.size() == PAGE_SIZE * COLUMN_COUNT) page_after.insert(page_number + 1, fetched->last);
+    if(logger->is_enabled(Logger::DEBUG)){
+        logger->log(Logger::DEBUG, QString("Fetched page %1 (%2 rows) in %3 ms").arg(page_number).arg(fetched->values.size() / COLUMN_COUNT).arg(timer.elapsed()));
+    }
+    pages.insert(page_number, fetched);
+    return fetched;
+}
+
+QVariant TransactionPageModel::display_value(int column, const QVariant & value){
+    if(column != TRANSACTION_AMOUNT && column != BALANCE) return value;
+    return Money::from_cents(value.toLongLong()).to_string();
+}
+
+/*
+ * Picks ids evenly spaced between the smallest and largest id and looks each one up through the primary key.
+*/
+QVector<QStringList> TransactionPageModel::sample(int count) const{
+    QVector<QStringList> rows;
+    QSqlQuery range_qry(db);
+    range_qry.prepare("SELECT min(id), max(id) FROM transactions WHERE account_id = :account;");
+    range_qry.bindValue(":account", account);
+    if(!range_qry.exec() || !range_qry.next() || range_qry.value(0).isNull()) return rows;
+    qint64 min_id = range_qry.value(0).toLongLong();
+    qint64 max_id = range_qry.value(1).toLongLong();
+    range_qry.finish();
+
+    QSqlQuery sample_qry(db);
+    sample_qry.setForwardOnly(true);
+    sample_qry.prepare("SELECT description, mode, trans_amount, balance, date_added FROM transactions WHERE account_id = :account AND id >= :id ORDER BY id LIMIT 1;");
+    sample_qry.bindValue(":account", account);
+    qint64 step = qMax<qint64>(1, (max_id - min_id) / qMax(1, count));
+    for(qint64 id = min_id; id <= max_id && rows.size() < count; id += step){
+        sample_qry.bindValue(":id", id);
+        if(!sample_qry.exec() || !sample_qry.next()) continue;
+        QStringList row;
+        for(int column = 0; column < COLUMN_COUNT; column++){
+            row.append(display_value(column, sample_qry.value(column)).toString());
+        }
+        rows.append(row);
+        sample_qry.finish();
+    }
+    return rows;
+}
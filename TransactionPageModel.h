@@ -0,0 +1,91 @@
+#ifndef TRANSACTIONPAGEMODEL_H
+#define TRANSACTIONPAGEMODEL_H
+
+#include <QAbstractTableModel>
+#include <QCache>
+#include <QDate>
+#include <QMap>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QStringList>
+#include <QVector>
+#include "Logger.h"
+
+/*
+ * Read only model for the View All Transactions window.
+ * Rows are listed in ledger order (date_added, id) and fetched a page at a time with keyset pagination on that
+ * key (WHERE (date_added, id) > last key of the previous page), only when the view asks for them, and the pages
+ * are kept in a bounded LRU cache.
+*/
+class TransactionPageModel : public QAbstractTableModel
+{
+    Q_OBJECT
+public:
+    /* column 0 = descrip
+     * column 1 = mode
+     * column 2 = trans amount
+     * column 3 = balance
+     * column 4 = date added
+    */
+    enum Column{
+        DESCRIPTION,
+        MODE,
+        TRANSACTION_AMOUNT,
+        BALANCE,
+        DATE_ADDED,
+        COLUMN_COUNT
+    };
+
+    explicit TransactionPageModel(QSqlDatabase db, qint64 account, Logger * logger, QObject *parent = 0);
+
+    int rowCount(const QModelIndex & parent = QModelIndex()) const;
+    int columnCount(const QModelIndex & parent = QModelIndex()) const;
+    QVariant data(const QModelIndex & index, int role = Qt::DisplayRole) const;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
+
+    //re-counts the rows and drops every cached page, call after the table changes
+    void refresh();
+
+    //shows another account's transactions
+    void set_account(qint64 account);
+
+    //display text of up to count rows spread over the whole table, used to size columns
+    //without fetching or measuring every row
+    QVector<QStringList> sample(int count) const;
+
+private:
+    //a row's position in the ledger order, transactions without a date come first
+    struct Key{
+        QDate date;
+        qint64 id;
+    };
+
+    struct Page{
+        QVector<QVariant> values;
+        Key last;
+    };
+
+    //returns the cached page or fetches it, NULL if it can't be read
+    Page * page(int page_number) const;
+
+    //key the page starts after, found by walking the ledger index from the nearest known boundary
+    bool page_boundary(int page_number, Key & after) const;
+
+    //amounts and balances are stored as cents, shown as dollars
+    static QVariant display_value(int column, const QVariant & value);
+
+    QSqlDatabase db;
+    qint64 account;
+    Logger * logger;
+    int row_count;
+
+    //prepared once, reused for every page. the sql differs for a key without a date, [0] = no date, [1] = dated
+    mutable QSqlQuery page_qrys[2];
+    mutable QSqlQuery boundary_qrys[2];
+
+    //page # -> key the page starts after, filled in as pages are discovered
+    mutable QMap<int, Key> page_after;
+    mutable QCache<int, Page> pages;
+};
+
+#endif // TRANSACTIONPAGEMODEL_H
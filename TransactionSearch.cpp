@@ -0,0 +1,136 @@
+#include "TransactionSearch.h"
+#include "DatabaseManager.h"
+#include "Metrics.h"
+#include <QElapsedTimer>
+#include <QRegExp>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QStringList>
+
+//name of the search thread's connection.
+#define SEARCH_CONNECTION_NAME "db_search"
+//most hits returned to the search window, it says when there are more.
+#define SEARCH_RESULT_LIMIT 500
+
+bool SearchFilter::is_empty() const{
+    return text.trimmed().isEmpty() && !from.isValid() && !to.isValid() && !use_min_amount && !use_max_amount;
+}
+
+TransactionSearch::TransactionSearch(Logger * logger, QString db_path, QObject *parent) :
+    QObject(parent),
+    logger(logger),
+    db_path(db_path),
+    db(NULL),
+    latest_request(0)
+{
+}
+
+/*
+ * Runs on the search thread when the thread finishes, the connection is removed on the thread that made it.
+*/
+TransactionSearch::~TransactionSearch(){
+    delete db;
+}
+
+void TransactionSearch::open(){
+    if(db == NULL) db = new DatabaseManager(logger, db_path, SEARCH_CONNECTION_NAME);
+    if(!db->open()) logger->log(Logger::CRITICAL, "Error opening the search connection");
+}
+
+void TransactionSearch::supersede(int request){
+    latest_request.fetchAndStoreOrdered(request);
+}
+
+void TransactionSearch::search(int request, SearchFilter filter){
+    if(request < latest_request.loadAcquire()) return;
+    ScopedTimer scope("search.query");
+    QElapsedTimer timer;
+    timer.start();
+    SearchHits hits;
+    bool truncated = false;
+    bool success = db != NULL && db->is_open() && find(db->database(), logger, filter, SEARCH_RESULT_LIMIT, hits, truncated);
+    emit searched(request, success, hits, truncated, timer.elapsed());
+}
+
+/*
+ * "rent 2016" becomes "rent"* "2016"*, quotes in a word are doubled so nothing typed is read as FTS syntax.
+*/
+QString TransactionSearch::match_expression(QString text){
+    QStringList words = text.split(QRegExp("\\s+"), QString::SkipEmptyParts);
+    for(int i = 0; i < words.size(); i++){
+        words[i] = "\"" + words[i].replace("\"", "\"\"") + "\"*";
+    }
+    return words.join(" ");
+}
+
+/*
+ * The words are looked up in the FTS index first and the bounds applied to the matching ids, or the bounds
+ * drive the query through their index when there are no words. Without FTS5 the words are matched with LIKE.
+ * One row past the limit is read to know if there are more.
+*/
+bool TransactionSearch::find(QSqlDatabase db, Logger * logger, const SearchFilter & filter, int limit, SearchHits & hits, bool & truncated){
+    QStringList conditions;
+    conditions << "account_id = :account";
+    QStringList words = filter.text.split(QRegExp("\\s+"), QString::SkipEmptyParts);
+    bool use_fts = false;
+    if(!words.isEmpty()){
+        QSqlQuery table_qry = db.exec("SELECT count(*) FROM sqlite_master WHERE type = 'table' AND name = 'transactions_fts';");
+        use_fts = table_qry.next() && table_qry.value(0).toInt() > 0;
+        if(use_fts){
+            conditions << "id IN (SELECT rowid FROM transactions_fts WHERE transactions_fts MATCH :match)";
+        }else{
+            for(int i = 0; i < words.size(); i++){
+                conditions << "description LIKE :word" + QString::number(i) + " ESCAPE '\\'";
+            }
+        }
+    }
+    if(filter.from.isValid()) conditions << "date_added >= :from";
+    if(filter.to.isValid()) conditions << "date_added <= :to";
+    if(filter.use_min_amount) conditions << "trans_amount >= :min_amount";
+    if(filter.use_max_amount) conditions << "trans_amount <= :max_amount";
+
+    QString sql = "SELECT id, description, mode, trans_amount, balance, date_added FROM transactions";
+    sql += " WHERE " + conditions.join(" AND ");
+    sql += " ORDER BY date_added, id LIMIT :limit;";
+
+    QSqlQuery qry(db);
+    qry.setForwardOnly(true);
+    qry.prepare(sql);
+    if(use_fts){
+        qry.bindValue(":match", match_expression(filter.text));
+    }else{
+        for(int i = 0; i < words.size(); i++){
+            QString word = words[i];
+            word.replace("\\", "\\\\").replace("%", "\\%").replace("_", "\\_");
+            qry.bindValue(":word" + QString::number(i), "%" + word + "%");
+        }
+    }
+    qry.bindValue(":account", filter.account);
+    if(filter.from.isValid()) qry.bindValue(":from", filter.from);
+    if(filter.to.isValid()) qry.bindValue(":to", filter.to);
+    if(filter.use_min_amount) qry.bindValue(":min_amount", filter.min_amount.to_cents());
+    if(filter.use_max_amount) qry.bindValue(":max_amount", filter.max_amount.to_cents());
+    qry.bindValue(":limit", limit + 1);
+    if(!qry.exec()){
+        logger->log(Logger::CRITICAL, "Search query failed", qry.lastError().text());
+        return false;
+    }
+    hits.clear();
+    truncated = false;
+    while(qry.next()){
+        if(hits.size() == limit){
+            truncated = true;
+            break;
+        }
+        SearchHit hit;
+        hit.id = qry.value(0).toLongLong();
+        hit.description = qry.value(1).toString();
+        hit.mode = qry.value(2).toString();
+        hit.amount = Money::from_cents(qry.value(3).toLongLong());
+        hit.balance = Money::from_cents(qry.value(4).toLongLong());
+        hit.date = qry.value(5).toDate();
+        hits.append(hit);
+    }
+    qry.finish();
+    return true;
+}
@@ -0,0 +1,84 @@
+#ifndef TRANSACTIONSEARCH_H
+#define TRANSACTIONSEARCH_H
+
+#include <QObject>
+#include <QAtomicInt>
+#include <QDate>
+#include <QMetaType>
+#include <QSqlDatabase>
+#include <QVector>
+#include "Logger.h"
+#include "Money.h"
+
+class DatabaseManager;
+
+//what to look for in one account, every other part is optional and the parts are combined (AND)
+struct SearchFilter{
+    SearchFilter() : account(1), use_min_amount(false), use_max_amount(false) {}
+
+    qint64 account;
+    //words the description must contain, each one matches as a prefix
+    QString text;
+    //inclusive, invalid = no bound
+    QDate from;
+    QDate to;
+    bool use_min_amount;
+    bool use_max_amount;
+    Money min_amount;
+    Money max_amount;
+
+    bool is_empty() const;
+};
+Q_DECLARE_METATYPE(SearchFilter)
+
+struct SearchHit{
+    qint64 id;
+    QString description;
+    QString mode;
+    Money amount;
+    Money balance;
+    QDate date;
+};
+typedef QVector<SearchHit> SearchHits;
+Q_DECLARE_METATYPE(SearchHits)
+
+/*
+ * Runs the search window's queries on its own thread with its own read connection, so typing never waits on
+ * sqlite or on the DB worker's writes (WAL lets the reads run alongside them).
+ * The words go through the transactions_fts index, the date and amount bounds through the account's
+ * (account_id, date_added) and (account_id, trans_amount) indexes. Move it to a QThread, call open() then search() through queued signals.
+*/
+class TransactionSearch : public QObject
+{
+    Q_OBJECT
+public:
+    explicit TransactionSearch(Logger * logger, QString db_path, QObject *parent = 0);
+    ~TransactionSearch();
+
+    //runs one search on db, at most limit hits in ledger order. truncated is set if there were more.
+    static bool find(QSqlDatabase db, Logger * logger, const SearchFilter & filter, int limit, SearchHits & hits, bool & truncated);
+
+    //the FTS5 MATCH expression for the words of text, every word as a quoted prefix
+    static QString match_expression(QString text);
+
+    //thread safe, called by the window before queueing a search: queued searches older than request are
+    //skipped without an answer instead of being run one after the other
+    void supersede(int request);
+
+public slots:
+    void open();
+
+    //request is handed back with the hits so late answers to older searches can be told apart
+    void search(int request, SearchFilter filter);
+
+signals:
+    void searched(int request, bool success, SearchHits hits, bool truncated, qint64 elapsed_ms);
+
+private:
+    Logger * logger;
+    QString db_path;
+    DatabaseManager * db;
+    QAtomicInt latest_request;
+};
+
+#endif // TRANSACTIONSEARCH_H
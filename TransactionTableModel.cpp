@@ -0,0 +1,74 @@
+#include "TransactionTableModel.h"
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QSqlRecord>
+
+TransactionTableModel::TransactionTableModel(QObject *parent, QSqlDatabase db) :
+    QSqlTableModel(parent, db)
+{
+}
+
+bool TransactionTableModel::is_money_column(int column){
+    return column == TRANSACTION_AMOUNT || column == BALANCE;
+}
+
+QVariant TransactionTableModel::data(const QModelIndex & index, int role) const{
+    QVariant value = QSqlTableModel::data(index, role);
+    if(!is_money_column(index.column()) || (role != Qt::DisplayRole && role != Qt::EditRole) || value.isNull()) return value;
+    qint64 cents = value.toLongLong();
+    if(index.column() == BALANCE && index.row() < balance_shifts.size()) cents += balance_shifts[index.row()];
+    return Money::from_cents(cents).to_string();
+}
+
+bool TransactionTableModel::setData(const QModelIndex & index, const QVariant & value, int role){
+    if(!is_money_column(index.column()) || role != Qt::EditRole) return QSqlTableModel::setData(index, value, role);
+    bool ok = false;
+    Money amount = Money::from_string(value.toString(), &ok);
+    if(!ok) return false;
+    return QSqlTableModel::setData(index, amount.to_cents(), role);
+}
+
+bool TransactionTableModel::select(){
+    balance_shifts.clear();
+    return QSqlTableModel::select();
+}
+
+bool TransactionTableModel::selectRow(int row){
+    if(row >= 0 && row < balance_shifts.size()) balance_shifts[row] = 0;
+    return QSqlTableModel::selectRow(row);
+}
+
+/*
+ * setSort() only takes one column, the ledger order needs the id to break ties between rows of the same day.
+*/
+QString TransactionTableModel::orderByClause() const{
+    return QLatin1String("ORDER BY date_added, id");
+}
+
+/*
+ * submitAll() would write the row and then re-select the whole table, this writes the one field and only
+ * re-reads the one row.
+*/
+bool TransactionTableModel::save_field(int row, int column){
+    QString field = record().fieldName(column);
+    if(field.isEmpty()) return false;
+    QSqlQuery update_qry(database());
+    update_qry.prepare("UPDATE transactions SET " + field + " = :value WHERE id = :id;");
+    update_qry.bindValue(":value", QSqlTableModel::data(index(row, column), Qt::EditRole));
+    update_qry.bindValue(":id", QSqlTableModel::data(index(row, ID)).toLongLong());
+    if(!update_qry.exec() || update_qry.numRowsAffected() != 1){
+        setLastError(update_qry.lastError());
+        return false;
+    }
+    return selectRow(row);
+}
+
+void TransactionTableModel::shift_balances(int row, Money change){
+    int rows = rowCount();
+    if(change.is_zero() || row + 1 >= rows) return;
+    if(balance_shifts.size() < rows) balance_shifts.resize(rows);
+    for(int i = row + 1; i < rows; i++){
+        balance_shifts[i] += change.to_cents();
+    }
+    emit dataChanged(index(row + 1, BALANCE), index(rows - 1, BALANCE));
+}
@@ -0,0 +1,64 @@
+#ifndef TRANSACTIONTABLEMODEL_H
+#define TRANSACTIONTABLEMODEL_H
+
+#include <QSqlTableModel>
+#include <QVector>
+#include "Money.h"
+
+/*
+ * Editable model over the transactions table for the Edit Transactions window.
+ * Amounts and balances are stored as cents, this shows and edits them as dollars ("12.50").
+ * Saved edits never re-select the table: the edited row is read back on its own and, when an edit moved
+ * the balances after it, the loaded rows' balances are shifted in memory and repainted.
+*/
+class TransactionTableModel : public QSqlTableModel
+{
+    Q_OBJECT
+public:
+    /* column 0 = id
+     * column 1 = descrip
+     * column 2 = mode
+     * column 3 = trans amount
+     * column 4 = balance
+     * column 5 = date added
+     * column 6 = account id
+    */
+    enum Column{
+        ID,
+        DESCRIPTION,
+        MODE,
+        TRANSACTION_AMOUNT,
+        BALANCE,
+        DATE_ADDED,
+        ACCOUNT_ID
+    };
+
+    explicit TransactionTableModel(QObject *parent = 0, QSqlDatabase db = QSqlDatabase());
+
+    QVariant data(const QModelIndex & index, int role = Qt::DisplayRole) const;
+
+    //an edited amount must be a plain decimal, it is stored rounded to the cent
+    bool setData(const QModelIndex & index, const QVariant & value, int role = Qt::EditRole);
+
+    //both drop the in memory balance shifts of what they reload
+    bool select();
+    bool selectRow(int row);
+
+    //saves the row's edited value of column with one UPDATE by id, then reads that row back
+    bool save_field(int row, int column);
+
+    //adds change to the balance of every loaded row after row, the database already holds the new balances
+    void shift_balances(int row, Money change);
+
+protected:
+    //rows are listed in ledger order (date_added, id), the order the balances run in
+    QString orderByClause() const;
+
+private:
+    static bool is_money_column(int column);
+
+    //cents added to each loaded row's balance since it was read, rows past the end have none
+    QVector<qint64> balance_shifts;
+};
+
+#endif // TRANSACTIONTABLEMODEL_H
@@ -0,0 +1,56 @@
+#-------------------------------------------------
+#
+# Benchmarks for the database hot paths, run with:
+#   ./ledger-benchmarks            (results written to benchmark_results.xml)
+#   ./ledger-benchmarks -o file,xml
+# the instrumentation timings of the run are written to benchmark_diagnostics.txt
+#
+#-------------------------------------------------
+
+QT       += core gui sql testlib concurrent
+
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+
+TARGET = ledger-benchmarks
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+LIBS += -lsqlite3
+
+INCLUDEPATH += ..
+
+SOURCES += tst_ledgerbenchmark.cpp \
+    ../Logger.cpp \
+    ../DatabaseManager.cpp \
+    ../LedgerEngine.cpp \
+    ../SqlExporter.cpp \
+    ../SqlImporter.cpp \
+    ../Money.cpp \
+    ../LedgerCache.cpp \
+    ../LedgerReports.cpp \
+    ../TransactionSearch.cpp \
+    ../DatabaseBackup.cpp \
+    ../LedgerSnapshot.cpp \
+    ../SnapshotExporter.cpp \
+    ../Metrics.cpp \
+    ../DatabaseMaintenance.cpp \
+    ../BalanceVerifier.cpp \
+    ../BatchIngestor.cpp
+
+HEADERS += ../Logger.h \
+    ../DatabaseManager.h \
+    ../LedgerEngine.h \
+    ../SqlExporter.h \
+    ../SqlImporter.h \
+    ../Money.h \
+    ../LedgerCache.h \
+    ../LedgerReports.h \
+    ../TransactionSearch.h \
+    ../DatabaseBackup.h \
+    ../LedgerSnapshot.h \
+    ../SnapshotExporter.h \
+    ../Metrics.h \
+    ../DatabaseMaintenance.h \
+    ../BalanceVerifier.h \
+    ../BatchIngestor.h
@@ -0,0 +1,839 @@
+#include <QApplication>
+#include <QBuffer>
+#include <QDate>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QTemporaryDir>
+#include <QtTest>
+#include "Logger.h"
+#include "DatabaseManager.h"
+#include "DatabaseBackup.h"
+#include "DatabaseMaintenance.h"
+#include "LedgerEngine.h"
+#include "LedgerCache.h"
+#include "LedgerReports.h"
+#include "BalanceVerifier.h"
+#include "BatchIngestor.h"
+#include "TransactionSearch.h"
+#include "SqlExporter.h"
+#include "SqlImporter.h"
+#include "SnapshotExporter.h"
+#include "Metrics.h"
+#include "Money.h"
+
+/*
+ * Benchmarks the database hot paths on synthetic ledgers of 10k, 100k and 1M rows.
+ * Each ledger is generated once into a temporary directory and shared by every benchmark.
+*/
+class LedgerBenchmark : public QObject
+{
+    Q_OBJECT
+public:
+    LedgerBenchmark();
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void last_balance_data();
+    void last_balance();
+
+    void last_known_balance_data();
+    void last_known_balance();
+
+    void insert_data();
+    void insert();
+
+    void export_sql_data();
+    void export_sql();
+
+    void online_backup_data();
+    void online_backup();
+
+    void import_sql_data();
+    void import_sql();
+
+    void maintenance_data();
+    void maintenance();
+
+    void export_snapshot_data();
+    void export_snapshot();
+
+    void import_snapshot_data();
+    void import_snapshot();
+
+    void edit_recompute_data();
+    void edit_recompute();
+
+    void backdated_insert_data();
+    void backdated_insert();
+
+    void balance_on_date_data();
+    void balance_on_date();
+
+    void running_balance_data();
+    void running_balance();
+
+    void cache_recompute_data();
+    void cache_recompute();
+
+    void reports_data();
+    void reports();
+
+    void verify_balances_data();
+    void verify_balances();
+
+    void repair_balances_data();
+    void repair_balances();
+
+    void search_data();
+    void search();
+
+    void profile_insert_data();
+    void profile_insert();
+
+    void ingest_order();
+
+    void profile_scan_data();
+    void profile_scan();
+
+    void metrics_overhead();
+
+private:
+    //adds one data row per ledger size
+    void add_sizes();
+
+    //adds one data row per connection profile
+    void add_profiles();
+
+    //the generated ledger with the given # of rows, created on first use
+    DatabaseManager * ledger(int rows);
+
+    //the .sql export of the ledger with the given # of rows, created on first use
+    QString exported(int rows);
+
+    //the binary snapshot of the ledger with the given # of rows, created on first use
+    QString snapshot(int rows);
+
+    Logger * logger;
+    QTemporaryDir dir;
+    QHash<int, DatabaseManager*> ledgers;
+};
+
+LedgerBenchmark::LedgerBenchmark() : logger(NULL)
+{
+}
+
+void LedgerBenchmark::initTestCase(){
+    QVERIFY(dir.isValid());
+    logger = new Logger();
+    logger->set_minimum_level(Logger::WARNING);
+}
+
+void LedgerBenchmark::cleanupTestCase(){
+    QString error;
+    if(!Metrics::instance().dump("benchmark_diagnostics.txt", error)) qWarning() << error;
+    qDeleteAll(ledgers);
+    ledgers.clear();
+    delete logger;
+}
+
+void LedgerBenchmark::add_sizes(){
+    QTest::addColumn<int>("rows");
+    QTest::newRow("10k") << 10000;
+    QTest::newRow("100k") << 100000;
+    QTest::newRow("1M") << 1000000;
+}
+
+/*
+ * Rows alternate 3 deposits of 100 w/ 2 withdrawals of 40, ten rows per day, so the balance never goes negative.
+*/
+DatabaseManager * LedgerBenchmark::ledger(int rows){
+    if(ledgers.contains(rows)) return ledgers.value(rows);
+    DatabaseManager * db = new DatabaseManager(logger, dir.path() + "/ledger_" + QString::number(rows) + ".db", "ledger_" + QString::number(rows));
+    ledgers.insert(rows, db);
+    if(!db->open() || !db->ensure_schema()) return db;
+
+    QSqlDatabase connection = db->database();
+    connection.transaction();
+    QSqlQuery & add_transaction_qry = db->prepared(DatabaseManager::INSERT_TRANSACTION);
+    add_transaction_qry.bindValue(":account", DatabaseManager::DEFAULT_ACCOUNT);
+    QDate start(2000, 1, 1);
+    Money balance;
+    for(int i = 0; i < rows; i++){
+        QString mode = (i % 5 < 3) ? "Deposit" : "Withdraw";
+        Money amount = Money::from_cents(mode == "Deposit" ? 10000 : 4000);
+        balance += LedgerEngine::signed_amount(mode, amount);
+        add_transaction_qry.bindValue(":desc", "Transaction " + QString::number(i));
+        add_transaction_qry.bindValue(":mode", mode);
+        add_transaction_qry.bindValue(":trans_amount", amount.to_cents());
+        add_transaction_qry.bindValue(":balance", balance.to_cents());
+        add_transaction_qry.bindValue(":date", start.addDays(i / 10));
+        add_transaction_qry.exec();
+    }
+    connection.commit();
+    return db;
+}
+
+QString LedgerBenchmark::exported(int rows){
+    QString file_name = dir.path() + "/ledger_" + QString::number(rows) + ".sql";
+    if(!QFile::exists(file_name)){
+        ledger(rows);
+        SqlExporter(logger, dir.path() + "/ledger_" + QString::number(rows) + ".db", file_name, DatabaseManager::DEFAULT_ACCOUNT, rows).run();
+    }
+    return file_name;
+}
+
+QString LedgerBenchmark::snapshot(int rows){
+    QString file_name = dir.path() + "/ledger_" + QString::number(rows) + ".mmsnap";
+    if(!QFile::exists(file_name)){
+        ledger(rows);
+        SnapshotExporter(logger, dir.path() + "/ledger_" + QString::number(rows) + ".db", file_name, DatabaseManager::DEFAULT_ACCOUNT, rows).run();
+    }
+    return file_name;
+}
+
+void LedgerBenchmark::last_balance_data(){
+    add_sizes();
+}
+
+void LedgerBenchmark::last_balance(){
+    QFETCH(int, rows);
+    DatabaseManager * db = ledger(rows);
+    qint64 balance = 0;
+    db->prepared(DatabaseManager::LAST_BALANCE).bindValue(":account", DatabaseManager::DEFAULT_ACCOUNT);
+    QBENCHMARK{
+        db->exec(DatabaseManager::LAST_BALANCE);
+        QSqlQuery & qry = db->prepared(DatabaseManager::LAST_BALANCE);
+        if(qry.next()) balance = qry.value(0).toLongLong();
+        db->release(DatabaseManager::LAST_BALANCE);
+    }
+    QVERIFY(balance > 0);
+}
+
+void LedgerBenchmark::last_known_balance_data(){
+    add_sizes();
+}
+
+/*
+ * The startup read of the account_balances row, which has to agree with the ledger's last balance.
+*/
+void LedgerBenchmark::last_known_balance(){
+    QFETCH(int, rows);
+    DatabaseManager * db = ledger(rows);
+    Money balance;
+    bool found = false;
+    QBENCHMARK{
+        found = db->last_known_balance(DatabaseManager::DEFAULT_ACCOUNT, balance);
+    }
+    QVERIFY(found);
+    db->prepared(DatabaseManager::LAST_BALANCE).bindValue(":account", DatabaseManager::DEFAULT_ACCOUNT);
+    QVERIFY(db->exec(DatabaseManager::LAST_BALANCE));
+    QSqlQuery & qry = db->prepared(DatabaseManager::LAST_BALANCE);
+    QVERIFY(qry.next());
+    QCOMPARE(balance.to_cents(), qry.value(0).toLongLong());
+    db->release(DatabaseManager::LAST_BALANCE);
+}
+
+void LedgerBenchmark::insert_data(){
+    add_sizes();
+}
+
+void LedgerBenchmark::insert(){
+    QFETCH(int, rows);
+    DatabaseManager * db = ledger(rows);
+    QSqlQuery & add_transaction_qry = db->prepared(DatabaseManager::INSERT_TRANSACTION);
+    add_transaction_qry.bindValue(":account", DatabaseManager::DEFAULT_ACCOUNT);
+    bool result = true;
+    QBENCHMARK{
+        add_transaction_qry.bindValue(":desc", "Benchmark deposit");
+        add_transaction_qry.bindValue(":mode", "Deposit");
+        add_transaction_qry.bindValue(":trans_amount", 1);
+        add_transaction_qry.bindValue(":balance", 0);
+        add_transaction_qry.bindValue(":date", QDate::currentDate());
+        result = db->exec(DatabaseManager::INSERT_TRANSACTION) && result;
+    }
+    //keep the ledgers identical for the benchmarks that follow
+    db->database().exec("DELETE FROM transactions WHERE description = 'Benchmark deposit';");
+    QVERIFY(result);
+}
+
+void LedgerBenchmark::export_sql_data(){
+    add_sizes();
+}
+
+void LedgerBenchmark::export_sql(){
+    QFETCH(int, rows);
+    ledger(rows);
+    QString file_name = dir.path() + "/export_" + QString::number(rows) + ".sql";
+    SqlExporter exporter(logger, dir.path() + "/ledger_" + QString::number(rows) + ".db", file_name, DatabaseManager::DEFAULT_ACCOUNT, rows);
+    QBENCHMARK_ONCE{
+        exporter.run();
+    }
+    QVERIFY(QFile::exists(file_name));
+    QFile::remove(file_name);
+}
+
+void LedgerBenchmark::online_backup_data(){
+    add_sizes();
+}
+
+/*
+ * One full online backup of the ledger, stepped the same way as the window's backups.
+*/
+void LedgerBenchmark::online_backup(){
+    QFETCH(int, rows);
+    ledger(rows);
+    DatabaseBackup backup(logger, dir.path() + "/ledger_" + QString::number(rows) + ".db");
+    QSignalSpy finished(&backup, SIGNAL(finished(bool,QString,QString,QString)));
+    QBENCHMARK_ONCE{
+        backup.run("benchmark");
+    }
+    QCOMPARE(finished.count(), 1);
+    QVERIFY(finished[0][0].toBool());
+    QString file_name = finished[0][2].toString();
+    QVERIFY(QFile::exists(file_name));
+    QFile::remove(file_name);
+}
+
+void LedgerBenchmark::import_sql_data(){
+    add_sizes();
+}
+
+void LedgerBenchmark::import_sql(){
+    QFETCH(int, rows);
+    QString file_name = exported(rows);
+    DatabaseManager db(logger, dir.path() + "/import_" + QString::number(rows) + ".db", "import_" + QString::number(rows));
+    QVERIFY(db.open() && db.ensure_schema());
+    SqlImporter importer(logger, db.database(), DatabaseManager::DEFAULT_ACCOUNT);
+    SqlImporter::Result result = SqlImporter::FAILED;
+    QBENCHMARK_ONCE{
+        result = importer.import_file(file_name);
+    }
+    QCOMPARE(int(result), int(SqlImporter::IMPORTED));
+    QCOMPARE(importer.rows_imported(), qint64(rows));
+}
+
+void LedgerBenchmark::maintenance_data(){
+    add_sizes();
+}
+
+/*
+ * A full maintenance cycle over a database whose only account was just deleted (truncated), slice by slice as
+ * the window runs it. The file has to end up smaller.
+*/
+void LedgerBenchmark::maintenance(){
+    QFETCH(int, rows);
+    QString db_path = dir.path() + "/maintenance_" + QString::number(rows) + ".db";
+    {
+        DatabaseManager db(logger, db_path, "maintenance_" + QString::number(rows));
+        QVERIFY(db.open() && db.ensure_schema());
+        SqlImporter importer(logger, db.database(), DatabaseManager::DEFAULT_ACCOUNT);
+        QCOMPARE(int(importer.import_file(exported(rows))), int(SqlImporter::IMPORTED));
+        QSqlDatabase connection = db.database();
+        QVERIFY(connection.transaction());
+        connection.exec("DROP TRIGGER IF EXISTS transactions_fts_delete;");
+        connection.exec("DROP TRIGGER IF EXISTS account_balances_delete;");
+        QVERIFY(!connection.exec("DELETE FROM transactions;").lastError().isValid());
+        QVERIFY(connection.commit());
+        connection.exec("PRAGMA wal_checkpoint(TRUNCATE);");
+    }
+    qint64 size_before = QFileInfo(db_path).size();
+    DatabaseMaintenance maintenance(logger, db_path);
+    QSignalSpy finished(&maintenance, SIGNAL(finished(bool,QString)));
+    QSignalSpy slices(&maintenance, SIGNAL(slice_finished()));
+    QBENCHMARK_ONCE{
+        while(finished.isEmpty()) maintenance.run_slice();
+    }
+    QVERIFY(finished[0][0].toBool());
+    qDebug() << finished[0][1].toString() << "-" << slices.count() + 1 << "slices," << size_before / 1024 << "KB before," << QFileInfo(db_path).size() / 1024 << "KB after";
+    QVERIFY(QFileInfo(db_path).size() < size_before);
+}
+
+void LedgerBenchmark::export_snapshot_data(){
+    add_sizes();
+}
+
+/*
+ * Same rows as export_sql, the file sizes of both formats are printed next to each other.
+*/
+void LedgerBenchmark::export_snapshot(){
+    QFETCH(int, rows);
+    ledger(rows);
+    QString file_name = dir.path() + "/export_" + QString::number(rows) + ".mmsnap";
+    SnapshotExporter exporter(logger, dir.path() + "/ledger_" + QString::number(rows) + ".db", file_name, DatabaseManager::DEFAULT_ACCOUNT, rows);
+    QBENCHMARK_ONCE{
+        exporter.run();
+    }
+    QVERIFY(QFile::exists(file_name));
+    qint64 snapshot_bytes = QFileInfo(file_name).size();
+    qint64 sql_bytes = QFileInfo(exported(rows)).size();
+    qDebug() << "snapshot" << snapshot_bytes << "bytes, sql dump" << sql_bytes << "bytes," << QString::number(double(sql_bytes) / snapshot_bytes, 'f', 2) + "x smaller";
+    QFile::remove(file_name);
+}
+
+void LedgerBenchmark::import_snapshot_data(){
+    add_sizes();
+}
+
+void LedgerBenchmark::import_snapshot(){
+    QFETCH(int, rows);
+    QString file_name = snapshot(rows);
+    DatabaseManager db(logger, dir.path() + "/import_snapshot_" + QString::number(rows) + ".db", "import_snapshot_" + QString::number(rows));
+    QVERIFY(db.open() && db.ensure_schema());
+    SqlImporter importer(logger, db.database(), DatabaseManager::DEFAULT_ACCOUNT);
+    SqlImporter::Result result = SqlImporter::FAILED;
+    QBENCHMARK_ONCE{
+        result = importer.import_snapshot(file_name);
+    }
+    QCOMPARE(int(result), int(SqlImporter::IMPORTED));
+    QCOMPARE(importer.rows_imported(), qint64(rows));
+}
+
+void LedgerBenchmark::edit_recompute_data(){
+    add_sizes();
+}
+
+/*
+ * Changes the amount of the 10th transaction, which shifts the balance of every row after it in one UPDATE.
+*/
+void LedgerBenchmark::edit_recompute(){
+    QFETCH(int, rows);
+    DatabaseManager * db = ledger(rows);
+    LedgerEngine engine;
+    QVERIFY(engine.load(db->database(), DatabaseManager::DEFAULT_ACCOUNT, logger));
+    int row = 10;
+    QString mode = engine.delta_at(row).is_negative() ? "Withdraw" : "Deposit";
+    Money amount = LedgerEngine::signed_amount(mode, engine.delta_at(row));
+    Money edited = amount + Money::from_cents(100);
+    //the generated ledgers have 10 transactions a day
+    QDate date = QDate(2000, 1, 1).addDays(row / 10);
+    bool result = false;
+    QBENCHMARK_ONCE{
+        result = engine.can_set_delta(row, LedgerEngine::signed_amount(mode, edited))
+                && engine.apply_edit(db->database(), DatabaseManager::DEFAULT_ACCOUNT, row, date, mode, edited, logger);
+    }
+    QVERIFY(result);
+    QVERIFY(engine.apply_edit(db->database(), DatabaseManager::DEFAULT_ACCOUNT, row, date, mode, amount, logger));
+}
+
+void LedgerBenchmark::backdated_insert_data(){
+    add_sizes();
+}
+
+/*
+ * A withdrawal dated in the middle of the ledger, the way submit() adds it: the balance it starts from, the
+ * no-negative check over the rows after it, the insert and one UPDATE shifting the later balances.
+ * Rolled back every iteration so the ledger stays the same.
+*/
+void LedgerBenchmark::backdated_insert(){
+    QFETCH(int, rows);
+    DatabaseManager * db = ledger(rows);
+    QSqlDatabase connection = db->database();
+    QDate date = QDate(2000, 1, 1).addDays(rows / 20);
+    Money amount = Money::from_cents(100);
+    int shifted = 0;
+    bool result = true;
+    QBENCHMARK{
+        connection.transaction();
+        Money balance;
+        db->prepared(DatabaseManager::BALANCE_ON_DATE).bindValue(":account", DatabaseManager::DEFAULT_ACCOUNT);
+        db->prepared(DatabaseManager::BALANCE_ON_DATE).bindValue(":date", date);
+        if(db->exec(DatabaseManager::BALANCE_ON_DATE) && db->prepared(DatabaseManager::BALANCE_ON_DATE).next()){
+            balance = Money::from_cents(db->prepared(DatabaseManager::BALANCE_ON_DATE).value(0).toLongLong());
+        }
+        db->release(DatabaseManager::BALANCE_ON_DATE);
+        db->prepared(DatabaseManager::MIN_BALANCE_AFTER_DATE).bindValue(":account", DatabaseManager::DEFAULT_ACCOUNT);
+        db->prepared(DatabaseManager::MIN_BALANCE_AFTER_DATE).bindValue(":date", date);
+        result = db->exec(DatabaseManager::MIN_BALANCE_AFTER_DATE) && db->prepared(DatabaseManager::MIN_BALANCE_AFTER_DATE).next()
+                && db->prepared(DatabaseManager::MIN_BALANCE_AFTER_DATE).value(0).toLongLong() >= amount.to_cents() && result;
+        db->release(DatabaseManager::MIN_BALANCE_AFTER_DATE);
+        QSqlQuery & add_transaction_qry = db->prepared(DatabaseManager::INSERT_TRANSACTION);
+        add_transaction_qry.bindValue(":account", DatabaseManager::DEFAULT_ACCOUNT);
+        add_transaction_qry.bindValue(":desc", "Benchmark back-dated withdrawal");
+        add_transaction_qry.bindValue(":mode", "Withdraw");
+        add_transaction_qry.bindValue(":trans_amount", amount.to_cents());
+        add_transaction_qry.bindValue(":balance", (balance - amount).to_cents());
+        add_transaction_qry.bindValue(":date", date);
+        result = db->exec(DatabaseManager::INSERT_TRANSACTION) && result;
+        QSqlQuery & shift_qry = db->prepared(DatabaseManager::SHIFT_BALANCES_AFTER_DATE);
+        shift_qry.bindValue(":account", DatabaseManager::DEFAULT_ACCOUNT);
+        shift_qry.bindValue(":change", -amount.to_cents());
+        shift_qry.bindValue(":date", date);
+        result = db->exec(DatabaseManager::SHIFT_BALANCES_AFTER_DATE) && result;
+        shifted = shift_qry.numRowsAffected();
+        connection.rollback();
+    }
+    QVERIFY(result);
+    QCOMPARE(shifted, rows - (rows / 20 + 1) * 10);
+}
+
+void LedgerBenchmark::balance_on_date_data(){
+    add_sizes();
+}
+
+void LedgerBenchmark::balance_on_date(){
+    QFETCH(int, rows);
+    DatabaseManager * db = ledger(rows);
+    QDate date = QDate(2000, 1, 1).addDays(rows / 20);
+    qint64 balance = 0;
+    db->prepared(DatabaseManager::BALANCE_ON_DATE).bindValue(":account", DatabaseManager::DEFAULT_ACCOUNT);
+    db->prepared(DatabaseManager::BALANCE_ON_DATE).bindValue(":date", date);
+    QBENCHMARK{
+        db->exec(DatabaseManager::BALANCE_ON_DATE);
+        QSqlQuery & qry = db->prepared(DatabaseManager::BALANCE_ON_DATE);
+        if(qry.next()) balance = qry.value(0).toLongLong();
+        db->release(DatabaseManager::BALANCE_ON_DATE);
+    }
+    QSqlQuery scan_qry(db->database());
+    scan_qry.prepare("SELECT COALESCE(SUM(CASE WHEN mode = 'Deposit' THEN trans_amount ELSE -trans_amount END), 0) FROM transactions NOT INDEXED "
+                     "WHERE account_id = :account AND date_added <= :date;");
+    scan_qry.bindValue(":account", DatabaseManager::DEFAULT_ACCOUNT);
+    scan_qry.bindValue(":date", date);
+    QVERIFY(scan_qry.exec() && scan_qry.next());
+    QCOMPARE(balance, scan_qry.value(0).toLongLong());
+}
+
+void LedgerBenchmark::running_balance_data(){
+    QTest::addColumn<int>("rows");
+    QTest::addColumn<bool>("cents");
+    QTest::newRow("1M double") << 1000000 << false;
+    QTest::newRow("1M int64 cents") << 1000000 << true;
+}
+
+/*
+ * The in-memory half of a recompute (running balance + lowest balance over every row), with amounts held as
+ * double dollars vs int64 cents. Amounts like 0.10 aren't exact as doubles, so the double sum also drifts.
+*/
+void LedgerBenchmark::running_balance(){
+    QFETCH(int, rows);
+    QFETCH(bool, cents);
+    QVector<double> dollar_deltas(rows);
+    QVector<qint64> cent_deltas(rows);
+    for(int i = 0; i < rows; i++){
+        cent_deltas[i] = (i % 5 < 3) ? 10 : -5;
+        dollar_deltas[i] = cent_deltas[i] / 100.0;
+    }
+    qint64 cent_balance = 0;
+    double dollar_balance = 0;
+    if(cents){
+        QBENCHMARK{
+            qint64 balance = 0;
+            qint64 lowest = 0;
+            for(int i = 0; i < rows; i++){
+                balance += cent_deltas[i];
+                if(balance < lowest) lowest = balance;
+            }
+            cent_balance = balance + lowest;
+        }
+        QCOMPARE(cent_balance, qint64(rows / 5) * 20);
+    }else{
+        QBENCHMARK{
+            double balance = 0;
+            double lowest = 0;
+            for(int i = 0; i < rows; i++){
+                balance += dollar_deltas[i];
+                if(balance < lowest) lowest = balance;
+            }
+            dollar_balance = balance + lowest;
+        }
+        qDebug() << "double drift after" << rows << "rows:" << QString::number(dollar_balance - rows / 5 * 0.20, 'g', 6);
+    }
+}
+
+void LedgerBenchmark::cache_recompute_data(){
+    add_sizes();
+}
+
+/*
+ * Loads the ledger cache once (its memory per row is printed) then changes the amount of the 10th transaction,
+ * which recomputes every later balance in the cache's arrays.
+*/
+void LedgerBenchmark::cache_recompute(){
+    QFETCH(int, rows);
+    DatabaseManager * db = ledger(rows);
+    LedgerCache cache;
+    QVERIFY(cache.load(db->database(), DatabaseManager::DEFAULT_ACCOUNT, logger));
+    QCOMPARE(cache.size(), rows);
+    qDebug() << cache.memory_report();
+    int row = 10;
+    QString mode = cache.mode_at(row);
+    Money amount = cache.amount_at(row);
+    Money total = cache.total();
+    bool edited = false;
+    QBENCHMARK{
+        edited = !edited;
+        cache.set_transaction(row, mode, edited ? amount + Money::from_cents(100) : amount);
+    }
+    cache.set_transaction(row, mode, amount);
+    QVERIFY(cache.total() == total);
+}
+
+void LedgerBenchmark::reports_data(){
+    QTest::addColumn<int>("rows");
+    QTest::addColumn<bool>("incremental");
+    QTest::newRow("1M full") << 1000000 << false;
+    QTest::newRow("1M after one edit") << 1000000 << true;
+}
+
+/*
+ * Monthly/yearly reports over the ledger cache, built from scratch vs brought up to date after an edit
+ * (which only recomputes the edited row's chunk).
+*/
+void LedgerBenchmark::reports(){
+    QFETCH(int, rows);
+    QFETCH(bool, incremental);
+    LedgerCache cache;
+    QVERIFY(cache.load(ledger(rows)->database(), DatabaseManager::DEFAULT_ACCOUNT, logger));
+    LedgerReports reports;
+    reports.update(cache);
+    int row = rows / 2;
+    QString mode = cache.mode_at(row);
+    Money amount = cache.amount_at(row);
+    bool edited = false;
+    int recomputed = 0;
+    QBENCHMARK{
+        if(incremental){
+            edited = !edited;
+            cache.set_transaction(row, mode, edited ? amount + Money::from_cents(100) : amount);
+            reports.row_changed(row);
+        }else{
+            reports.invalidate();
+        }
+        recomputed = reports.update(cache);
+    }
+    QCOMPARE(recomputed, incremental ? 1 : reports.chunk_count());
+    QVERIFY(!reports.yearly().last().max_balance.is_negative());
+}
+
+void LedgerBenchmark::verify_balances_data(){
+    add_sizes();
+}
+
+/*
+ * The parallel prefix sum over an already loaded cache, the generated ledgers are consistent.
+*/
+void LedgerBenchmark::verify_balances(){
+    QFETCH(int, rows);
+    LedgerCache cache;
+    QVERIFY(cache.load(ledger(rows)->database(), DatabaseManager::DEFAULT_ACCOUNT, logger));
+    BalanceVerifier verifier;
+    int inconsistent = -1;
+    QBENCHMARK{
+        inconsistent = verifier.verify(cache);
+    }
+    QCOMPARE(inconsistent, 0);
+    QCOMPARE(verifier.negative(), 0);
+    QCOMPARE(verifier.rows_checked(), rows);
+}
+
+void LedgerBenchmark::repair_balances_data(){
+    add_sizes();
+}
+
+/*
+ * Every balance from the middle row on is shifted by a cent, then loaded, verified and repaired.
+ * The shifted rows are one run with the same error, so the repair is a single UPDATE.
+*/
+void LedgerBenchmark::repair_balances(){
+    QFETCH(int, rows);
+    DatabaseManager * db = ledger(rows);
+    QSqlDatabase connection = db->database();
+    BalanceVerifier verifier;
+    int inconsistent = 0;
+    QBENCHMARK{
+        QSqlQuery corrupt_qry(connection);
+        corrupt_qry.prepare("UPDATE transactions SET balance = balance + 1 WHERE account_id = :account AND id > :id;");
+        corrupt_qry.bindValue(":account", DatabaseManager::DEFAULT_ACCOUNT);
+        corrupt_qry.bindValue(":id", rows / 2);
+        corrupt_qry.exec();
+        LedgerCache cache;
+        cache.load(connection, DatabaseManager::DEFAULT_ACCOUNT, logger);
+        inconsistent = verifier.verify(cache);
+        verifier.repair(connection, DatabaseManager::DEFAULT_ACCOUNT, logger);
+    }
+    QCOMPARE(inconsistent, rows - rows / 2);
+    LedgerCache cache;
+    QVERIFY(cache.load(connection, DatabaseManager::DEFAULT_ACCOUNT, logger));
+    QCOMPARE(verifier.verify(cache), 0);
+}
+
+void LedgerBenchmark::search_data(){
+    QTest::addColumn<QString>("text");
+    QTest::addColumn<int>("days");
+    QTest::addColumn<qint64>("min_cents");
+    QTest::addColumn<qint64>("max_cents");
+    //the 1M ledger's dates run from 2000-01-01 for 100k days, days = -1 for no date range
+    QTest::newRow("1M rare words") << "Transaction 99999" << -1 << qint64(-1) << qint64(-1);
+    QTest::newRow("1M common word") << "transaction" << -1 << qint64(-1) << qint64(-1);
+    QTest::newRow("1M common word, 30 days") << "transaction" << 30 << qint64(-1) << qint64(-1);
+    QTest::newRow("1M rare word, 30 days, amount range") << "5001" << 30 << qint64(5000) << qint64(20000);
+    QTest::newRow("1M amount range") << "" << -1 << qint64(5000) << qint64(20000);
+    QTest::newRow("1M 30 days") << "" << 30 << qint64(-1) << qint64(-1);
+}
+
+/*
+ * Latency of one search window query (500 hits at most) on the 1M ledger, through the FTS index and the
+ * date/amount indexes.
+*/
+void LedgerBenchmark::search(){
+    QFETCH(QString, text);
+    QFETCH(int, days);
+    QFETCH(qint64, min_cents);
+    QFETCH(qint64, max_cents);
+    DatabaseManager * db = ledger(1000000);
+    SearchFilter filter;
+    filter.text = text;
+    if(days >= 0){
+        filter.from = QDate(2000, 1, 1).addDays(50000);
+        filter.to = filter.from.addDays(days);
+    }
+    filter.use_min_amount = min_cents >= 0;
+    filter.min_amount = Money::from_cents(min_cents);
+    filter.use_max_amount = max_cents >= 0;
+    filter.max_amount = Money::from_cents(max_cents);
+    SearchHits hits;
+    bool truncated = false;
+    bool result = false;
+    QBENCHMARK{
+        result = TransactionSearch::find(db->database(), logger, filter, 500, hits, truncated);
+    }
+    QVERIFY(result);
+    QVERIFY(!hits.isEmpty());
+}
+
+void LedgerBenchmark::add_profiles(){
+    QTest::addColumn<int>("profile");
+    QTest::newRow("safe") << int(DatabaseManager::SAFE);
+    QTest::newRow("fast ingest") << int(DatabaseManager::FAST_INGEST);
+}
+
+void LedgerBenchmark::profile_insert_data(){
+    add_profiles();
+}
+
+/*
+ * 1000 single row commits (every commit pays for the profile's syncs) then 100k rows in one transaction,
+ * into a fresh database per profile.
+*/
+void LedgerBenchmark::profile_insert(){
+    QFETCH(int, profile);
+    QString name = "profile_insert_" + QString::number(profile);
+    QFile::remove(dir.path() + "/" + name + ".db");
+    DatabaseManager db(logger, dir.path() + "/" + name + ".db", name);
+    db.set_profile(DatabaseManager::Profile(profile));
+    QVERIFY(db.open() && db.ensure_schema());
+    QSqlQuery & add_transaction_qry = db.prepared(DatabaseManager::INSERT_TRANSACTION);
+    add_transaction_qry.bindValue(":account", DatabaseManager::DEFAULT_ACCOUNT);
+    bool result = true;
+    QElapsedTimer timer;
+    QBENCHMARK_ONCE{
+        timer.start();
+        for(int i = 0; i < 1000; i++){
+            add_transaction_qry.bindValue(":desc", "Commit " + QString::number(i));
+            add_transaction_qry.bindValue(":mode", "Deposit");
+            add_transaction_qry.bindValue(":trans_amount", 100);
+            add_transaction_qry.bindValue(":balance", (i + 1) * 100);
+            add_transaction_qry.bindValue(":date", QDate(2000, 1, 1).addDays(i));
+            result = db.exec(DatabaseManager::INSERT_TRANSACTION) && result;
+        }
+        qint64 commit_ns = timer.nsecsElapsed();
+        timer.start();
+        db.database().transaction();
+        for(int i = 0; i < 100000; i++){
+            add_transaction_qry.bindValue(":desc", "Bulk " + QString::number(i));
+            add_transaction_qry.bindValue(":mode", "Deposit");
+            add_transaction_qry.bindValue(":trans_amount", 100);
+            add_transaction_qry.bindValue(":balance", (i + 1001) * 100);
+            add_transaction_qry.bindValue(":date", QDate(2003, 1, 1).addDays(i / 10));
+            result = db.exec(DatabaseManager::INSERT_TRANSACTION) && result;
+        }
+        result = db.database().commit() && result;
+        qint64 bulk_ns = timer.nsecsElapsed();
+        qDebug() << DatabaseManager::profile_name(DatabaseManager::Profile(profile))
+                 << "single row commits:" << qRound(1000 / (commit_ns / 1e9)) << "rows/s,"
+                 << "bulk:" << qRound(100000 / (bulk_ns / 1e9)) << "rows/s";
+    }
+    QVERIFY(result);
+}
+
+/*
+ * Not timed: lines dated before an accepted line of the same input are rejected, so the chained balances
+ * stay in ledger order and the ingested ledger verifies.
+*/
+void LedgerBenchmark::ingest_order(){
+    QFile::remove(dir.path() + "/ingest_order.db");
+    DatabaseManager db(logger, dir.path() + "/ingest_order.db", "ingest_order");
+    QVERIFY(db.open() && db.ensure_schema());
+    QByteArray lines("2000-01-05,Deposit,100.00,first\n"
+                     "2000-01-03,Deposit,50.00,before the first\n"
+                     "2000-01-05,Withdraw,20.00,same day\n"
+                     "01/04/2000,Deposit,10.00,before the first again\n"
+                     "2000-01-06,Deposit,5.00,last\n");
+    QBuffer input(&lines);
+    QVERIFY(input.open(QIODevice::ReadOnly));
+    QString error_text;
+    QTextStream errors(&error_text);
+    BatchIngestor ingestor(logger, &db);
+    QVERIFY(ingestor.ingest(&input, errors));
+    QCOMPARE(ingestor.rows_inserted(), qint64(3));
+    QCOMPARE(ingestor.rows_rejected(), qint64(2));
+    LedgerCache cache;
+    QVERIFY(cache.load(db.database(), DatabaseManager::DEFAULT_ACCOUNT, logger));
+    BalanceVerifier verifier;
+    QCOMPARE(verifier.verify(cache), 0);
+    QCOMPARE(cache.total().to_cents(), qint64(8500));
+}
+
+void LedgerBenchmark::profile_scan_data(){
+    add_profiles();
+}
+
+/*
+ * Full table scan of the 1M row ledger through a connection opened with the profile.
+*/
+void LedgerBenchmark::profile_scan(){
+    QFETCH(int, profile);
+    ledger(1000000);
+    QString name = "profile_scan_" + QString::number(profile);
+    DatabaseManager db(logger, dir.path() + "/ledger_1000000.db", name);
+    db.set_profile(DatabaseManager::Profile(profile));
+    QVERIFY(db.open());
+    QSqlQuery scan_qry(db.database());
+    scan_qry.setForwardOnly(true);
+    QVERIFY(scan_qry.prepare("SELECT count(*), SUM(trans_amount) FROM transactions NOT INDEXED WHERE description LIKE '%9%';"));
+    qint64 matches = 0;
+    QBENCHMARK{
+        scan_qry.exec();
+        if(scan_qry.next()) matches = scan_qry.value(0).toLongLong();
+        scan_qry.finish();
+    }
+    QVERIFY(matches > 0);
+}
+
+/*
+ * Cost of one ScopedTimer, what every instrumented call pays on top of its own work.
+*/
+void LedgerBenchmark::metrics_overhead(){
+    QBENCHMARK{
+        ScopedTimer timer("benchmark.metrics_overhead");
+    }
+}
+
+/*
+ * Results go to benchmark_results.xml (and the console) unless an output was given on the command line.
+*/
+int main(int argc, char *argv[])
+{
+    QApplication app(argc, argv);
+    LedgerBenchmark benchmark;
+    QStringList args = app.arguments();
+    if(!args.contains("-o")) args << "-o" << "benchmark_results.xml,xml" << "-o" << "-,txt";
+    return QTest::qExec(&benchmark, args);
+}
+
+#include "tst_ledgerbenchmark.moc"
@@ -1,9 +1,79 @@
 #include "mainwindow.h"
+#include "BatchIngestor.h"
 #include <QApplication>
+#include <QCoreApplication>
+#include <QFile>
+#include <QTextStream>
+
+/*
+ * Headless mode: Money-Management-Qt --ingest [file] [--account id]
+ * Reads transactions from the file (or stdin when no file is given) into the account (the default account when
+ * none is given), commits them in batches and prints throughput stats. No window is created. The connection uses the fast ingest profile (no syncs), a crash
+ * mid-ingest can lose the last batches, so the input should be kept until the ingest completes.
+*/
+int ingest(int argc, char *argv[], int ingest_arg)
+{
+    QCoreApplication a(argc, argv);
+    QTextStream out(stdout);
+    QTextStream errors(stderr);
+    QStringList args = a.arguments();
+
+    qint64 account = DatabaseManager::DEFAULT_ACCOUNT;
+    int account_arg = args.indexOf("--account");
+    if(account_arg >= 0){
+        bool ok = account_arg + 1 < args.size();
+        if(ok) account = args[account_arg + 1].toLongLong(&ok);
+        if(!ok){
+            errors << "--account needs an account id" << endl;
+            return 1;
+        }
+        args.erase(args.begin() + account_arg, args.begin() + account_arg + 2);
+        if(account_arg < ingest_arg) ingest_arg -= 2;
+    }
+
+    QFile input;
+    bool opened;
+    if(ingest_arg + 1 < args.size()){
+        input.setFileName(args[ingest_arg + 1]);
+        opened = input.open(QFile::ReadOnly);
+    }else{
+        opened = input.open(stdin, QFile::ReadOnly);
+    }
+    if(!opened){
+        errors << "Error opening " << (input.fileName().isEmpty() ? QString("stdin") : input.fileName()) << endl;
+        return 1;
+    }
+
+    Logger logger;
+    DatabaseManager db(&logger, DatabaseManager::default_path());
+    db.set_profile(DatabaseManager::FAST_INGEST);
+    if(!db.open() || !db.ensure_schema()){
+        errors << "Error opening database " << DatabaseManager::default_path() << endl;
+        return 1;
+    }
+    QSqlQuery account_qry(db.database());
+    account_qry.prepare("SELECT 1 FROM accounts WHERE id = :account;");
+    account_qry.bindValue(":account", account);
+    if(!account_qry.exec() || !account_qry.next()){
+        errors << "There is no account " << account << endl;
+        return 1;
+    }
+    account_qry.finish();
+    BatchIngestor ingestor(&logger, &db, account);
+    bool result = ingestor.ingest(&input, errors);
+    out << ingestor.summary() << endl;
+    return result ? 0 : 1;
+}
 
 int main(int argc, char *argv[])
 {
+    for(int i = 1; i < argc; i++){
+        if(QString(argv[i]) == "--ingest") return ingest(argc, argv, i);
+    }
     QApplication a(argc, argv);
+    //where QSettings keeps the backup settings
+    a.setOrganizationName("Money-Management-Qt");
+    a.setApplicationName("Money-Management-Qt");
     MainWindow w;
     w.show();
 
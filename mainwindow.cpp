@@ -5,18 +5,32 @@
 #include <QMessageBox>
 #include <QFileInfo>
 #include <QFileDialog>
+#include <QInputDialog>
 #include <QTextStream>
 #include <QTableView>
+#include <QHeaderView>
 #include <QVector>
 #include <QStandardPaths>
+#include <QProgressDialog>
+#include <QThread>
+#include "SqlExporter.h"
+#include "SnapshotExporter.h"
+#include "LedgerSnapshot.h"
+#include "Metrics.h"
 
 //# of ms to display messages in status bar for.
 #define MESSAGE_DISPLAY_LENGTH 4000
+//# of rows sampled to size the columns of the view all transactions window.
+#define COLUMN_SAMPLE_SIZE 100
+//ms from the window being constructed to accepting input, a slower startup is logged as a warning.
+#define STARTUP_BUDGET_MS 1000
 
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
     ui(new Ui::MainWindow)
 {
+    startup_timer.start();
+    last_phase_ms = 0;
 //    QString app_data_path = QDir::fromNativeSeparators(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation));
     QString app_data_path = QDir::fromNativeSeparators(QStandardPaths::writableLocation(QStandardPaths::ApplicationsLocation));
     QFileInfo app_data_folder(app_data_path);
@@ -35,112 +49,322 @@ MainWindow::MainWindow(QWidget *parent) :
     ui->comboBoxMode->setCurrentIndex(-1);
     //only allow valid doubles for the deposit/withdrawal amt.
     ui->lineEditDepWithdr->setValidator(new QDoubleValidator(1, 10000000, 2, ui->lineEditDepWithdr));
+    ui->tableWidgetPending->verticalHeader()->setVisible(false);
+    ui->tableWidgetPending->horizontalHeader()->setStretchLastSection(true);
     //the directory where the database lives.
-//    db_path = QDir::fromNativeSeparators(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/transaction_db.db");
-    db_path = QDir::fromNativeSeparators(QStandardPaths::writableLocation(QStandardPaths::ApplicationsLocation) + "/transaction_db.db");
+    db_path = DatabaseManager::default_path();
     logger->log(Logger::DEBUG, "DB Path: " + db_path);
     //init objects.
+    db = NULL;
     edit_trans_model = NULL;
+    edit_row = -1;
+    edit_reselects = false;
     edit_trans_view = NULL;
     view_all_transactions_model = NULL;
     view_all_transactions_view = NULL;
+    reports_view = NULL;
+    search_view = NULL;
+    diagnostics_view = NULL;
+    searcher = NULL;
+    search_thread = NULL;
+    backup = NULL;
+    backup_thread = NULL;
+    backup_timer = NULL;
+    maintenance = NULL;
+    maintenance_thread = NULL;
+    idle_timer = NULL;
+    maintenance_running = false;
+    maintenance_due = false;
+    after_backup = NO_PENDING_ACTION;
+    monthly_report = NULL;
+    yearly_report = NULL;
+    db_worker = NULL;
+    db_thread = NULL;
+    account = DatabaseManager::DEFAULT_ACCOUNT;
+    status_label = new QLabel(this);
+    ui->statusBar->addPermanentWidget(status_label);
+    startup_phase("window built");
+    show_last_known_balance();
     //sets up the database
     setup_database();
-    
-    //query database to get last transaction's balance and set the total label.
-    double last_balance = get_last_transaction_balance();
-    ui->labelTotal->setText("Total: " + format.toCurrencyString(last_balance));
-    logger->log(Logger::DEBUG, "Setting initial total to: " + format.toCurrencyString(last_balance));
-}
-
-double MainWindow::get_last_transaction_balance(){
-    //queries the database for the last known balance and sets the total label accordingly.
-    open_database();
-    double result = 0;
-    QSqlQuery qry = transaction_db.exec("SELECT balance FROM transactions ORDER BY id DESC LIMIT 1;");
-    logger->log(Logger::DEBUG, "Get last transaction balance qry", qry.lastError().text());
-    if(qry.next()){
-        result = qry.value(0).toDouble();
-    }else{
-        result = 0;
+    startup_phase("workers started");
+    QTimer::singleShot(0, this, SLOT(window_shown()));
+}
+
+/*
+ * Startup phases are logged with the time since the window started being built and since the last phase.
+*/
+void MainWindow::startup_phase(QString phase){
+    qint64 elapsed = startup_timer.elapsed();
+    Metrics::instance().add_time("startup." + phase, startup_timer.nsecsElapsed());
+    logger->log(Logger::INFO, QString("Startup: %1 at %2 ms (+%3 ms)").arg(phase).arg(elapsed).arg(elapsed - last_phase_ms));
+    last_phase_ms = elapsed;
+}
+
+void MainWindow::window_shown(){
+    startup_phase("window shown");
+}
+
+/*
+ * The total is painted before the worker is up, from the account's metadata row: one read on the connection
+ * the models use later anyway. A database that doesn't exist yet is left to the worker to create.
+*/
+void MainWindow::show_last_known_balance(){
+    if(!QFileInfo(db_path).exists()) return;
+    db = new DatabaseManager(logger, db_path);
+    Money balance;
+    if(db->open() && db->last_known_balance(account, balance)){
+        set_total(balance);
+        startup_phase("last known total shown");
     }
-    close_database();
-    return result;
 }
 
 //free memory
 MainWindow::~MainWindow()
 {
     logger->log(Logger::DEBUG, "freeing memory");
+    //lets the request in progress (if any) finish, the worker is deleted on its own thread as it stops
+    db_thread->quit();
+    db_thread->wait();
+    search_thread->quit();
+    search_thread->wait();
+    //a backup in progress is abandoned, its partial file is removed
+    backup->cancel();
+    backup_thread->quit();
+    backup_thread->wait();
+    //a maintenance slice in progress stops after its current step, the next cycle starts over
+    maintenance->cancel();
+    maintenance_thread->quit();
+    maintenance_thread->wait();
+    delete db;
     delete logger;
     delete ui;
 }
 
 /*
  * Sets up the sqlite database
- * creates db file if doesn't exist, and creates the necessary table(s)
+ * Writes go through the DB worker on its own thread w/ its own connection, it creates the db file and the
+ * necessary table(s). The GUI thread keeps a second connection for the transaction windows' models.
+ * Both connections stay open until the window is destroyed.
  * 
 */
 void MainWindow::setup_database(){
     logger->log(Logger::DEBUG, "Setting up database");
-    transaction_db = QSqlDatabase::addDatabase("QSQLITE");
-    transaction_db.setDatabaseName(db_path);
     QFileInfo db_info(db_path);
-    bool exists = db_info.exists();
-    logger->log(Logger::DEBUG, "Database exists: " + (exists ? QString("True") : QString("False")));    
-    bool status = transaction_db.open();
-    logger->log(Logger::DEBUG, "Database open status: " + (status ? QString("True") : QString("False")));        
-    if(!status){
+    logger->log(Logger::DEBUG, "Database exists: " + (db_info.exists() ? QString("True") : QString("False")));
+    qRegisterMetaType<Money>("Money");
+    qRegisterMetaType<PendingTransactions>("PendingTransactions");
+    qRegisterMetaType<Accounts>("Accounts");
+    qRegisterMetaType<ReportPeriods>("ReportPeriods");
+    qRegisterMetaType<SearchFilter>("SearchFilter");
+    qRegisterMetaType<SearchHits>("SearchHits");
+    db_thread = new QThread(this);
+    db_worker = new DatabaseWorker(logger, db_path);
+    db_worker->moveToThread(db_thread);
+    connect(db_thread, SIGNAL(finished()), db_worker, SLOT(deleteLater()));
+    connect(this, SIGNAL(open_requested(qint64)), db_worker, SLOT(open(qint64)));
+    connect(this, SIGNAL(account_select_requested(qint64)), db_worker, SLOT(select_account(qint64)));
+    connect(this, SIGNAL(account_add_requested(QString)), db_worker, SLOT(add_account(QString)));
+    connect(this, SIGNAL(submit_requested(qint64,PendingTransactions)), db_worker, SLOT(submit(qint64,PendingTransactions)));
+    connect(this, SIGNAL(import_requested(qint64,QString)), db_worker, SLOT(import_file(qint64,QString)));
+    connect(this, SIGNAL(delete_requested(qint64)), db_worker, SLOT(delete_all(qint64)));
+    connect(this, SIGNAL(mode_edit_requested(qint64,qint64,QString)), db_worker, SLOT(set_mode(qint64,qint64,QString)));
+    connect(this, SIGNAL(amount_edit_requested(qint64,qint64,Money)), db_worker, SLOT(set_amount(qint64,qint64,Money)));
+    connect(this, SIGNAL(date_edit_requested(qint64,qint64,QDate)), db_worker, SLOT(set_date(qint64,qint64,QDate)));
+    connect(this, SIGNAL(reports_requested(qint64)), db_worker, SLOT(build_reports(qint64)));
+    connect(this, SIGNAL(verify_requested(qint64,bool)), db_worker, SLOT(verify(qint64,bool)));
+    connect(db_worker, SIGNAL(opened(bool,Accounts,qint64,Money)), this, SLOT(database_opened(bool,Accounts,qint64,Money)));
+    connect(db_worker, SIGNAL(account_selected(qint64,Money)), this, SLOT(account_selected(qint64,Money)));
+    connect(db_worker, SIGNAL(account_added(bool,QString,Accounts,qint64)), this, SLOT(account_added(bool,QString,Accounts,qint64)));
+    connect(db_worker, SIGNAL(submitted(int,int,Money)), this, SLOT(transaction_submitted(int,int,Money)));
+    connect(db_worker, SIGNAL(imported(bool,QString,Money)), this, SLOT(import_finished(bool,QString,Money)));
+    connect(db_worker, SIGNAL(deleted(bool)), this, SLOT(delete_finished(bool)));
+    connect(db_worker, SIGNAL(transaction_edited(bool,QString,qint64,Money,Money)), this, SLOT(edit_finished(bool,QString,qint64,Money,Money)));
+    connect(db_worker, SIGNAL(reports_built(bool,ReportPeriods,ReportPeriods)), this, SLOT(reports_built(bool,ReportPeriods,ReportPeriods)));
+    connect(db_worker, SIGNAL(verified(bool,QString,QString,int,bool,Money)), this, SLOT(balances_verified(bool,QString,QString,int,bool,Money)));
+    db_thread->start();
+    search_thread = new QThread(this);
+    searcher = new TransactionSearch(logger, db_path);
+    searcher->moveToThread(search_thread);
+    connect(search_thread, SIGNAL(finished()), searcher, SLOT(deleteLater()));
+    connect(this, SIGNAL(search_open_requested()), searcher, SLOT(open()));
+    search_thread->start();
+    backup_thread = new QThread(this);
+    backup = new DatabaseBackup(logger, db_path);
+    backup->moveToThread(backup_thread);
+    connect(backup_thread, SIGNAL(finished()), backup, SLOT(deleteLater()));
+    connect(this, SIGNAL(backup_requested(QString)), backup, SLOT(run(QString)));
+    connect(backup, SIGNAL(finished(bool,QString,QString,QString)), this, SLOT(backup_finished(bool,QString,QString,QString)));
+    backup_thread->start();
+    backup_timer = new QTimer(this);
+    connect(backup_timer, SIGNAL(timeout()), this, SLOT(scheduled_backup()));
+    maintenance_thread = new QThread(this);
+    maintenance = new DatabaseMaintenance(logger, db_path);
+    maintenance->moveToThread(maintenance_thread);
+    connect(maintenance_thread, SIGNAL(finished()), maintenance, SLOT(deleteLater()));
+    connect(this, SIGNAL(maintenance_requested()), maintenance, SLOT(run_slice()));
+    connect(maintenance, SIGNAL(slice_finished()), this, SLOT(maintenance_slice_finished()));
+    connect(maintenance, SIGNAL(finished(bool,QString)), this, SLOT(maintenance_finished(bool,QString)));
+    maintenance_thread->start();
+    idle_timer = new QTimer(this);
+    idle_timer->setSingleShot(true);
+    idle_timer->setInterval(DatabaseMaintenance::idle_seconds() * 1000);
+    connect(idle_timer, SIGNAL(timeout()), this, SLOT(idle()));
+
+    //nothing can be entered until the worker has the schema and the account ready
+    set_inputs_enabled(false);
+    request_started("Connecting");
+    emit open_requested(account);
+}
+
+/*
+ * Called on the GUI thread once the worker has opened (and if necessary created/migrated) the database and
+ * loaded the account, the window is usable from here on.
+*/
+void MainWindow::database_opened(bool success, Accounts accounts, qint64 loaded, Money balance){
+    request_finished("Connecting");
+    if(success){
+        if(db == NULL) db = new DatabaseManager(logger, db_path);
+        success = db->open();
+    }
+    if(!success){
         logger->log(Logger::CRITICAL, "Failed to open database");            
         ui->statusBar->showMessage("Error connecting to database", MESSAGE_DISPLAY_LENGTH);
         QMessageBox::critical(this, "Error Connecting To Database", "Error opening database, please restart the program");
-        ui->lineEditDepWithdr->setEnabled(false);
-        ui->lineEditDescription->setEnabled(false);
-        ui->pushButtonSubmit->setEnabled(false);
-        ui->comboBoxMode->setEnabled(false);
-        ui->dateEdit->setEnabled(false);
-        ui->menuBar->setEnabled(false);
         return;
     }
     logger->log(Logger::DEBUG, "Succcessfully connected");
     ui->statusBar->showMessage("Connected...", MESSAGE_DISPLAY_LENGTH);
-    if(!exists){
-        logger->log(Logger::DEBUG, "Creating transaction table");
-        QSqlQuery create_transaction_table_qry = transaction_db.exec("CREATE TABLE transactions(id INTEGER PRIMARY KEY AUTOINCREMENT, description TEXT, mode TEXT, trans_amount DOUBLE, balance DOUBLE, date_added DATE);");
-        logger->log(Logger::DEBUG, "Create trans table qry" ,create_transaction_table_qry.lastError().text());
+    account = loaded;
+    set_accounts(accounts);
+    emit search_open_requested();
+    if(DatabaseBackup::interval_minutes() > 0) backup_timer->start(DatabaseBackup::interval_minutes() * 60 * 1000);
+    set_inputs_enabled(true);
+    set_total(balance);
+    startup_phase("interactive");
+    if(startup_timer.elapsed() > STARTUP_BUDGET_MS){
+        logger->log(Logger::WARNING, "Startup took " + QString::number(startup_timer.elapsed()) + " ms, over the " + QString::number(STARTUP_BUDGET_MS) + " ms budget");
+    }
+}
+
+void MainWindow::set_accounts(const Accounts & accounts){
+    ui->comboBoxAccount->clear();
+    for(int i = 0; i < accounts.size(); i++){
+        ui->comboBoxAccount->addItem(accounts[i].name, accounts[i].id);
+    }
+    int index = ui->comboBoxAccount->findData(account);
+    if(index < 0 && !accounts.isEmpty()){
+        index = 0;
+        account = accounts[0].id;
     }
-    close_database();
+    ui->comboBoxAccount->setCurrentIndex(index);
 }
 
 /*
- * Opens the database for reading/writing.
+ * Pending transactions were checked against the old account's balance, so they are dropped on a switch.
+ * The windows are pointed at the new account right away, the balance follows with the worker's answer.
 */
-bool MainWindow::open_database(){
-    bool status = transaction_db.open();
-    if(status){
-        logger->log(Logger::DEBUG, "Connected to database");
-        ui->statusBar->showMessage("Connected...", MESSAGE_DISPLAY_LENGTH);
-    }else{
-        logger->log(Logger::CRITICAL, "Error opening database");
-        ui->statusBar->showMessage("Error connecting to database", MESSAGE_DISPLAY_LENGTH);
-        QMessageBox::critical(this, "Error Connecting To Database", "Error opening database, please restart the program");
-        ui->lineEditDepWithdr->setEnabled(false);
-        ui->lineEditDescription->setEnabled(false);
-        ui->pushButtonSubmit->setEnabled(false);
-        ui->comboBoxMode->setEnabled(false);
-        ui->dateEdit->setEnabled(false);
-        ui->menuBar->setEnabled(false);
+void MainWindow::on_comboBoxAccount_activated(int index){
+    qint64 selected = ui->comboBoxAccount->itemData(index).toLongLong();
+    if(selected == account) return;
+    if(!pending.isEmpty()){
+        int choice = QMessageBox::question(this, "Discard pending transactions?", "The pending transactions haven't been saved and will be discarded, switch accounts anyway?");
+        if(choice != QMessageBox::Yes){
+            ui->comboBoxAccount->setCurrentIndex(ui->comboBoxAccount->findData(account));
+            return;
+        }
+        pending.clear();
+    }
+    logger->log(Logger::DEBUG, "Switching to account " + QString::number(selected));
+    account = selected;
+    account_changed();
+    set_inputs_enabled(false);
+    request_started("Loading account");
+    emit account_select_requested(account);
+}
+
+/*
+ * Called on the GUI thread with the selected account's balance.
+*/
+void MainWindow::account_selected(qint64 selected, Money balance){
+    request_finished("Loading account");
+    if(selected != account) return;
+    set_inputs_enabled(true);
+    set_total(balance);
+    logger->log(Logger::DEBUG, "Account " + QString::number(account) + " total: " + balance.to_currency(format));
+}
+
+void MainWindow::account_changed(){
+    if(view_all_transactions_model != NULL) view_all_transactions_model->set_account(account);
+    if(search_view != NULL) search_view->set_account(account);
+    if(edit_trans_model != NULL){
+        disconnect(edit_trans_model, SIGNAL(dataChanged(QModelIndex,QModelIndex)), this, SLOT(record_changed(QModelIndex,QModelIndex)));
+        edit_trans_model->revertAll();
+        edit_trans_model->setFilter("account_id = " + QString::number(account));
+        edit_trans_model->select();
+        connect(edit_trans_model, SIGNAL(dataChanged(QModelIndex,QModelIndex)), this, SLOT(record_changed(QModelIndex,QModelIndex)));
     }
-    return status;
+    if(reports_view != NULL && reports_view->isVisible()) request_reports();
+}
+
+void MainWindow::on_pushButtonNewAccount_clicked()
+{
+    bool ok = false;
+    QString name = QInputDialog::getText(this, "New Account", "Account name:", QLineEdit::Normal, QString(), &ok);
+    if(!ok || name.trimmed().isEmpty()) return;
+    request_started("Adding account");
+    emit account_add_requested(name);
 }
 
 /*
- * Closes the database
+ * Called on the GUI thread once the worker has created the account, it becomes the current account.
 */
-void MainWindow::close_database(){
-    //  bool status = transaction_db.commit();
-    logger->log(Logger::DEBUG, "Closing database");
-    if(transaction_db.isOpen()) transaction_db.close();
+void MainWindow::account_added(bool success, QString message, Accounts accounts, qint64 added){
+    request_finished("Adding account");
+    if(!success){
+        QMessageBox::warning(this, "Error", message);
+        return;
+    }
+    set_accounts(accounts);
+    int index = ui->comboBoxAccount->findData(added);
+    ui->comboBoxAccount->setCurrentIndex(index);
+    on_comboBoxAccount_activated(index);
+}
+
+void MainWindow::set_inputs_enabled(bool enabled){
+    ui->lineEditDepWithdr->setEnabled(enabled);
+    ui->lineEditDescription->setEnabled(enabled);
+    set_pending_enabled(enabled);
+    ui->tableWidgetPending->setEnabled(enabled);
+    ui->comboBoxMode->setEnabled(enabled);
+    ui->dateEdit->setEnabled(enabled);
+    ui->menuBar->setEnabled(enabled);
+    ui->comboBoxAccount->setEnabled(enabled && requests_in_flight.isEmpty());
+    ui->pushButtonNewAccount->setEnabled(enabled);
+}
+
+void MainWindow::set_total(Money balance){
+    committed_balance = balance;
+    ui->labelTotal->setText("Total: " + balance.to_currency(format));
+    refresh_pending_view();
+}
+
+/*
+ * Requests in flight are listed in the status bar until the worker answers.
+ * Their answers are for the account they were sent for, so the account can't change until they are all in.
+*/
+void MainWindow::request_started(QString operation){
+    idle_timer->start();
+    requests_in_flight.append(operation);
+    status_label->setText(requests_in_flight.join(", ") + "...");
+    ui->comboBoxAccount->setEnabled(false);
+}
+
+void MainWindow::request_finished(QString operation){
+    idle_timer->start();
+    requests_in_flight.removeOne(operation);
+    status_label->setText(requests_in_flight.isEmpty() ? QString() : requests_in_flight.join(", ") + "...");
+    ui->comboBoxAccount->setEnabled(requests_in_flight.isEmpty() && ui->menuBar->isEnabled());
 }
 
 
@@ -149,75 +373,159 @@ void MainWindow::on_actionAbout_triggered()
 }
 
 /*
- * Triggered when the user is adding a new transaction
+ * Triggered when the user stages the transaction in the form
  * Checks to make sure an amount, mode and description were provided, otherwise throws error
- * Checks to make sure a withdrawal is not more than the current balance
- * Adds the transaction to the database if all is well
- * 
+ * Checks to make sure a withdrawal is not more than the balance after the pending transactions
+ * Adds the transaction to the pending list if all is well, nothing is written yet
+*/
+void MainWindow::on_pushButtonAdd_clicked()
+{
+    stage_form_entry();
+}
+
+bool MainWindow::stage_form_entry(){
+    PendingTransaction transaction;
+    transaction.description = ui->lineEditDescription->text();
+    transaction.mode = ui->comboBoxMode->currentText();
+    transaction.amount = Money::from_string(ui->lineEditDepWithdr->text());
+    transaction.date = ui->dateEdit->date();
+    Money balance = pending_balance();
+    switch(LedgerEngine::apply_transaction(transaction.description, transaction.mode, transaction.amount, balance)){
+    case LedgerEngine::INVALID_INPUT:
+        QMessageBox::critical(this, "Invalid Input", "Please provide a description, amount and if this transaction is a deposit or withdrawal.");
+        logger->log(Logger::DEBUG, "Invalid Input\nAmount: " + transaction.amount.to_string() + " Description: " + transaction.description + " Mode: " + transaction.mode);
+        return false;
+    case LedgerEngine::INSUFFICIENT_FUNDS:
+        QMessageBox::information(this, "Insufficient Funds", "There is not enough money to withdraw " + transaction.amount.to_currency(format));
+        return false;
+    case LedgerEngine::VALID:
+        break;
+    }
+    pending.append(transaction);
+    ui->lineEditDepWithdr->setText("");
+    ui->lineEditDescription->setText("");
+    ui->comboBoxMode->setCurrentIndex(-1);
+    ui->lineEditDescription->setFocus();
+    refresh_pending_view();
+    logger->log(Logger::DEBUG, transaction.mode + " " + transaction.amount.to_string() + " staged, pending balance " + balance.to_string());
+    return true;
+}
+
+/*
+ * The rows after the removed ones are re-checked, removing a deposit that a later withdrawal depends on is refused.
+*/
+void MainWindow::on_pushButtonRemovePending_clicked()
+{
+    QModelIndexList selected = ui->tableWidgetPending->selectionModel()->selectedRows();
+    if(selected.isEmpty()) return;
+    QVector<bool> removed(pending.size(), false);
+    for(int i = 0; i < selected.size(); i++){
+        removed[selected[i].row()] = true;
+    }
+    PendingTransactions remaining;
+    Money balance = committed_balance;
+    for(int i = 0; i < pending.size(); i++){
+        if(removed[i]) continue;
+        if(LedgerEngine::apply_transaction(pending[i].description, pending[i].mode, pending[i].amount, balance) != LedgerEngine::VALID){
+            QMessageBox::information(this, "Insufficient Funds", "Removing the selected transaction(s) would leave not enough money to withdraw " + pending[i].amount.to_currency(format));
+            return;
+        }
+        remaining.append(pending[i]);
+    }
+    pending = remaining;
+    refresh_pending_view();
+}
+
+/*
+ * Triggered when the user is saving transactions
+ * A filled in form is staged first, then every pending transaction is sent to the worker, which checks them
+ * against the saved balance again and saves them all in one sql transaction.
 */
 void MainWindow::on_pushButtonSubmit_clicked()
 {
-    QString description = ui->lineEditDescription->text();
-    QString mode = ui->comboBoxMode->currentText();
-    double amount = ui->lineEditDepWithdr->text().toDouble();
-    
-    if(amount == 0 || description == "" || mode == ""){
+    bool form_filled = !ui->lineEditDescription->text().isEmpty() || !ui->lineEditDepWithdr->text().isEmpty();
+    if(form_filled && !stage_form_entry()) return;
+    if(pending.isEmpty()){
         QMessageBox::critical(this, "Invalid Input", "Please provide a description, amount and if this transaction is a deposit or withdrawal.");
-        logger->log(Logger::DEBUG, "Invalid Input\nAmount: " + QString::number(amount) + " Description: " + description + " Mode: " + mode);
         return;
     }
-    double last_balance = get_last_transaction_balance();
-    
-    if(!open_database()){
-        QMessageBox::critical(this, "Error Saving Transaction", "Error saving the transaction, please try again");
-        logger->log(Logger::CRITICAL, "Error opening database to save new transaction (submit btn). Transaction not saved");
+    //the pending list is frozen until the worker answers
+    set_pending_enabled(false);
+    request_started("Saving " + QString::number(pending.size()) + " transaction(s)");
+    submit_timer.start();
+    emit submit_requested(account, pending);
+}
+
+/*
+ * Called on the GUI thread with the worker's answer to a submit.
+*/
+void MainWindow::transaction_submitted(int result, int row, Money balance){
+    Metrics::instance().add_time("gui.submit_roundtrip", submit_timer.nsecsElapsed());
+    request_finished("Saving " + QString::number(pending.size()) + " transaction(s)");
+    set_pending_enabled(true);
+    set_total(balance);
+    switch(result){
+    case DatabaseWorker::INVALID_INPUT:
+        QMessageBox::critical(this, "Invalid Input", "Pending transaction " + QString::number(row + 1) + " is missing a description, amount or mode, nothing was saved.");
+        return;
+    case DatabaseWorker::INSUFFICIENT_FUNDS:
+        QMessageBox::information(this, "Insufficient Funds", "There is not enough money to withdraw " + pending[row].amount.to_currency(format) + " (pending transaction " + QString::number(row + 1) + "), nothing was saved.");
+        return;
+    case DatabaseWorker::SAVE_FAILED:
+        ui->statusBar->showMessage("Error saving transactions", MESSAGE_DISPLAY_LENGTH);
+        logger->log(Logger::CRITICAL, "Error saving transactions");
         return;
     }
-    
-    
-    logger->log(Logger::DEBUG, "Last known balance (submit btn) " + QString::number(last_balance));
-    if(mode == "Deposit"){
-        logger->log(Logger::DEBUG, "Depositing " + QString::number(amount) + " to " + QString::number(last_balance));
-        last_balance += amount;
-    }else if(mode == "Withdraw"){
-        logger->log(Logger::DEBUG, "Withdrawing " + QString::number(amount) + " from " + QString::number(last_balance));        
-        if(last_balance - amount < 0){
-            qDebug() << "Can't withdraw " << amount << " from " << last_balance;
-            QMessageBox::information(this, "Insufficient Funds", "There is not enough money to withdraw " + format.toCurrencyString(amount));
-            return;
-        }
-        last_balance -= amount;
-    }
-    QSqlQuery add_transaction_qry;
-    add_transaction_qry.prepare("INSERT INTO transactions (description, mode, trans_amount, balance, date_added) VALUES (:desc, :mode, :trans_amount, :balance, :date);");
-    add_transaction_qry.bindValue(":desc", description);
-    add_transaction_qry.bindValue(":mode", mode);
-    add_transaction_qry.bindValue(":trans_amount", amount);
-    add_transaction_qry.bindValue(":balance", last_balance);
-    add_transaction_qry.bindValue(":date", ui->dateEdit->date());
-    bool result = add_transaction_qry.exec();
-    logger->log(Logger::DEBUG, "add transaction qry", add_transaction_qry.lastError().text());
-    if(result){
-        ui->statusBar->showMessage("Transaction saved", MESSAGE_DISPLAY_LENGTH);
-        ui->lineEditDepWithdr->setText("");
-        ui->lineEditDescription->setText("");
-        ui->comboBoxMode->setCurrentIndex(-1);
-        ui->pushButtonSubmit->setEnabled(false);
-        QTimer::singleShot(1750, this, SLOT(reenable_submit_btn()));
-        ui->labelTotal->setText("Total: " + format.toCurrencyString(last_balance));   
-        logger->log(Logger::DEBUG, "Transaction saved");
+    pending.clear();
+    refresh_pending_view();
+    ui->statusBar->showMessage(QString::number(row) + " transaction(s) saved", MESSAGE_DISPLAY_LENGTH);
+    transactions_changed();
+    logger->log(Logger::DEBUG, QString::number(row) + " transaction(s) saved");
+}
+
+Money MainWindow::pending_balance() const{
+    Money balance = committed_balance;
+    for(int i = 0; i < pending.size(); i++){
+        balance += LedgerEngine::signed_amount(pending[i].mode, pending[i].amount);
+    }
+    return balance;
+}
+
+/*
+ * Rebuilds the pending grid, each row shows the balance it leads to.
+*/
+void MainWindow::refresh_pending_view(){
+    ui->tableWidgetPending->setRowCount(pending.size());
+    Money balance = committed_balance;
+    for(int i = 0; i < pending.size(); i++){
+        balance += LedgerEngine::signed_amount(pending[i].mode, pending[i].amount);
+        ui->tableWidgetPending->setItem(i, 0, new QTableWidgetItem(pending[i].description));
+        ui->tableWidgetPending->setItem(i, 1, new QTableWidgetItem(pending[i].mode));
+        ui->tableWidgetPending->setItem(i, 2, new QTableWidgetItem(pending[i].amount.to_currency(format)));
+        ui->tableWidgetPending->setItem(i, 3, new QTableWidgetItem(pending[i].date.toString("MM/dd/yyyy")));
+        ui->tableWidgetPending->setItem(i, 4, new QTableWidgetItem(balance.to_currency(format)));
+    }
+    if(pending.isEmpty()){
+        ui->labelPending->setText("No pending transactions");
     }else{
-        ui->statusBar->showMessage("Error saving transaction", MESSAGE_DISPLAY_LENGTH);
-        logger->log(Logger::CRITICAL, "Error saving transaction");
+        ui->labelPending->setText(QString::number(pending.size()) + " pending, balance after: " + balance.to_currency(format));
     }
-    close_database();
+}
+
+void MainWindow::set_pending_enabled(bool enabled){
+    ui->pushButtonAdd->setEnabled(enabled);
+    ui->pushButtonSubmit->setEnabled(enabled);
+    ui->pushButtonRemovePending->setEnabled(enabled);
 }
 
 /*
- * This function re-enables the submit button after a specified amount of seconds to prevent from spamming the submit button.
- */
-void MainWindow::reenable_submit_btn(){
-    ui->pushButtonSubmit->setEnabled(true);
+ * Called after anything writes to the transactions table so cached views of it are brought up to date.
+*/
+void MainWindow::transactions_changed(){
+    if(view_all_transactions_model != NULL) view_all_transactions_model->refresh();
+    //the worker only recomputes what the write touched, so an open reports window can follow every change
+    if(reports_view != NULL && reports_view->isVisible()) request_reports();
+    if(search_view != NULL && search_view->isVisible()) search_view->refresh();
 }
 
 /*
@@ -235,7 +543,9 @@ void MainWindow::on_actionQuit_triggered()
  * Prompts user to quit, if yes checks to see if any other windows are open and deletes them.
 */
 void MainWindow::closeEvent(QCloseEvent* event){
-    int result = QMessageBox::question(NULL, "Quit?", "Are you sure you want to quit?");
+    QString question = "Are you sure you want to quit?";
+    if(!requests_in_flight.isEmpty()) question += "\n(" + requests_in_flight.join(", ") + " will finish first)";
+    int result = QMessageBox::question(NULL, "Quit?", question);
     if(result == QMessageBox::Yes){
         if(edit_trans_view != NULL){
             logger->log(Logger::DEBUG, "Closing edit trans view");
@@ -245,6 +555,18 @@ void MainWindow::closeEvent(QCloseEvent* event){
             logger->log(Logger::DEBUG, "Closing view trans view");            
             view_all_transactions_view->deleteLater();
         }
+        if(search_view != NULL){
+            logger->log(Logger::DEBUG, "Closing search view");
+            search_view->deleteLater();
+        }
+        if(diagnostics_view != NULL){
+            logger->log(Logger::DEBUG, "Closing diagnostics view");
+            diagnostics_view->deleteLater();
+        }
+        if(reports_view != NULL){
+            logger->log(Logger::DEBUG, "Closing reports view");
+            reports_view->deleteLater();
+        }
         logger->log(Logger::DEBUG, "Closing main window & quitting...");        
         event->accept();
     }else{
@@ -253,54 +575,60 @@ void MainWindow::closeEvent(QCloseEvent* event){
 }
 
 /*
- * Exports whatever is currently in the database to a file with a .sql extension
+ * Exports the account's transactions to a .sql file, or to a binary snapshot (smaller, faster to write and
+ * to import back)
  * Used for backups, etc.
  * User is prompted via a file dialog
 */
 void MainWindow::on_actionExport_triggered()
 {
-    QString filename = QFileDialog::getSaveFileName(this, tr("Export Database"), QDir::currentPath(), tr("Sql File (*.sql)"));
+    QString snapshot_filter = tr("Snapshot (*.") + LedgerSnapshot::suffix() + ")";
+    QString selected_filter;
+    QString filename = QFileDialog::getSaveFileName(this, tr("Export Database"), QDir::currentPath(), tr("Sql File (*.sql)") + ";;" + snapshot_filter, &selected_filter);
     if(!filename.isEmpty()){
-        open_database();
-        QSqlQuery transactions_exist_qry = transaction_db.exec("SELECT count(id) FROM transactions;");
-        logger->log(Logger::DEBUG, "transactions exist qry", transactions_exist_qry.lastError().text());
-        if(transactions_exist_qry.next()){
-            if(transactions_exist_qry.value(0) <=0){
-                logger->log(Logger::DEBUG, "There are no transactions to export");
-                QMessageBox::information(this, "No Transactions Exist", "There are no transactions to export, export cancelled");
-                return;
-            }
+        bool snapshot = selected_filter == snapshot_filter || QFileInfo(filename).suffix() == LedgerSnapshot::suffix();
+        if(snapshot && QFileInfo(filename).suffix() != LedgerSnapshot::suffix()) filename += "." + LedgerSnapshot::suffix();
+        //the export counts and streams the rows on its own thread w/ its own connection so the window stays responsive.
+        //both exporters have the same slots and signals.
+        QThread * export_thread = new QThread;
+        QObject * exporter;
+        if(snapshot){
+            exporter = new SnapshotExporter(logger, db_path, filename, account);
         }else{
-            logger->log(Logger::DEBUG, "There are no transactions to export");            
-            QMessageBox::information(this, "No Transactions Exist", "There are no transactions to export, export cancelled");
-            return;
-        }
-        logger->log(Logger::DEBUG, "transactions exist, continuing w/ export");        
-        QSqlQuery get_all_transactions_qry = transaction_db.exec("SELECT id, description, mode, trans_amount, balance, date_added FROM transactions;");
-        logger->log(Logger::DEBUG, "Get all transactions for export qry", get_all_transactions_qry.lastError().text());
-        int count = 0;
-        QFile export_file(filename);
-        if(!export_file.open(QFile::WriteOnly)){
-            logger->log(Logger::CRITICAL, "Error opening " + filename + " for export");
-            QMessageBox::information(this, "Error Opening File", "Error opening " + filename + " for export, please try again");
-            return;
-        }
-        export_file.write("PRAGMA foreign_keys=OFF;\n");
-        export_file.write("BEGIN TRANSACTION;\n");
-        export_file.write("CREATE TABLE transactions(id INTEGER PRIMARY KEY AUTOINCREMENT, description TEXT, mode TEXT, trans_amount DOUBLE, balance DOUBLE, date_added DATE);\n");
-        QString write_str;
-        while(get_all_transactions_qry.next()){
-            write_str = "INSERT INTO transactions (id, description, mode, trans_amount, balance, date_added) VALUES (" + get_all_transactions_qry.value(ID).toString() + ", '" + get_all_transactions_qry.value(DESCRIPTION).toString() + "', '" + get_all_transactions_qry.value(MODE).toString() + "', " + get_all_transactions_qry.value(TRANSACTION_AMOUNT).toString() + ", " + get_all_transactions_qry.value(BALANCE).toString() + ", '" + get_all_transactions_qry.value(DATE_ADDED).toString() + "');\n";
-            logger->log(Logger::DEBUG, "Writing " + write_str);
-            export_file.write(write_str.toUtf8());
-            count++;
+            exporter = new SqlExporter(logger, db_path, filename, account);
         }
-        export_file.write("COMMIT;");
-        QMessageBox::information(this, "Success", QString::number(count) + " transactions exported to " + filename);
-        logger->log(Logger::DEBUG, QString(count) + " transactions written to " + filename);
-        export_file.flush();
-        export_file.close();
-        close_database();
+        exporter->moveToThread(export_thread);
+        QProgressDialog * export_progress = new QProgressDialog("Exporting transactions...", "Cancel", 0, 100, this);
+        export_progress->setWindowTitle("Export Database");
+        export_progress->setWindowModality(Qt::WindowModal);
+        export_progress->setMinimumDuration(500);
+        export_progress->setAttribute(Qt::WA_DeleteOnClose);
+        connect(export_thread, SIGNAL(started()), exporter, SLOT(run()));
+        connect(exporter, SIGNAL(progress(int)), export_progress, SLOT(setValue(int)));
+        connect(export_progress, SIGNAL(canceled()), exporter, SLOT(cancel()), Qt::DirectConnection);
+        connect(exporter, SIGNAL(finished(bool,qint64,QString)), export_progress, SLOT(close()));
+        connect(exporter, SIGNAL(finished(bool,qint64,QString)), this, SLOT(export_finished(bool,qint64,QString)));
+        connect(exporter, SIGNAL(finished(bool,qint64,QString)), export_thread, SLOT(quit()));
+        connect(export_thread, SIGNAL(finished()), exporter, SLOT(deleteLater()));
+        connect(export_thread, SIGNAL(finished()), export_thread, SLOT(deleteLater()));
+        ui->actionExport->setEnabled(false);
+        request_started("Exporting");
+        export_thread->start();
+    }
+}
+
+/*
+ * Called on the GUI thread once the export thread is done.
+*/
+void MainWindow::export_finished(bool success, qint64 rows, QString message){
+    Q_UNUSED(rows);
+    request_finished("Exporting");
+    ui->actionExport->setEnabled(true);
+    ui->statusBar->showMessage(success ? "Export complete" : "Export failed", MESSAGE_DISPLAY_LENGTH);
+    if(success){
+        QMessageBox::information(this, "Success", message);
+    }else{
+        QMessageBox::information(this, "Export Failed", message);
     }
 }
 
@@ -310,66 +638,179 @@ void MainWindow::on_actionExport_triggered()
 */
 void MainWindow::on_actionImport_triggered()
 {
-    QString filename = QFileDialog::getOpenFileName(this, tr("Import Database"), QDir::currentPath(), tr("Sql File (*.sql)"));
+    QString filename = QFileDialog::getOpenFileName(this, tr("Import Database"), QDir::currentPath(), tr("Sql File (*.sql)") + ";;" + tr("Snapshot (*.") + LedgerSnapshot::suffix() + ")");
     if(!filename.isEmpty()){
-        
-        //@TODO -- auto backup the database? -- create backups folder...
-        int choice = QMessageBox::question(this, "Overwrite existing data?", "This action will overwrite any existing data, are you sure you want to continue?");
+        int choice = QMessageBox::question(this, "Overwrite existing data?", "This action will overwrite the transactions of " + ui->comboBoxAccount->currentText() + ", are you sure you want to continue?");
         if(choice == QMessageBox::Yes){
-            logger->log(Logger::DEBUG, "Overwriting database via import");
-            open_database();
-            QSqlQuery drop_table_qry = transaction_db.exec("DROP TABLE transactions;");
-            logger->log(Logger::DEBUG, "drop table for import qry", drop_table_qry.lastError().text());
-            QFile import_file(filename);
-            if(!import_file.open(QFile::ReadOnly)){
-                logger->log(Logger::CRITICAL, "Error opening " + filename + " for import");
-                QMessageBox::information(this, "Error Opening File", "Error opening " + filename + " for import, please try again");
-                return;
-            }
-            QTextStream in(&import_file);
-            QStringList errors;
-            while(!in.atEnd()){
-                QString statement = in.readLine();
-                QSqlQuery qry = transaction_db.exec(statement);
-                logger->log(Logger::DEBUG, "import qry", qry.lastError().text());
-                if(qry.lastError().text() != " "){
-                    errors.push_back("Error: " + qry.lastError().text() + "\nStatement: " + statement);
-                    logger->log(Logger::CRITICAL, "Error on statement " + statement);
-                }
-            }
-            if(errors.empty()){
-                logger->log(Logger::DEBUG, "All data successfully imported");
-                QMessageBox::information(this, "Success", "All data successfully imported");
-                double last_balance = get_last_transaction_balance();
-                ui->labelTotal->setText("Total: " + format.toCurrencyString(last_balance));
-            }else{
-                logger->log(Logger::DEBUG, QString::number(errors.size()) + " error(s) encountered");
-                QMessageBox::warning(this, QString::number(errors.size()) + " Error(s)", "Encountered " + QString::number(errors.size()) + " errors(s)");
-            }
-            import_file.close();
-            close_database();
+            pending_import_file = filename;
+            backup_before(PENDING_IMPORT, "import");
         }
     }
 }
 
+/*
+ * Called on the GUI thread once the worker has finished an import.
+*/
+void MainWindow::import_finished(bool success, QString message, Money balance){
+    request_finished("Importing");
+    maintenance_due = maintenance_due || success;
+    ui->actionImport->setEnabled(true);
+    ui->actionDelete->setEnabled(true);
+    transactions_changed();
+    set_total(balance);
+    if(success){
+        QMessageBox::information(this, "Success", message);
+    }else{
+        QMessageBox::warning(this, "Import Failed", message);
+    }
+}
+
 /*
  * Deletes the current table from the database
 */
 void MainWindow::on_actionDelete_triggered()
 {
-    int choice = QMessageBox::question(this, "Are you sure?", "Are you sure you want to delete the entire database? This cannot be undone.");
+    int choice = QMessageBox::question(this, "Are you sure?", "Are you sure you want to delete every transaction of " + ui->comboBoxAccount->currentText() + "? A backup of the database is taken first.");
     if(choice == QMessageBox::Yes){
-        open_database();
-        QSqlQuery remove_all_records_qry = transaction_db.exec("DELETE FROM transactions;");
-        logger->log(Logger::DEBUG, "drop table delete db qry" + remove_all_records_qry.lastError().text());
-        close_database();
-        if(remove_all_records_qry.lastError().text() == " "){
-            logger->log(Logger::DEBUG, "Database sucessfully deleted");
-            ui->statusBar->showMessage("Database successfully deleted", MESSAGE_DISPLAY_LENGTH);
-        }else{
-            logger->log(Logger::DEBUG, "Error deleting database");            
-            ui->statusBar->showMessage("Error deleting database", MESSAGE_DISPLAY_LENGTH);
-        }
+        backup_before(PENDING_DELETE, "delete");
+    }
+}
+
+/*
+ * Checks the account's balance chain, repairing is offered once the report is shown.
+*/
+void MainWindow::on_actionVerify_triggered()
+{
+    logger->log(Logger::DEBUG, "Verifying balances");
+    ui->actionVerify->setEnabled(false);
+    request_started("Verifying balances");
+    emit verify_requested(account, false);
+}
+
+/*
+ * Called on the GUI thread with the worker's report. Rows listed are shown as the message box's details.
+*/
+void MainWindow::balances_verified(bool success, QString summary, QString details, int inconsistent, bool repaired, Money balance){
+    request_finished("Verifying balances");
+    ui->actionVerify->setEnabled(true);
+    if(!success){
+        QMessageBox::warning(this, "Verification Failed", summary);
+        return;
+    }
+    if(repaired){
+        transactions_changed();
+        set_total(balance);
+        ui->statusBar->showMessage("Balances repaired", MESSAGE_DISPLAY_LENGTH);
+        return;
+    }
+    QMessageBox box(inconsistent > 0 ? QMessageBox::Warning : QMessageBox::Information, "Verify Balances", summary, QMessageBox::Ok, this);
+    if(!details.isEmpty()) box.setDetailedText(details);
+    if(inconsistent > 0){
+        box.setInformativeText("Rewrite the " + QString::number(inconsistent) + " inconsistent balance(s)?");
+        box.setStandardButtons(QMessageBox::Yes | QMessageBox::No);
+    }
+    if(box.exec() == QMessageBox::Yes){
+        ui->actionVerify->setEnabled(false);
+        request_started("Verifying balances");
+        emit verify_requested(account, true);
+    }
+}
+
+/*
+ * Import and delete are disabled from the moment they are confirmed until the worker answers.
+*/
+void MainWindow::backup_before(PendingAction action, QString reason){
+    ui->actionImport->setEnabled(false);
+    ui->actionDelete->setEnabled(false);
+    after_backup = action;
+    request_started("Backing up");
+    emit backup_requested(reason);
+}
+
+void MainWindow::run_pending_action(){
+    PendingAction action = after_backup;
+    after_backup = NO_PENDING_ACTION;
+    switch(action){
+    case PENDING_IMPORT:
+        request_started("Importing");
+        emit import_requested(account, pending_import_file);
+        break;
+    case PENDING_DELETE:
+        request_started("Deleting");
+        emit delete_requested(account);
+        break;
+    case NO_PENDING_ACTION:
+        ui->actionImport->setEnabled(true);
+        ui->actionDelete->setEnabled(true);
+        break;
+    }
+}
+
+void MainWindow::scheduled_backup(){
+    emit backup_requested("scheduled");
+}
+
+/*
+ * Maintenance only runs once nothing has been asked of the worker for the idle interval and nothing waits on a
+ * backup. It is due on its interval, or right away after a delete or import freed pages.
+*/
+void MainWindow::idle(){
+    if(maintenance_running || !requests_in_flight.isEmpty() || after_backup != NO_PENDING_ACTION) return;
+    if(!maintenance_due && !DatabaseMaintenance::is_due()) return;
+    maintenance_running = true;
+    emit maintenance_requested();
+}
+
+/*
+ * The next slice is only asked for while the window stays idle, otherwise the cycle resumes on the next idle.
+*/
+void MainWindow::maintenance_slice_finished(){
+    if(requests_in_flight.isEmpty() && after_backup == NO_PENDING_ACTION){
+        emit maintenance_requested();
+    }else{
+        maintenance_running = false;
+    }
+}
+
+void MainWindow::maintenance_finished(bool success, QString message){
+    maintenance_running = false;
+    maintenance_due = false;
+    logger->log(Logger::DEBUG, "maintenance " + (success ? QString("done: ") : QString("failed: ")) + message);
+    ui->statusBar->showMessage(message, MESSAGE_DISPLAY_LENGTH);
+}
+
+/*
+ * Scheduled backups only report in the status bar. A failed backup before an import/delete lets the user
+ * choose to go ahead without one.
+*/
+void MainWindow::backup_finished(bool success, QString reason, QString file_name, QString message){
+    logger->log(Logger::DEBUG, "backup (" + reason + ") " + (success ? "saved to " + file_name : message));
+    if(reason == "scheduled"){
+        ui->statusBar->showMessage(success ? "Backed up to " + file_name : message, MESSAGE_DISPLAY_LENGTH);
+        return;
+    }
+    request_finished("Backing up");
+    if(!success){
+        int choice = QMessageBox::question(this, "Backup Failed", message + "\nContinue without a backup?");
+        if(choice != QMessageBox::Yes) after_backup = NO_PENDING_ACTION;
+    }
+    run_pending_action();
+}
+
+/*
+ * Called on the GUI thread once the worker has deleted the transactions.
+*/
+void MainWindow::delete_finished(bool success){
+    request_finished("Deleting");
+    maintenance_due = maintenance_due || success;
+    ui->actionImport->setEnabled(true);
+    ui->actionDelete->setEnabled(true);
+    transactions_changed();
+    if(success){
+        set_total(Money());
+        ui->statusBar->showMessage("Database successfully deleted", MESSAGE_DISPLAY_LENGTH);
+    }else{
+        ui->statusBar->showMessage("Error deleting database", MESSAGE_DISPLAY_LENGTH);
     }
 }
 
@@ -379,25 +820,131 @@ void MainWindow::on_actionDelete_triggered()
 void MainWindow::on_actionAll_Transactions_triggered()
 {
     logger->log(Logger::DEBUG, "Viewing all transactions");
-    view_all_transactions_model = new QSqlQueryModel(this);
-    open_database();
-    view_all_transactions_model->setQuery("SELECT description, mode, trans_amount, balance, date_added FROM transactions;", transaction_db);
-    view_all_transactions_model->setHeaderData(0, Qt::Horizontal, tr("Description"));
-    view_all_transactions_model->setHeaderData(1, Qt::Horizontal, tr("Mode"));
-    view_all_transactions_model->setHeaderData(2, Qt::Horizontal, tr("Transaction Amount"));
-    view_all_transactions_model->setHeaderData(3, Qt::Horizontal, tr("Resulting Balance"));
-    view_all_transactions_model->setHeaderData(4, Qt::Horizontal, tr("Date Added"));
+    if(view_all_transactions_view != NULL){
+        view_all_transactions_model->refresh();
+        view_all_transactions_view->show();
+        view_all_transactions_view->raise();
+        return;
+    }
+    //rows are paged in as the user scrolls, nothing is fetched up front.
+    view_all_transactions_model = new TransactionPageModel(db->database(), account, logger, this);
     
     view_all_transactions_view = new QTableView;
     view_all_transactions_view->setModel(view_all_transactions_model);
     view_all_transactions_view->setWindowIcon(QIcon(":/imgs/money_management.gif"));
     view_all_transactions_view->setWindowTitle("View All Transactions");
-    view_all_transactions_view->resizeRowsToContents();
-    view_all_transactions_view->resizeColumnsToContents();
+    //fixed row heights and column widths measured from a sample, resizing to contents would fetch every row.
+    QFontMetrics metrics = view_all_transactions_view->fontMetrics();
+    view_all_transactions_view->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    view_all_transactions_view->verticalHeader()->setDefaultSectionSize(metrics.height() + 6);
+    QVector<QStringList> sample = view_all_transactions_model->sample(COLUMN_SAMPLE_SIZE);
+    for(int column = 0; column < view_all_transactions_model->columnCount(); column++){
+        int width = metrics.width(view_all_transactions_model->headerData(column, Qt::Horizontal).toString());
+        for(int i = 0; i < sample.size(); i++){
+            width = qMax(width, metrics.width(sample[i][column]));
+        }
+        view_all_transactions_view->setColumnWidth(column, width + 16);
+    }
     //view->horizontalHeader()->setStretchLastSection(true);
     view_all_transactions_view->setGeometry(this->x(), this->y(), 550, 350);
     view_all_transactions_view->show();
-    close_database();
+}
+
+/*
+ * Displays deposits, withdrawals, net flow and the lowest/highest balance per month and per year, Read-Only
+ * The totals are aggregated by the DB worker from its ledger cache, the window is shown when they arrive.
+*/
+void MainWindow::on_actionReports_triggered()
+{
+    logger->log(Logger::DEBUG, "Viewing reports");
+    if(reports_view == NULL){
+        QStringList headers;
+        headers << "Period" << "Deposits" << "Withdrawals" << "Net" << "Lowest Balance" << "Highest Balance" << "Transactions";
+        monthly_report = new QTableWidget(0, headers.size());
+        yearly_report = new QTableWidget(0, headers.size());
+        QTableWidget * tables[] = {monthly_report, yearly_report};
+        for(int i = 0; i < 2; i++){
+            tables[i]->setHorizontalHeaderLabels(headers);
+            tables[i]->setEditTriggers(QAbstractItemView::NoEditTriggers);
+            tables[i]->setSelectionBehavior(QAbstractItemView::SelectRows);
+            tables[i]->verticalHeader()->setVisible(false);
+        }
+        reports_view = new QTabWidget;
+        reports_view->addTab(monthly_report, "Monthly");
+        reports_view->addTab(yearly_report, "Yearly");
+        reports_view->setWindowIcon(QIcon(":/imgs/money_management.gif"));
+        reports_view->setWindowTitle("Reports");
+        reports_view->setGeometry(this->x(), this->y(), 700, 350);
+    }
+    request_reports();
+}
+
+/*
+ * Searches transactions by description words and date/amount ranges, Read-Only
+*/
+void MainWindow::on_actionSearch_triggered()
+{
+    logger->log(Logger::DEBUG, "Searching transactions");
+    if(search_view == NULL){
+        search_view = new SearchWindow(searcher, account, logger);
+        search_view->setGeometry(this->x(), this->y(), 600, 400);
+    }
+    search_view->show();
+    search_view->raise();
+    search_view->activateWindow();
+}
+
+void MainWindow::on_actionDiagnostics_triggered()
+{
+    logger->log(Logger::DEBUG, "Showing diagnostics");
+    if(diagnostics_view == NULL){
+        diagnostics_view = new DiagnosticsWindow(logger);
+        diagnostics_view->setGeometry(this->x(), this->y(), 900, 500);
+    }
+    diagnostics_view->show();
+    diagnostics_view->raise();
+    diagnostics_view->activateWindow();
+}
+
+void MainWindow::request_reports(){
+    //an update already on its way will include everything written before it is handled
+    if(requests_in_flight.contains("Building reports")) return;
+    request_started("Building reports");
+    emit reports_requested(account);
+}
+
+/*
+ * Called on the GUI thread with the worker's reports.
+*/
+void MainWindow::reports_built(bool success, ReportPeriods monthly, ReportPeriods yearly){
+    request_finished("Building reports");
+    if(reports_view == NULL) return;
+    if(!success){
+        logger->log(Logger::DEBUG, "error building reports");
+        QMessageBox::warning(this, "Error", "Error building reports, please try again");
+        return;
+    }
+    show_report(monthly_report, monthly);
+    show_report(yearly_report, yearly);
+    reports_view->show();
+    reports_view->raise();
+}
+
+void MainWindow::show_report(QTableWidget * table, const ReportPeriods & periods){
+    table->setRowCount(periods.size());
+    for(int i = 0; i < periods.size(); i++){
+        const ReportPeriod & period = periods[i];
+        QString name = "No date";
+        if(period.year != 0) name = period.month != 0 ? QDate(period.year, period.month, 1).toString("MMMM yyyy") : QString::number(period.year);
+        table->setItem(i, 0, new QTableWidgetItem(name));
+        table->setItem(i, 1, new QTableWidgetItem(period.deposits.to_currency(format)));
+        table->setItem(i, 2, new QTableWidgetItem(period.withdrawals.to_currency(format)));
+        table->setItem(i, 3, new QTableWidgetItem(period.net().to_currency(format)));
+        table->setItem(i, 4, new QTableWidgetItem(period.min_balance.to_currency(format)));
+        table->setItem(i, 5, new QTableWidgetItem(period.max_balance.to_currency(format)));
+        table->setItem(i, 6, new QTableWidgetItem(QString::number(period.count)));
+    }
+    table->resizeColumnsToContents();
 }
 
 /*
@@ -408,10 +955,10 @@ void MainWindow::on_actionAll_Transactions_triggered()
 void MainWindow::on_actionTransaction_triggered()
 {
     logger->log(Logger::DEBUG, "Editing all transactions");
-    edit_trans_model = new QSqlTableModel(this, transaction_db);
-    open_database();
+    edit_trans_model = new TransactionTableModel(this, db->database());
     edit_trans_model->setTable("transactions");
     edit_trans_model->setEditStrategy(QSqlTableModel::OnManualSubmit);
+    edit_trans_model->setFilter("account_id = " + QString::number(account));
     edit_trans_model->select();
     edit_trans_model->setHeaderData(1, Qt::Horizontal, tr("Description"));
     edit_trans_model->setHeaderData(2, Qt::Horizontal, tr("Mode"));
@@ -423,6 +970,7 @@ void MainWindow::on_actionTransaction_triggered()
     edit_trans_view->setModel(edit_trans_model);
     edit_trans_view->hideColumn(ID);
     edit_trans_view->hideColumn(BALANCE);
+    edit_trans_view->hideColumn(ACCOUNT_ID);
     edit_trans_view->setWindowIcon(QIcon(":/imgs/money_management.gif"));
     edit_trans_view->setWindowTitle("Edit Transactions");
     edit_trans_view->resizeRowsToContents();
@@ -455,7 +1003,7 @@ void MainWindow::record_changed(QModelIndex index_1, QModelIndex index_2){
     int choice = 0;
     switch (index_1.column()) {
     case 1:{
-        if(edit_trans_model->submitAll()){
+        if(edit_trans_model->save_field(index_1.row(), DESCRIPTION)){
             logger->log(Logger::DEBUG, "description updated");            
             QMessageBox::information(edit_trans_view, "Success", "Description successfully updated");
         }else{
@@ -469,82 +1017,8 @@ void MainWindow::record_changed(QModelIndex index_1, QModelIndex index_2){
             choice = QMessageBox::question(edit_trans_view, "Update Subsequent Transactions?", "All subsequent transactions will have their balances updated to reflect this change, continue?");
             if(choice == QMessageBox::Yes){
                 logger->log(Logger::DEBUG, "updating mode");                
-                double new_balance = edit_trans_model->data(edit_trans_model->index(index_1.row(), BALANCE)).toDouble();
-                QString mode = edit_trans_model->data(edit_trans_model->index(index_1.row(), MODE)).toString();
-                bool negative_result = false;
-                QVector<double> results;
-                for(int i = index_1.row(); i < edit_trans_model->rowCount(); i++){
-                    negative_result = false;
-                    double trans_amount = edit_trans_model->data(edit_trans_model->index(i, TRANSACTION_AMOUNT)).toDouble();
-                    if(changed_data.toString() == "Deposit"){
-                        //withdraw -> deposit.
-                        if(i == index_1.row()){
-                            new_balance += (2 * trans_amount);
-                        }else{
-                            if(mode == "Deposit"){
-                                new_balance += trans_amount;
-                            }else{
-                                if(new_balance - trans_amount < 0){
-                                    QMessageBox::information(edit_trans_view, "Error", "Resulting calculation is negative, reverting all changes...");
-                                    logger->log(Logger::DEBUG, "resulting calculation negative, reverting all");                                    
-                                    negative_result = true;
-                                    break;
-                                }
-                                new_balance -= trans_amount;
-                            }
-                        }
-                        //deposit -> withdraw
-                    }else{
-                        if(i == index_1.row()){
-                            if(new_balance - (2 * trans_amount) < 0){
-                                logger->log(Logger::DEBUG, "resulting calculation negative, reverting all");                                
-                                QMessageBox::information(edit_trans_view, "Error", "Resulting calculation is negative, reverting all changes...");
-                                negative_result = true;
-                                break;
-                            }
-                            new_balance -= (2 * trans_amount);
-                        }else{
-                            if(mode == "Deposit"){
-                                new_balance += trans_amount;
-                            }else{
-                                if(new_balance - trans_amount < 0){
-                                    logger->log(Logger::DEBUG, "resulting calculation negative, reverting all");                                    
-                                    QMessageBox::information(edit_trans_view, "Error", "Resulting calculation is negative, reverting all changes...");
-                                    negative_result = true;
-                                    break;
-                                }
-                                new_balance -= trans_amount;
-                            }
-                        }
-                    }
-                    
-                    results.append(new_balance);
-                    
-                    if(i+1 < edit_trans_model->rowCount()){
-                        mode = edit_trans_model->data(edit_trans_model->index(i+1, MODE)).toString();
-                    }else{
-                        qDebug() << "should be exiting now...";
-                    }
-                }
-                if(!negative_result){
-                    //write to db.
-                    for(int i = index_1.row(); i < results.size(); i++){
-                        QModelIndex index = edit_trans_model->index(i, BALANCE, QModelIndex());
-                        bool result = edit_trans_model->setData(index, results[i]);
-                        logger->log(Logger::DEBUG, "update mode: " + (result ? QString("True") : QString("False")));                                
-                    }
-                    
-                    //error checking
-                    bool result = edit_trans_model->submitAll();
-                    logger->log(Logger::DEBUG, "submit all mode changes: " + (result ? QString("True") : QString("False")));                                                    
-                }else{
-                    if(edit_trans_model->isDirty()){
-                        logger->log(Logger::DEBUG, "resulting calculation negative reverting all changes");
-                        QMessageBox::information(edit_trans_view, "Error", "Resulting calculation is negative, reverting all changes...");                        
-                        edit_trans_model->revertAll();
-                    }
-                }
-                ui->labelTotal->setText("Total: " + format.toCurrencyString(new_balance));
+                edit_reselects = false;
+                emit mode_edit_requested(account, begin_edit(index_1.row()), changed_data.toString());
             }else{
                 edit_trans_model->revertRow(index_1.row());
             }
@@ -556,77 +1030,15 @@ void MainWindow::record_changed(QModelIndex index_1, QModelIndex index_2){
         break;
     }
     case 3:{
-        double new_amount = changed_data.toDouble();
-        if(new_amount <= 0){
+        Money new_amount = Money::from_string(changed_data.toString());
+        if(new_amount.is_negative() || new_amount.is_zero()){
             logger->log(Logger::DEBUG, "invalid input editing trans amount");
             QMessageBox::information(edit_trans_view, "Invalid Input" , "Input must be greater than zero!");
             edit_trans_model->revertRow(index_1.row());
             break;
         }
-        edit_trans_model->revertRow(index_1.row());
-        double new_balance = edit_trans_model->data(edit_trans_model->index(index_1.row(), BALANCE)).toDouble();
-        double trans_amount = edit_trans_model->data(edit_trans_model->index(index_1.row(), TRANSACTION_AMOUNT)).toDouble();
-        QString mode = edit_trans_model->data(edit_trans_model->index(index_1.row(), MODE)).toString();
-        bool negative_result = false;
-        if(mode == "Deposit"){
-            if(new_amount > trans_amount){
-                new_balance += (new_amount - trans_amount);
-            }else if(new_amount < trans_amount){
-                new_balance -= (trans_amount - new_amount);
-            }
-        }else{
-            if(new_amount > trans_amount){
-                new_balance -= (new_amount - trans_amount);
-            }else if(new_amount < trans_amount){
-                new_balance += (trans_amount - new_amount);
-            }
-        }
-        
-        QVector<double> results;
-        results.append(new_balance);
-        
-        if(new_balance < 0){
-            negative_result = true;
-        }
-        if(!negative_result){ 
-            for(int i = index_1.row() + 1; i < edit_trans_model->rowCount(); i++){
-                trans_amount = edit_trans_model->data(edit_trans_model->index(i, TRANSACTION_AMOUNT)).toDouble();
-                mode = edit_trans_model->data(edit_trans_model->index(i, MODE)).toString();
-                if(mode == "Deposit"){
-                    new_balance += trans_amount;
-                }else{
-                    if(new_balance - trans_amount < 0){
-                        negative_result = true;
-                        break;
-                    }
-                    new_balance -= trans_amount;
-                }
-                results.append(new_balance);
-            }
-        }
-        
-        if(negative_result){
-            logger->log(Logger::DEBUG, "resulting calculation is negative, reverting all changes");
-            if(edit_trans_model->isDirty()){
-                edit_trans_model->revertAll();
-            }
-            QMessageBox::information(edit_trans_view, "Error", "Resulting calculation is negative, reverting all changes...");                
-        }else{
-            QModelIndex index = edit_trans_model->index(index_1.row(), TRANSACTION_AMOUNT, QModelIndex());
-            bool result = edit_trans_model->setData(index, new_amount);
-            logger->log(Logger::DEBUG, "update trans amount: " + (result ? QString("True") : QString("False")));                                            
-            int i = index_1.row();
-            while(!results.empty()){
-                QModelIndex index = edit_trans_model->index(i, BALANCE, QModelIndex());
-                bool result = edit_trans_model->setData(index, results.front());
-                logger->log(Logger::DEBUG, "update balances after editing trans amount: " + (result ? QString("True") : QString("False")));                                                
-                results.pop_front();
-                i++;
-            }
-            bool status = edit_trans_model->submitAll();
-            logger->log(Logger::DEBUG, "submitting all editing trans amount status: " + (status ? QString("True") : QString("False")));                                            
-            ui->labelTotal->setText("Total: " + format.toCurrencyString(new_balance));
-        }
+        edit_reselects = false;
+        emit amount_edit_requested(account, begin_edit(index_1.row()), new_amount);
         break;
     }
     case 4:{
@@ -634,13 +1046,10 @@ void MainWindow::record_changed(QModelIndex index_1, QModelIndex index_2){
     }
     case 5:{
         if(changed_data.toDate().isValid()){
-            if(edit_trans_model->submitAll()){
-                logger->log(Logger::DEBUG, "date successfully updated");
-                QMessageBox::information(edit_trans_view, "Success", "Date successfully updated");
-            }else{
-                logger->log(Logger::DEBUG, "error updating date");
-                QMessageBox::warning(edit_trans_view, "Error", "Error updating date, please try again");
-            }
+            //the row moves in the ledger and the balances it moves past change, the worker applies it
+            logger->log(Logger::DEBUG, "updating date");
+            edit_reselects = true;
+            emit date_edit_requested(account, begin_edit(index_1.row()), changed_data.toDate());
         }else{
             logger->log(Logger::DEBUG, "invalid date " + changed_data.toString());
             QMessageBox::information(edit_trans_view, "Invalid Date", changed_data.toString() + " is not a valid date");
@@ -653,5 +1062,51 @@ void MainWindow::record_changed(QModelIndex index_1, QModelIndex index_2){
     }
     }
     connect(edit_trans_model, SIGNAL(dataChanged(QModelIndex,QModelIndex)), this, SLOT(record_changed(QModelIndex,QModelIndex)));
-    close_database();
+}
+
+/*
+ * Mode/amount/date edits are validated and applied by the worker against its ledger cache, only the id is read
+ * from the model. The edit window is disabled until the worker answers.
+*/
+qint64 MainWindow::begin_edit(int model_row){
+    qint64 id = edit_trans_model->data(edit_trans_model->index(model_row, ID)).toLongLong();
+    edit_row = model_row;
+    edit_timer.start();
+    edit_trans_view->setEnabled(false);
+    request_started("Updating balances");
+    return id;
+}
+
+/*
+ * Called on the GUI thread with the worker's answer to an edit. Only the edited row is read back (or reverted)
+ * and the balances after it are shifted in the model, the table is only re-selected if the row moved
+ * (a date edit moves it in the ledger order).
+*/
+void MainWindow::edit_finished(bool success, QString message, qint64 id, Money change, Money total){
+    Metrics::instance().add_time("gui.edit_roundtrip", edit_timer.nsecsElapsed());
+    request_finished("Updating balances");
+    logger->log(Logger::DEBUG, "edit transaction status: " + (success ? QString("True") : QString("False")));
+    transactions_changed();
+    if(edit_trans_model == NULL) return;
+    edit_trans_view->setEnabled(true);
+    //reverting emits dataChanged, which must not be taken as another edit
+    disconnect(edit_trans_model, SIGNAL(dataChanged(QModelIndex,QModelIndex)), this, SLOT(record_changed(QModelIndex,QModelIndex)));
+    bool same_row = edit_row >= 0 && edit_row < edit_trans_model->rowCount()
+            && edit_trans_model->data(edit_trans_model->index(edit_row, ID)).toLongLong() == id;
+    if(!same_row || (success && edit_reselects)){
+        edit_trans_model->revertAll();
+        edit_trans_model->select();
+    }else if(success){
+        edit_trans_model->selectRow(edit_row);
+        edit_trans_model->shift_balances(edit_row, change);
+    }else{
+        edit_trans_model->revertRow(edit_row);
+    }
+    edit_row = -1;
+    connect(edit_trans_model, SIGNAL(dataChanged(QModelIndex,QModelIndex)), this, SLOT(record_changed(QModelIndex,QModelIndex)));
+    if(success){
+        set_total(total);
+    }else{
+        QMessageBox::information(edit_trans_view, "Error", message);
+    }
 }
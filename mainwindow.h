@@ -6,8 +6,25 @@
 #include <QtSql>
 #include <QCloseEvent>
 #include <QTableView>
+#include <QTableWidget>
+#include <QTabWidget>
 #include <QSqlQueryModel>
+#include <QStringList>
+#include <QThread>
+#include <QTimer>
+#include <QElapsedTimer>
 #include "Logger.h"
+#include "DatabaseManager.h"
+#include "DatabaseBackup.h"
+#include "DatabaseMaintenance.h"
+#include "DatabaseWorker.h"
+#include "LedgerReports.h"
+#include "SearchWindow.h"
+#include "DiagnosticsWindow.h"
+#include "TransactionSearch.h"
+#include "TransactionPageModel.h"
+#include "TransactionTableModel.h"
+#include "Money.h"
 
 namespace Ui {
 class MainWindow;
@@ -27,11 +44,20 @@ private slots:
     //triggered when about action pressed
     void on_actionAbout_triggered();
     
-    //triggered when submitting new transaction
+    //triggered when staging the transaction in the form
+    void on_pushButtonAdd_clicked();
+    
+    //triggered when removing the selected pending transactions
+    void on_pushButtonRemovePending_clicked();
+    
+    //triggered when submitting the pending transactions
     void on_pushButtonSubmit_clicked();
     
-    //called to reenable the submit btn after a few seconds, to prevent spamming of the submit btn.
-    void reenable_submit_btn();
+    //triggered when another account is picked in the account selector
+    void on_comboBoxAccount_activated(int index);
+    
+    //triggered when creating an account
+    void on_pushButtonNewAccount_clicked();
     
     //triggered when quit button pressed
     void on_actionQuit_triggered();
@@ -39,15 +65,30 @@ private slots:
     //triggered when export button pressed
     void on_actionExport_triggered();
     
+    //called when the export thread finishes
+    void export_finished(bool success, qint64 rows, QString message);
+    
     //triggered when import button pressed
     void on_actionImport_triggered();
     
     //triggered when delete database btn pressed
     void on_actionDelete_triggered();
     
+    //triggered when verify balances btn pressed.
+    void on_actionVerify_triggered();
+    
     //triggered when view all transactions btn pressed.
     void on_actionAll_Transactions_triggered();
     
+    //triggered when view reports btn pressed.
+    void on_actionReports_triggered();
+    
+    //triggered when search btn pressed.
+    void on_actionSearch_triggered();
+    
+    //triggered when diagnostics btn pressed.
+    void on_actionDiagnostics_triggered();
+    
     //triggered when a transaction(s) want to be edited/updated.
     void on_actionTransaction_triggered();
     
@@ -57,23 +98,143 @@ private slots:
     //sets up the database for the life of the program
     void setup_database();
     
-    //opens the database so writing/reading can occur
-    bool open_database();
-    
-    //safely closes the database
-    void close_database();
-    
     //called when the program closes (via keyboard shortcut, menu item or the X button
     void closeEvent(QCloseEvent*);  
     
-    //queries the database for the last balance, and sets the balance label.
-    double get_last_transaction_balance();
+    //the following are called on the GUI thread with the DB worker's answers
+    void database_opened(bool success, Accounts accounts, qint64 loaded, Money balance);
+    void account_selected(qint64 selected, Money balance);
+    void account_added(bool success, QString message, Accounts accounts, qint64 added);
+    void transaction_submitted(int result, int row, Money balance);
+    void import_finished(bool success, QString message, Money balance);
+    void delete_finished(bool success);
+    void edit_finished(bool success, QString message, qint64 id, Money change, Money total);
+    void reports_built(bool success, ReportPeriods monthly, ReportPeriods yearly);
+    void balances_verified(bool success, QString summary, QString details, int inconsistent, bool repaired, Money balance);
+    
+    //called on the GUI thread once a backup is done, runs the import/delete that was waiting for it (if any)
+    void backup_finished(bool success, QString reason, QString file_name, QString message);
+    
+    //triggered by the backup timer
+    void scheduled_backup();
+    
+    //triggered once no request was made for the idle interval, starts the storage maintenance if it is due
+    void idle();
+    
+    //called on the GUI thread after each maintenance slice and once the cycle is done
+    void maintenance_slice_finished();
+    void maintenance_finished(bool success, QString message);
+    
+    //first pass of the event loop after the constructor, the window has been shown
+    void window_shown();
+    
+    //brings cached views of the transactions table up to date after a write
+    void transactions_changed();
+    
+signals:
+    //requests for the DB worker, each is answered by one of the slots above
+    void open_requested(qint64 account);
+    void account_select_requested(qint64 account);
+    void account_add_requested(QString name);
+    void submit_requested(qint64 account, PendingTransactions transactions);
+    void import_requested(qint64 account, QString file_name);
+    void delete_requested(qint64 account);
+    void mode_edit_requested(qint64 account, qint64 id, QString mode);
+    void amount_edit_requested(qint64 account, qint64 id, Money amount);
+    void date_edit_requested(qint64 account, qint64 id, QDate date);
+    void verify_requested(qint64 account, bool repair);
+    void reports_requested(qint64 account);
+    void search_open_requested();
+    void backup_requested(QString reason);
+    void maintenance_requested();
     
 private:
+    //sets the balance label
+    void set_total(Money balance);
+    
+    //opens the GUI connection early and shows the account's last known total, if the database exists
+    void show_last_known_balance();
+    
+    //logs (and records in the diagnostics) the time startup took to reach phase
+    void startup_phase(QString phase);
+    QElapsedTimer startup_timer;
+    qint64 last_phase_ms;
+    
+    //enables/disables the entry form and the menu
+    void set_inputs_enabled(bool enabled);
+    
+    //fills the account selector and selects the current account
+    void set_accounts(const Accounts & accounts);
+    
+    //points the open transaction windows at the current account
+    void account_changed();
+    
+    //validates the form against the pending balance and moves it to the pending list, false if it isn't valid
+    bool stage_form_entry();
+    
+    //balance after every pending transaction
+    Money pending_balance() const;
+    
+    void refresh_pending_view();
+    void set_pending_enabled(bool enabled);
+    
+    //track requests sent to the DB worker, shown in the status bar until answered
+    void request_started(QString operation);
+    void request_finished(QString operation);
+    
+    //asks the DB worker for up to date reports, the reports window is filled in when they arrive
+    void request_reports();
+    
+    //fills one of the report tables, one row per period
+    void show_report(QTableWidget * table, const ReportPeriods & periods);
+    
+    //locks the edit window until the DB worker answers a mode/amount/date edit, returns the row's transaction id
+    qint64 begin_edit(int model_row);
+    
     Ui::MainWindow *ui;
     
-    //the database object.
-    QSqlDatabase transaction_db;
+    //does the writes on its own thread w/ its own connection
+    DatabaseWorker * db_worker;
+    QThread * db_thread;
+    
+    //runs the search window's queries on its own thread w/ its own connection, opened once the db is ready
+    TransactionSearch * searcher;
+    QThread * search_thread;
+    
+    //takes the online backups on its own thread w/ its own connection, before imports/deletes and on a timer
+    DatabaseBackup * backup;
+    QThread * backup_thread;
+    QTimer * backup_timer;
+    
+    //vacuums/analyzes/checks the database in slices on its own thread w/ its own connection while the window is idle
+    DatabaseMaintenance * maintenance;
+    QThread * maintenance_thread;
+    QTimer * idle_timer;
+    bool maintenance_running;
+    //set by deletes and imports, the next idle runs maintenance even if it isn't due yet
+    bool maintenance_due;
+    
+    //destructive actions wait for their backup to finish
+    enum PendingAction{
+        NO_PENDING_ACTION,
+        PENDING_IMPORT,
+        PENDING_DELETE
+    };
+    PendingAction after_backup;
+    QString pending_import_file;
+    
+    //backs the database up, the action runs once the backup_finished() answer comes in
+    void backup_before(PendingAction action, QString reason);
+    
+    //runs the import/delete waiting for its backup
+    void run_pending_action();
+    
+    //requests sent to the worker that haven't been answered yet
+    QStringList requests_in_flight;
+    QLabel * status_label;
+    
+    //the GUI thread's connection, used by the transaction windows' models. opened once for the life of the window.
+    DatabaseManager * db;
     
     //the path of the database
     QString db_path;
@@ -81,13 +242,41 @@ private:
     //used to format money to the locale of the program
     QLocale format;
     
+    //the account shown and edited, every request to the worker is for it
+    qint64 account;
+    
+    //last saved balance of the account, as reported by the worker
+    Money committed_balance;
+    
+    //transactions staged in the window, saved together on submit
+    PendingTransactions pending;
+    
     //used to display and edit database rows/columns so they can be updated
-    QSqlTableModel* edit_trans_model;
+    TransactionTableModel* edit_trans_model;
     QTableView* edit_trans_view;
+    //model row of the mode/amount/date edit the worker is applying, -1 if none
+    int edit_row;
+    //the edit moves the row (date edits), the table is re-selected once it is applied
+    bool edit_reselects;
+    
+    //time from asking the worker to its answer, for the diagnostics
+    QElapsedTimer submit_timer;
+    QElapsedTimer edit_timer;
     
     //used to display database rows/columns for viewing only.
     QTableView* view_all_transactions_view;
-    QSqlQueryModel* view_all_transactions_model;
+    TransactionPageModel* view_all_transactions_model;
+    
+    //monthly/yearly totals computed by the DB worker, one tab each.
+    QTabWidget* reports_view;
+    QTableWidget* monthly_report;
+    QTableWidget* yearly_report;
+    
+    //search by description, date and amount
+    SearchWindow* search_view;
+    
+    //live timings/counters and slow query plans
+    DiagnosticsWindow* diagnostics_view;
     
     //global logger object.
     Logger * logger;
@@ -98,6 +287,7 @@ private:
    * column 3 = trans amount
    * column 4 = balance
    * column 5 = date added
+   * column 6 = account id
   */
     enum Column{
         ID,
@@ -105,7 +295,8 @@ private:
         MODE,
         TRANSACTION_AMOUNT,
         BALANCE,
-        DATE_ADDED
+        DATE_ADDED,
+        ACCOUNT_ID
     };
     
 };